@@ -1,6 +1,7 @@
 
 #include "ESP32_DESFire.h"
-#include <Adafruit_PN532.h>
+#include "ESP32_DESFire_Commands.h"
+#include "ESP32_DESFire_Trace.h"
 
 /////////////////////////////////////////////////////////////////////////////////////
 //
@@ -8,96 +9,182 @@
 //
 /////////////////////////////////////////////////////////////////////////////////////
 
-ESP32_DESFire::ESP32_DESFire(Adafruit_PN532* nfc) {
-  nfcLib = nfc;
+ESP32_DESFire::ESP32_DESFire(DF_Transport::Reader* reader, byte targetNumber)
+  : transport(reader, targetNumber) {
+  DF_ResetRecoveryCounters();
 }
 
 /////////////////////////////////////////////////////////////////////////////////////
 //
-// Application management
+// Target management
 //
 /////////////////////////////////////////////////////////////////////////////////////
 
-ESP32_DESFire::DF_StatusCode ESP32_DESFire::DF_Plain_SelectApplication(byte* aid) {
+void ESP32_DESFire::DF_SetTargetNumber(byte targetNumber) {
+  transport.DF_SetTargetNumber(targetNumber);
+}
 
-  uint8_t i;
-  byte sendData[9];
+byte ESP32_DESFire::DF_GetTargetNumber() {
+  return transport.DF_GetTargetNumber();
+}
 
-  sendData[0] = 0x90;
-  sendData[1] = DESFIRE_SELECT_APPLICATION;
-  sendData[2] = 0x00;
-  sendData[3] = 0x00;
-  sendData[4] = 0x03;
+bool ESP32_DESFire::DF_GetSelectedApplication(byte* aid) {
+  if (!isApplicationSelected)
+    return false;
+  memcpy(aid, selectedAid, 3);
+  return true;
+}
 
-  // copy the AID in parameter
-  for (i = 0; i < 3; i++) {
-    sendData[5 + i] = aid[i]; /* 3 byte AID */
-  }
-  sendData[8] = 0x00;
+void ESP32_DESFire::DF_ResetSession() {
+  isApplicationSelected = false;
+  isoSelectedFileId = 0;
+  fileSettingsIsValid = false;
+  fileSizeCacheCount = 0;
+  valueOperationsPending = 0;
+}
 
-  byte backData[61];
-  byte backLen = 61;
+void ESP32_DESFire::DF_StartSession(byte targetNumber, byte* uid, byte uidLength) {
+  DF_ResetSession();
+  transport.DF_SetTargetNumber(targetNumber);
+  if (uidLength > sizeof(sessionUid))
+    uidLength = 0;
+  memcpy(sessionUid, uid, uidLength);
+  sessionUidLength = uidLength;
+}
 
-  DF_StatusCode statusCode;
+bool ESP32_DESFire::DF_ActivateCard(byte* backUid, byte* backUidLength) {
+  if (!transport.DF_Activate(backUid, backUidLength))
+    return false;
+  DF_StartSession(transport.DF_GetTargetNumber(), backUid, *backUidLength);
+  return true;
+}
 
-  statusCode = DF_BasicTransceive(sendData, sizeof(sendData), backData, &backLen);
+#ifdef DF_TRANSPORT_PN532
+void ESP32_DESFire::DF_SetBusScheduler(DF_BusScheduler* bus, int8_t irqPin) {
+  transport.DF_SetBusScheduler(bus, irqPin);
+}
 
-  if (statusCode != DF_STATUS_OK)
-    return (DF_StatusCode)statusCode;
+bool ESP32_DESFire::DF_PN532Command(byte* cmd, byte cmdLen, byte* resp, byte* respLen, uint16_t timeout) {
+  return transport.DF_Command(cmd, cmdLen, resp, respLen, timeout);
+}
 
-  if (backLen != 2)
-    return DF_STATUS_ERROR;
+void ESP32_DESFire::DF_PN532Wakeup() {
+  transport.DF_Wakeup();
+}
+#endif
 
-  if (backData[backLen - 2] != 0x91 || backData[backLen - 1] != 0x00)
-    return DF_InterpretErrorCode(&backData[backLen - 2]);
+void ESP32_DESFire::DF_SetExchangeHandler(DF_ExchangeHandler* handler) {
+  exchangeHandler = handler;
+}
 
-  return DF_STATUS_OK;
+void ESP32_DESFire::DF_SetTraceRecorder(DF_TraceRecorder* recorder) {
+  traceRecorder = recorder;
 }
 
-ESP32_DESFire::DF_StatusCode ESP32_DESFire::DF_Plain_CreateApplication(byte* aid, byte keySettings, byte appSettings) {
-  uint8_t i;
-  int8_t _aid[3];  // DESFire aid
-  int8_t _aidLen;  // aid len = 3
-  // Hang on to the aid data
-  memcpy(_aid, aid, 3);
-  _aidLen = 3;
-
-  byte sendData[11];
-
-  sendData[0] = 0x90;                        // CLA
-  sendData[1] = DESFIRE_CREATE_APPLICATION;  // CMD DESFIRE_SELECT_APPLICATION (0xCA)
-  sendData[2] = 0x00;                        // P1
-  sendData[3] = 0x00;                        // P2
-  sendData[4] = 0x05;                        // Lc
-
-  // copy the AID in parameter
-  for (i = 0; i < _aidLen; i++) {
-    sendData[5 + i] = _aid[i];  // 3 byte AID
-  }
-  sendData[8] = keySettings;
-  sendData[9] = appSettings;
-  sendData[10] = 0x00;  // Le
+/////////////////////////////////////////////////////////////////////////////////////
+//
+// Deadlines
+//
+/////////////////////////////////////////////////////////////////////////////////////
 
-  byte backData[61];
-  byte backLen = 61;
+void ESP32_DESFire::DF_SetCommandTimeout(uint16_t timeoutMs) {
+  commandTimeoutMs = timeoutMs;
+}
 
-  bool success;
-  DF_StatusCode statusCode;
+void ESP32_DESFire::DF_SetDeadline(unsigned long deadline) {
+  deadlineMillis = deadline;
+  isDeadlineSet = true;
+}
 
-  statusCode = DF_BasicTransceive(sendData, sizeof(sendData), backData, &backLen);
+void ESP32_DESFire::DF_SetTimeBudget(uint32_t budgetMs) {
+  DF_SetDeadline(millis() + budgetMs);
+}
 
-  if (statusCode != DF_STATUS_OK)
-    return (DF_StatusCode)statusCode;
+void ESP32_DESFire::DF_ClearDeadline() {
+  isDeadlineSet = false;
+}
 
-  if (backLen < 2)
-    return DF_WRONG_RESPONSE_LEN;
+uint32_t ESP32_DESFire::DF_GetRemainingTime() {
+  if (!isDeadlineSet)
+    return 0xFFFFFFFF;
+  // the difference is signed, so the deadline also works across the millis() overflow
+  long remaining = (long)(deadlineMillis - millis());
+  return (remaining > 0) ? (uint32_t)remaining : 0;
+}
 
-  if (backData[backLen - 2] != 0x91 || backData[backLen - 1] != 0x00)
-    return DF_InterpretErrorCode(&backData[backLen - 2]);
+/////////////////////////////////////////////////////////////////////////////////////
+//
+// Error recovery
+//
+/////////////////////////////////////////////////////////////////////////////////////
+
+void ESP32_DESFire::DF_SetRecoveryPolicy(const DF_RecoveryPolicy& policy) {
+  recoveryPolicy = policy;
+}
+
+ESP32_DESFire::DF_RecoveryPolicy ESP32_DESFire::DF_GetRecoveryPolicy() {
+  return recoveryPolicy;
+}
+
+uint16_t ESP32_DESFire::DF_GetRecoveryCounter(DF_StatusCode statusCode) {
+  if (statusCode >= DF_STATUS_CODE_COUNT)
+    return 0;
+  return recoveryCounters[statusCode];
+}
 
+uint16_t ESP32_DESFire::DF_GetReactivationCounter() {
+  return reactivationCounter;
+}
+
+uint16_t ESP32_DESFire::DF_GetRecoveryFailureCounter() {
+  return recoveryFailureCounter;
+}
+
+void ESP32_DESFire::DF_ResetRecoveryCounters() {
+  memset(recoveryCounters, 0, sizeof(recoveryCounters));
+  reactivationCounter = 0;
+  recoveryFailureCounter = 0;
+}
+
+void ESP32_DESFire::DF_RecoveryDebugPrint() {
+  Serial.printf("Retries on exchange error : %d\n", recoveryCounters[DF_STATUS_ERROR]);
+  Serial.printf("Retries on timeout        : %d\n", recoveryCounters[DF_STATUS_TIMEOUT]);
+  Serial.printf("Retries on COMMAND_ABORTED: %d\n", recoveryCounters[COMMAND_ABORTED]);
+  Serial.printf("Retries on AUTH_DELAY     : %d\n", recoveryCounters[AUTHENTICATION_DELAY]);
+  Serial.printf("Card reactivations        : %d\n", reactivationCounter);
+  Serial.printf("Unrecovered failures      : %d\n", recoveryFailureCounter);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+//
+// Application management
+//
+/////////////////////////////////////////////////////////////////////////////////////
+
+ESP32_DESFire::DF_StatusCode ESP32_DESFire::DF_Plain_SelectApplication(byte* aid) {
+  DF_CommandApdu<DF_Commands::SELECT_APPLICATION> apdu(DF_Aid{ aid });
+
+  DF_StatusCode statusCode;
+
+  isApplicationSelected = false;
+  fileSizeCacheCount = 0;
+  isoSelectedFileId = 0;
+  statusCode = DF_Plain_Command_native(DF_Commands::SELECT_APPLICATION, apdu.data, apdu.LENGTH, NULL, NULL);
+
+  if (statusCode != DF_STATUS_OK)
+    return statusCode;
+
+  memcpy(selectedAid, aid, 3);
+  isApplicationSelected = true;
   return DF_STATUS_OK;
 }
 
+ESP32_DESFire::DF_StatusCode ESP32_DESFire::DF_Plain_CreateApplication(byte* aid, byte keySettings, byte appSettings) {
+  // AID (3), key settings, application settings (key type and number of keys)
+  DF_CommandApdu<DF_Commands::CREATE_APPLICATION> apdu(DF_Aid{ aid }, keySettings, appSettings);
+  return DF_Plain_Command_native(DF_Commands::CREATE_APPLICATION, apdu.data, apdu.LENGTH, NULL, NULL);
+}
+
 // creates an application with 5 AES keys and default app settings
 ESP32_DESFire::DF_StatusCode ESP32_DESFire::DF_Plain_CreateApplicationDefaultAes(byte* aid) {
   /**
@@ -114,59 +201,66 @@ ESP32_DESFire::DF_StatusCode ESP32_DESFire::DF_Plain_CreateApplicationDefaultAes
   return DF_Plain_CreateApplication(aid, keySettings, appSettings);
 };
 
+ESP32_DESFire::DF_StatusCode ESP32_DESFire::DF_Plain_GetApplicationIds(byte* backAids, byte* backAidsLen) {
+  DF_CommandApdu<DF_Commands::GET_APPLICATION_IDS> apdu;
+
+  uint16_t received = *backAidsLen;
+  DF_StatusCode statusCode;
+  statusCode = DF_Plain_CollectFrames_native(apdu.data, apdu.LENGTH, backAids, &received);
+  if (statusCode != DF_STATUS_OK)
+    return statusCode;
+
+  if (received % 3 != 0)
+    return DF_WRONG_RESPONSE_LEN;
+  *backAidsLen = received;
+  return DF_STATUS_OK;
+}
+
+ESP32_DESFire::DF_StatusCode ESP32_DESFire::DF_Plain_GetKeySettings(byte* backKeySettings, byte* backKeyCount) {
+  DF_CommandApdu<DF_Commands::GET_KEY_SETTINGS> apdu;
+
+  byte backData[KEY_SETTINGS_SIZE];
+  byte backLen = sizeof(backData);
+
+  DF_StatusCode statusCode;
+  statusCode = DF_Plain_Command_native(DF_Commands::GET_KEY_SETTINGS, apdu.data, apdu.LENGTH, backData, &backLen);
+  if (statusCode != DF_STATUS_OK)
+    return statusCode;
+
+  *backKeySettings = backData[0];
+  *backKeyCount = backData[1];
+  return DF_STATUS_OK;
+}
+
 /////////////////////////////////////////////////////////////////////////////////////
 //
 // Data File management
 //
 /////////////////////////////////////////////////////////////////////////////////////
 
-ESP32_DESFire::DF_StatusCode ESP32_DESFire::DF_Plain_ReadData_Simple(byte fileNo, uint16_t length, byte offset, byte* backReadData, uint16_t* backReadLen) {
-  ESP32_DESFire::DF_StatusCode df_statusCode;
-
-  byte sendData[13];
-
-  sendData[0] = 0x90;                    // CLA
-  sendData[1] = DESFIRE_READ_DATA_FILE;  // CMD 0xAD
-  sendData[2] = 0x00;                    // P1
-  sendData[3] = 0x00;                    // P2
-  sendData[4] = 0x07;                    // LC
-  sendData[5] = fileNo;                  // FileNo
-  sendData[6] = offset;                  // Offset
-  sendData[7] = 0x00;                    // (Offset)
-  sendData[8] = 0x00;                    // (Offset)
-  sendData[9] = length;                  // Length
-  sendData[10] = 0x00;                   // (Length)
-  sendData[11] = 0x00;                   // (Length)
-  sendData[12] = 0x00;                   // Le
+ESP32_DESFire::DF_StatusCode ESP32_DESFire::DF_Plain_ReadData_Simple(byte fileNo, uint16_t length, uint16_t offset, byte* backReadData, uint16_t* backReadLen) {
+  // FileNo, Offset (3), Length (3)
+  DF_CommandApdu<DF_Commands::READ_DATA> apdu(fileNo, DF_Uint24{ offset }, DF_Uint24{ length });
 
   byte backData[MAX_BUFFER_SIZE];
   byte backLen = MAX_BUFFER_SIZE;
 
   DF_StatusCode statusCode;
-  statusCode = DF_BasicTransceive(sendData, sizeof(sendData), backData, &backLen);
+  statusCode = DF_Plain_Command_native(DF_Commands::READ_DATA, apdu.data, apdu.LENGTH, backData, &backLen);
 
   if (statusCode != DF_STATUS_OK) {
-    return (DF_StatusCode)statusCode;
-  }
-
-  if (backLen < 2) return DF_WRONG_RESPONSE_LEN;  // something gone wrong
-
-  if (backData[backLen - 2] == 0x91 && backData[backLen - 1] != DF_STATUS_OK) {
     *backReadLen = 0;
-    return DF_InterpretErrorCode(&backData[backLen - 2]);
+    return statusCode;
   }
 
   // at this point our data is complete
-  if ((backLen - 2) != length) {
+  if (backLen != length)
     return DF_WRONG_RESPONSE_LEN;
-  }
 
-  if (*backReadLen < length) {
+  if (*backReadLen < length)
     return DF_STATUS_NO_ROOM;
-  }
 
-  if (backLen > 0)
-    memcpy(backReadData, backData, length);
+  memcpy(backReadData, backData, length);
   *backReadLen = length;
 
   return DF_STATUS_OK;
@@ -232,9 +326,12 @@ void ESP32_DESFire::dumpByteArray(const byte* byteArray, const byte arraySize) {
   Serial.println();
 }
 
-ESP32_DESFire::DF_StatusCode ESP32_DESFire::DF_Plain_WriteData_Simple(byte fileNo, byte length, byte offset, byte* sendData) {
+ESP32_DESFire::DF_StatusCode ESP32_DESFire::DF_Plain_WriteData_Simple(byte fileNo, byte length, uint16_t offset, byte* sendData) {
 
-  byte* sendData2 = new byte[length + 13];
+  // the command is built on the stack, the library does not use the heap
+  byte sendData2[MAX_COMMAND_SIZE];
+  if (length > MAX_COMMAND_SIZE - 13)
+    return DF_STATUS_INVALID;
 
   sendData2[0] = 0x90;                     // CLA
   sendData2[1] = DESFIRE_WRITE_DATA_FILE;  // CMD 0x8D
@@ -242,37 +339,156 @@ ESP32_DESFire::DF_StatusCode ESP32_DESFire::DF_Plain_WriteData_Simple(byte fileN
   sendData2[3] = 0x00;                     // P2
   sendData2[4] = 7 + length;               // Lc
   sendData2[5] = fileNo;                   // FileNo
-  sendData2[6] = offset;                   // Offset
-  sendData2[7] = 0x00;                     // (Offset)
-  sendData2[8] = 0x00;                     // (Offset)
-  sendData2[9] = length;                   // Length
-  sendData2[10] = 0x00;                    // (Length)
-  sendData2[11] = 0x00;                    // (Length)
+  DF_Field<DF_Uint24>::put(&sendData2[6], DF_Uint24{ offset });  // Offset (3)
+  DF_Field<DF_Uint24>::put(&sendData2[9], DF_Uint24{ length });  // Length (3)
   memcpy(&sendData2[12], sendData, length);
   sendData2[length + 12] = 0x00;  // Le
 
-  byte backData[64];
-  byte backLen = 64;
-
   ESP32_DESFire::DF_StatusCode statusCode;
-  statusCode = DF_BasicTransceive(sendData2, length + 13, backData, &backLen);
+  statusCode = DF_Plain_Command_native(DF_Commands::WRITE_DATA, sendData2, length + 13, NULL, NULL);
 
-  delete[] sendData2;
+  return statusCode;
+}
 
-  if (statusCode != DF_STATUS_OK)
-    return (DF_StatusCode)statusCode;
+// The card answers a read that is longer than one frame with 91AF, the following frames are
+// requested with GetMoreData (0xAF) until the card ends with 9100.
+ESP32_DESFire::DF_StatusCode ESP32_DESFire::DF_Plain_ReadData_native(byte fileNo, uint16_t offset, uint16_t length, byte* backReadData, uint16_t* backReadLen) {
+  DF_CommandApdu<DF_Commands::READ_DATA> apdu(fileNo, DF_Uint24{ offset }, DF_Uint24{ length });
 
-  if (backData[backLen - 2] != 0x91 || backData[backLen - 1] != 0x00)
-    return DF_InterpretErrorCode(&backData[backLen - 2]);
+  uint16_t received = *backReadLen;
+  DF_StatusCode statusCode;
+  statusCode = DF_Plain_CollectFrames_native(apdu.data, apdu.LENGTH, backReadData, &received);
+  if (statusCode != DF_STATUS_OK)
+    return statusCode;
 
-  if (backLen != 2)
+  // length 0 reads the complete file
+  if (length != 0 && received != length)
     return DF_WRONG_RESPONSE_LEN;
+  *backReadLen = received;
+  return DF_STATUS_OK;
+}
+
+ESP32_DESFire::DF_StatusCode ESP32_DESFire::DF_Plain_ReadFiles(const DF_FileReadRequest* requests, byte requestCount, byte* backRespData, uint16_t backRespSize, DF_FileReadResult* results) {
+  if (requestCount > MAX_READ_REQUESTS)
+    return DF_STATUS_INVALID;
+
+  DF_StatusCode firstError = DF_STATUS_OK;
+  uint16_t lengths[MAX_READ_REQUESTS];
+  byte order[MAX_READ_REQUESTS];
+
+  // the length of a request up to the end of the file is given by the file size
+  for (byte i = 0; i < requestCount; i++) {
+    results[i].statusCode = DF_STATUS_OK;
+    results[i].bufferOffset = 0;
+    results[i].length = 0;
+    lengths[i] = requests[i].length;
+    if (lengths[i] == 0) {
+      uint32_t fileSize;
+      DF_StatusCode statusCode = DF_GetFileSize(requests[i].fileNo, &fileSize);
+      if (statusCode == DF_STATUS_OK && requests[i].offset > fileSize)
+        statusCode = BOUNDARY_ERROR;
+      if (statusCode == DF_STATUS_OK && fileSize - requests[i].offset > 0xFFFF)
+        statusCode = DF_STATUS_NO_ROOM;
+      if (statusCode != DF_STATUS_OK) {
+        results[i].statusCode = statusCode;
+        if (firstError == DF_STATUS_OK)
+          firstError = statusCode;
+      } else {
+        lengths[i] = fileSize - requests[i].offset;
+      }
+    }
+    // sorted by file and offset, so the ranges of one file follow each other
+    byte position = i;
+    while (position > 0) {
+      const DF_FileReadRequest& previous = requests[order[position - 1]];
+      if (previous.fileNo < requests[i].fileNo || (previous.fileNo == requests[i].fileNo && previous.offset <= requests[i].offset))
+        break;
+      order[position] = order[position - 1];
+      position--;
+    }
+    order[position] = i;
+  }
 
+  uint16_t used = 0;
+  byte first = 0;
+  while (first < requestCount) {
+    const DF_FileReadRequest& request = requests[order[first]];
+    if (results[order[first]].statusCode != DF_STATUS_OK) {
+      first++;
+      continue;
+    }
+
+    // merge the following requests of the file that start in or shortly behind the range
+    uint16_t rangeStart = request.offset;
+    uint32_t rangeEnd = (uint32_t)request.offset + lengths[order[first]];
+    byte last = first + 1;
+    while (last < requestCount) {
+      byte next = order[last];
+      if (requests[next].fileNo != request.fileNo || results[next].statusCode != DF_STATUS_OK)
+        break;
+      if (requests[next].offset > rangeEnd + READ_MERGE_GAP)
+        break;
+      if ((uint32_t)requests[next].offset + lengths[next] > rangeEnd)
+        rangeEnd = (uint32_t)requests[next].offset + lengths[next];
+      last++;
+    }
+
+    DF_StatusCode statusCode = DF_STATUS_OK;
+    uint32_t rangeLength = rangeEnd - rangeStart;
+    if (used + rangeLength > backRespSize) {
+      statusCode = DF_STATUS_NO_ROOM;
+    } else if (rangeLength > 0) {
+      // length 0 would read the complete file, an empty range needs no command
+      uint16_t readLength = rangeLength;
+      statusCode = DF_Plain_ReadData_native(request.fileNo, rangeStart, rangeLength, &backRespData[used], &readLength);
+    }
+
+    for (byte i = first; i < last; i++) {
+      results[order[i]].statusCode = statusCode;
+      if (statusCode == DF_STATUS_OK) {
+        results[order[i]].bufferOffset = used + requests[order[i]].offset - rangeStart;
+        results[order[i]].length = lengths[order[i]];
+      }
+    }
+    if (statusCode == DF_STATUS_OK)
+      used += rangeLength;
+    else if (firstError == DF_STATUS_OK)
+      firstError = statusCode;
+    first = last;
+  }
+
+  return firstError;
+}
+
+// The size of a standard or backup data file, taken from GetFileSettings once per application
+ESP32_DESFire::DF_StatusCode ESP32_DESFire::DF_GetFileSize(byte fileNo, uint32_t* backSize) {
+  for (byte i = 0; i < fileSizeCacheCount; i++) {
+    if (fileSizeCache[i].fileNo == fileNo) {
+      *backSize = fileSizeCache[i].size;
+      return DF_STATUS_OK;
+    }
+  }
+
+  byte settings[FILE_SETTINGS_SIZE];
+  byte settingsLen = sizeof(settings);
+  DF_StatusCode statusCode = DF_Plain_GetFileSettings(fileNo, settings, &settingsLen);
+  if (statusCode != DF_STATUS_OK)
+    return statusCode;
+  // FileType (0x00 standard, 0x01 backup), FileOption, AccessRights (2), FileSize (3)
+  if (settingsLen < 7 || settings[0] > 0x01)
+    return DF_STATUS_INVALID;
+
+  *backSize = settings[4] | ((uint32_t)settings[5] << 8) | ((uint32_t)settings[6] << 16);
+  if (fileSizeCacheCount < FILE_SIZE_CACHE_SIZE) {
+    fileSizeCache[fileSizeCacheCount].fileNo = fileNo;
+    fileSizeCache[fileSizeCacheCount].size = *backSize;
+    fileSizeCacheCount++;
+  }
   return DF_STATUS_OK;
 }
 
-// Note: the maximal length is 255 bytes as no int to LSB conversion is done
-ESP32_DESFire::DF_StatusCode ESP32_DESFire::DF_Plain_CreateStandardDataFile(byte fileNo, DF_CommMode commMode, byte accessRightsRwCar, byte accessRightsRW, byte length) {
+// the length is sent with 3 bytes, the card limits it to its free memory
+ESP32_DESFire::DF_StatusCode ESP32_DESFire::DF_Plain_CreateStandardDataFile(byte fileNo, DF_CommMode commMode, byte accessRightsRwCar, byte accessRightsRW, uint32_t length) {
   return DF_Plain_CreateDataFile_native(DESFIRE_CREATE_STANDARD_DATA_FILE, fileNo, commMode, accessRightsRwCar, accessRightsRW, length);
 }
 
@@ -296,76 +512,48 @@ ESP32_DESFire::DF_StatusCode ESP32_DESFire::DF_Plain_CreateStandardFileDefaultFr
   return DF_Plain_CreateStandardDataFile(fileNo, commMode, accessRightsRwCar, accessRightsRW, fileSize);
 }
 
-// Note: the maximal length is 255 bytes as no int to LSB conversion is implemented
-ESP32_DESFire::DF_StatusCode ESP32_DESFire::DF_Plain_CreateDataFile_native(byte Cmd, byte fileNo, DF_CommMode commMode, byte accessRightsRwCar, byte accessRightsRW, byte length) {
-  byte sendData[13];
-
-  sendData[0] = 0x90;               // CLA
-  sendData[1] = Cmd;                // Standard Data: 0xCD or Backup Data: 0xCB
-  sendData[2] = 0x00;               // P1
-  sendData[3] = 0x00;               // P2
-  sendData[4] = 0x07;               // LC
-  sendData[5] = fileNo;             // FileNo
-  sendData[6] = commMode;           // CommunicationMode 00 = Plain, 01 = MAC, 03 = Full
-  sendData[7] = accessRightsRwCar;  // Access Rights for R&W and CAR keys
-  sendData[8] = accessRightsRW;     // Access Rights for R and W keys
-  sendData[9] = length;             // Length LSB
-  sendData[10] = 0x00;              // (Length) ### needs an int -> LSB conversion
-  sendData[11] = 0x00;              // (Length)
-  sendData[12] = 0x00;              // Le
-
-  byte backData[61];
-  byte backLen = 61;
-
-  DF_StatusCode statusCode;
-  statusCode = DF_BasicTransceive(sendData, sizeof(sendData), backData, &backLen);
-
-  if (statusCode != DF_STATUS_OK)
-    return (DF_StatusCode)statusCode;
+ESP32_DESFire::DF_StatusCode ESP32_DESFire::DF_Plain_DeleteFile(byte fileNo) {
+  DF_CommandApdu<DF_Commands::DELETE_FILE> apdu(fileNo);
 
-  if (backData[backLen - 2] != 0x91 || backData[backLen - 1] != 0x00)
-    return DF_InterpretErrorCode(&backData[backLen - 2]);
+  // a new file with the same number can have another size and settings
+  fileSettingsIsValid = false;
+  fileSizeCacheCount = 0;
+  return DF_Plain_Command_native(DF_Commands::DELETE_FILE, apdu.data, apdu.LENGTH, NULL, NULL);
+}
 
-  if (backLen > length + 2)
-    return DF_WRONG_RESPONSE_LEN;
+ESP32_DESFire::DF_StatusCode ESP32_DESFire::DF_Plain_GetFileIds(byte* backFileIds, byte* backFileIdsLen) {
+  DF_CommandApdu<DF_Commands::GET_FILE_IDS> apdu;
+  return DF_Plain_Command_native(DF_Commands::GET_FILE_IDS, apdu.data, apdu.LENGTH, backFileIds, backFileIdsLen);
+}
 
-  return DF_STATUS_OK;
+ESP32_DESFire::DF_StatusCode ESP32_DESFire::DF_Plain_CreateDataFile_native(byte Cmd, byte fileNo, DF_CommMode commMode, byte accessRightsRwCar, byte accessRightsRW, uint32_t length) {
+  // FileNo, CommunicationMode (00 = Plain, 01 = MAC, 03 = Full), Access Rights RW/CAR and R/W, Length (3)
+  DF_CommandApdu<DF_Commands::CREATE_STANDARD_DATA_FILE> apdu(fileNo, (byte)commMode, accessRightsRwCar, accessRightsRW, DF_Uint24{ length });
+  // Standard Data: 0xCD or Backup Data: 0xCB share the layout
+  apdu.data[1] = Cmd;
+  return DF_Plain_Command_native(DF_Commands::CREATE_STANDARD_DATA_FILE, apdu.data, apdu.LENGTH, NULL, NULL);
 }
 
 ESP32_DESFire::DF_StatusCode ESP32_DESFire::DF_Plain_GetFileSettings(byte fileNo, byte* backRespData, byte* backRespLen) {
-  byte sendData[7];
+  DF_CommandApdu<DF_Commands::GET_FILE_SETTINGS> apdu(fileNo);
 
-  sendData[0] = 0x90;                       // CLA
-  sendData[1] = DESFIRE_GET_FILE_SETTINGS;  // CMD 0xF5
-  sendData[2] = 0x00;                       // P1
-  sendData[3] = 0x00;                       // P2
-  sendData[4] = 0x01;                       // Lc
-  sendData[5] = fileNo;                     // FileNo
-  sendData[6] = 0x00;                       // Le
-
-  byte backData[61];
-  byte backLen = 61;
+  byte backData[FILE_SETTINGS_RESPONSE_SIZE];
+  byte backLen = sizeof(backData);
 
   DF_StatusCode statusCode;
-  statusCode = DF_BasicTransceive(sendData, sizeof(sendData), backData, &backLen);
+  statusCode = DF_Plain_Command_native(DF_Commands::GET_FILE_SETTINGS, apdu.data, apdu.LENGTH, backData, &backLen);
 
   if (statusCode != DF_STATUS_OK)
-    return (DF_StatusCode)statusCode;
-
-  if (backData[backLen - 2] != 0x91 || backData[backLen - 1] != 0x00)
-    return DF_InterpretErrorCode(&backData[backLen - 2]);
-
-  if (backLen < 9 || backLen > 36)
-    return DF_WRONG_RESPONSE_LEN;
+    return statusCode;
 
-  if (*backRespLen < backLen - 2)
+  if (*backRespLen < backLen)
     return DF_STATUS_NO_ROOM;
 
-  memcpy(backRespData, backData, backLen - 2);
-  *backRespLen = backLen - 2;
+  memcpy(backRespData, backData, backLen);
+  *backRespLen = backLen;
 
   fileSettingsIsValid = false;  // invalidate the old data
-  DF_GetFileSettingsAnalyzer(fileNo, backData, backLen - 10);
+  DF_GetFileSettingsAnalyzer(fileNo, backData, backLen - 8);
 
   return DF_STATUS_OK;
 }
@@ -408,9 +596,9 @@ void ESP32_DESFire::DF_FileSettingsDebugPrint() {
   } else if (fileSettingsFileType == 0x02) {
     // value file
     Serial.printf("File Size         : %d\n", fileSettingsFileSize);
-    Serial.printf("Lower Limit       : %d\n", fileSettingsLowerLimit);
-    Serial.printf("Upper Limit       : %d\n", fileSettingsUpperLimit);
-    Serial.printf("Limited Credit    : %d\n", fileSettingsLimitedCreditValue);
+    Serial.printf("Lower Limit       : %ld\n", (long)fileSettingsLowerLimit);
+    Serial.printf("Upper Limit       : %ld\n", (long)fileSettingsUpperLimit);
+    Serial.printf("Limited Credit    : %ld\n", (long)fileSettingsLimitedCreditValue);
     if (fileSettingsIsLimitedCreditEnabled) {
       Serial.println("Limtd Cred Enabld : YES");
     } else {
@@ -435,7 +623,11 @@ void ESP32_DESFire::DF_StatusCodeDebugPrint(DF_StatusCode statusCode) {
     case DF_STATUS_OK: Serial.println("SUCCESS"); break;
     case PERMISSION_DENIED: Serial.println("PERMISSION_DENIED ERROR"); break;
     case FILE_NOT_FOUND: Serial.println("FILE/APP NOT FOUND ERROR"); break;
+    case APPLICATION_NOT_FOUND: Serial.println("APPLICATION NOT FOUND ERROR"); break;
     case DUPLICATE_ERROR: Serial.println("DUPLICATE ERROR"); break;
+    case BOUNDARY_ERROR: Serial.println("BOUNDARY ERROR (value file limits exceeded)"); break;
+    case COMMAND_ABORTED: Serial.println("COMMAND ABORTED (transaction discarded)"); break;
+    case DF_STATUS_TIMEOUT: Serial.println("TIMEOUT (time budget spent)"); break;
     default: Serial.println("FAIL (not categorized)"); break;
   }
 }
@@ -481,9 +673,9 @@ CommMode.Full      - 11b
       fileSettingsIsValid = true;
     } else if (fileSettingsFileType == 0x02) {
       // value file
-      fileSettingsLowerLimit = resData[4] + (resData[5] * 256) + (resData[6] * 65536) + (resData[7] * 16777216);
-      fileSettingsUpperLimit = resData[8] + (resData[9] * 256) + (resData[10] * 65536) + (resData[11] * 16777216);
-      fileSettingsLimitedCreditValue = resData[12] + (resData[13] * 256) + (resData[14] * 65536) + (resData[15] * 16777216);
+      fileSettingsLowerLimit = convertUint8_t4_2Int32Lsb(&resData[4]);
+      fileSettingsUpperLimit = convertUint8_t4_2Int32Lsb(&resData[8]);
+      fileSettingsLimitedCreditValue = convertUint8_t4_2Int32Lsb(&resData[12]);
       fileSettingsIsLimitedCreditEnabled = bitRead(resData[16], 0);
       fileSettingsIsFreeAccessToGetValue = bitRead(resData[16], 1);
       fileSettingsIsValid = true;
@@ -503,6 +695,283 @@ CommMode.Full      - 11b
   return fileSettingsIsValid;
 }
 
+/////////////////////////////////////////////////////////////////////////////////////
+//
+// ISO 7816-4 File management
+//
+/////////////////////////////////////////////////////////////////////////////////////
+
+ESP32_DESFire::DF_StatusCode ESP32_DESFire::DF_Iso_SelectApplication(const byte* dfName, byte dfNameLen) {
+  if (dfNameLen == 0 || dfNameLen > ISO_MAX_DF_NAME_LENGTH)
+    return DF_STATUS_INVALID;
+
+  byte sendData[ISO_SELECT_SIZE];
+  sendData[0] = 0x00;             // CLA
+  sendData[1] = ISO_SELECT_FILE;  // INS 0xA4
+  sendData[2] = 0x04;             // P1 select by DF name
+  sendData[3] = 0x0C;             // P2 no response data
+  sendData[4] = dfNameLen;        // Lc
+  memcpy(&sendData[APDU_HEADER_SIZE], dfName, dfNameLen);
+
+  // the native selection is left, like on a card that selects another application
+  isApplicationSelected = false;
+  fileSettingsIsValid = false;
+  fileSizeCacheCount = 0;
+  isoSelectedFileId = 0;
+  return DF_Iso_Command_native(sendData, APDU_HEADER_SIZE + dfNameLen, NULL, NULL);
+}
+
+ESP32_DESFire::DF_StatusCode ESP32_DESFire::DF_Iso_SelectFile(uint16_t fileId) {
+  byte sendData[7];
+  sendData[0] = 0x00;             // CLA
+  sendData[1] = ISO_SELECT_FILE;  // INS 0xA4
+  sendData[2] = 0x02;             // P1 select an EF under the current DF
+  sendData[3] = 0x0C;             // P2 no response data
+  sendData[4] = 0x02;             // Lc
+  sendData[5] = fileId >> 8;      // file identifier, MSB first
+  sendData[6] = fileId & 0xff;
+
+  isoSelectedFileId = 0;
+  DF_StatusCode statusCode = DF_Iso_Command_native(sendData, sizeof(sendData), NULL, NULL);
+  if (statusCode == DF_STATUS_OK)
+    isoSelectedFileId = fileId;
+  return statusCode;
+}
+
+ESP32_DESFire::DF_StatusCode ESP32_DESFire::DF_Iso_ReadBinary(uint16_t offset, uint16_t length, byte* backReadData, uint16_t* backReadLen) {
+  if (length == 0 || (uint32_t)offset + length > (uint32_t)ISO_MAX_OFFSET + 1)
+    return DF_STATUS_INVALID;
+  if (*backReadLen < length)
+    return DF_STATUS_NO_ROOM;
+
+  byte sendData[APDU_HEADER_SIZE];
+  uint16_t received = 0;
+  DF_StatusCode statusCode;
+
+  while (received < length) {
+    byte chunk = (length - received > ISO_CHUNK) ? ISO_CHUNK : length - received;
+    uint16_t position = offset + received;
+    sendData[0] = 0x00;             // CLA
+    sendData[1] = ISO_READ_BINARY;  // INS 0xB0
+    sendData[2] = position >> 8;    // P1 offset MSB (bit 7 = 0)
+    sendData[3] = position & 0xff;  // P2 offset LSB
+    sendData[4] = chunk;            // Le
+
+    byte backLen = chunk;
+    statusCode = DF_Iso_Command_native(sendData, sizeof(sendData), &backReadData[received], &backLen);
+    if (statusCode != DF_STATUS_OK)
+      return statusCode;
+    if (backLen != chunk)
+      return DF_WRONG_RESPONSE_LEN;
+    received += chunk;
+  }
+
+  *backReadLen = received;
+  return DF_STATUS_OK;
+}
+
+ESP32_DESFire::DF_StatusCode ESP32_DESFire::DF_Iso_UpdateBinary(uint16_t offset, const byte* data, uint16_t length) {
+  if (length == 0 || (uint32_t)offset + length > (uint32_t)ISO_MAX_OFFSET + 1)
+    return DF_STATUS_INVALID;
+
+  byte sendData[APDU_HEADER_SIZE + ISO_CHUNK];
+  uint16_t sent = 0;
+  DF_StatusCode statusCode;
+
+  while (sent < length) {
+    byte chunk = (length - sent > ISO_CHUNK) ? ISO_CHUNK : length - sent;
+    uint16_t position = offset + sent;
+    sendData[0] = 0x00;               // CLA
+    sendData[1] = ISO_UPDATE_BINARY;  // INS 0xD6
+    sendData[2] = position >> 8;      // P1 offset MSB (bit 7 = 0)
+    sendData[3] = position & 0xff;    // P2 offset LSB
+    sendData[4] = chunk;              // Lc
+    memcpy(&sendData[APDU_HEADER_SIZE], &data[sent], chunk);
+
+    statusCode = DF_Iso_Command_native(sendData, APDU_HEADER_SIZE + chunk, NULL, NULL);
+    if (statusCode != DF_STATUS_OK)
+      return statusCode;
+    sent += chunk;
+  }
+  return DF_STATUS_OK;
+}
+
+void ESP32_DESFire::DF_SetAccessPath(DF_AccessPath path) {
+  accessPath = path;
+}
+
+// The throughput is compared as bytes per microsecond of both paths, cross multiplied
+ESP32_DESFire::DF_AccessPath ESP32_DESFire::DF_GetPreferredPath(bool isWrite) {
+  if (accessPath != DF_PATH_AUTO)
+    return accessPath;
+  const DF_PathStats& native = pathStats[isWrite][DF_PATH_NATIVE - 1];
+  const DF_PathStats& iso = pathStats[isWrite][DF_PATH_ISO - 1];
+  // each path is measured once before the faster one is used
+  if (native.micros == 0)
+    return DF_PATH_NATIVE;
+  if (iso.micros == 0)
+    return DF_PATH_ISO;
+  return ((uint64_t)iso.bytes * native.micros > (uint64_t)native.bytes * iso.micros) ? DF_PATH_ISO : DF_PATH_NATIVE;
+}
+
+uint32_t ESP32_DESFire::DF_GetPathThroughput(DF_AccessPath path, bool isWrite) {
+  if (path == DF_PATH_AUTO)
+    path = DF_GetPreferredPath(isWrite);
+  const DF_PathStats& stats = pathStats[isWrite][path - 1];
+  if (stats.micros == 0)
+    return 0;
+  return (uint64_t)stats.bytes * 1000000 / stats.micros;
+}
+
+ESP32_DESFire::DF_StatusCode ESP32_DESFire::DF_ReadStandardFile(byte fileNo, uint16_t isoFileId, uint16_t offset, uint16_t length, byte* backReadData, uint16_t* backReadLen) {
+  DF_AccessPath path = DF_ChoosePath(isoFileId, false);
+  unsigned long startMicros = micros();
+  DF_StatusCode statusCode;
+
+  if (path == DF_PATH_ISO) {
+    statusCode = DF_STATUS_OK;
+    // ReadBinary needs the length, length 0 reads up to the end of the file
+    if (length == 0) {
+      uint32_t fileSize;
+      statusCode = DF_GetFileSize(fileNo, &fileSize);
+      if (statusCode == DF_STATUS_OK && fileSize <= offset)
+        statusCode = BOUNDARY_ERROR;
+      length = fileSize - offset;
+    }
+    // the selection is part of the cost of the path, it is kept for the following accesses
+    if (statusCode == DF_STATUS_OK && isoSelectedFileId != isoFileId)
+      statusCode = DF_Iso_SelectFile(isoFileId);
+    if (statusCode == DF_STATUS_OK)
+      statusCode = DF_Iso_ReadBinary(offset, length, backReadData, backReadLen);
+  } else {
+    statusCode = DF_Plain_ReadData_native(fileNo, offset, length, backReadData, backReadLen);
+  }
+
+  if (statusCode == DF_STATUS_OK)
+    DF_RecordPath(path, false, *backReadLen, micros() - startMicros);
+  return statusCode;
+}
+
+ESP32_DESFire::DF_StatusCode ESP32_DESFire::DF_WriteStandardFile(byte fileNo, uint16_t isoFileId, uint16_t offset, const byte* data, uint16_t length) {
+  DF_AccessPath path = DF_ChoosePath(isoFileId, true);
+  unsigned long startMicros = micros();
+  DF_StatusCode statusCode = DF_STATUS_OK;
+
+  if (path == DF_PATH_ISO) {
+    if (isoSelectedFileId != isoFileId)
+      statusCode = DF_Iso_SelectFile(isoFileId);
+    if (statusCode == DF_STATUS_OK)
+      statusCode = DF_Iso_UpdateBinary(offset, data, length);
+  } else {
+    // the native write is sent in pieces that do not need additional frames
+    for (uint16_t sent = 0; sent < length && statusCode == DF_STATUS_OK;) {
+      byte chunk = (length - sent > NATIVE_WRITE_CHUNK) ? NATIVE_WRITE_CHUNK : length - sent;
+      statusCode = DF_Plain_WriteData_Simple(fileNo, chunk, offset + sent, (byte*)&data[sent]);
+      sent += chunk;
+    }
+  }
+
+  if (statusCode == DF_STATUS_OK)
+    DF_RecordPath(path, true, length, micros() - startMicros);
+  return statusCode;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+//
+// Value File management
+//
+/////////////////////////////////////////////////////////////////////////////////////
+
+// limitedCreditOptions: bit 0 = LimitedCredit enabled, bit 1 = free access to GetValue
+ESP32_DESFire::DF_StatusCode ESP32_DESFire::DF_Plain_CreateValueFile(byte fileNo, DF_CommMode commMode, byte accessRightsRwCar, byte accessRightsRW, int32_t lowerLimit, int32_t upperLimit, int32_t value, byte limitedCreditOptions) {
+  // FileNo, CommunicationMode, Access Rights RW/CAR and R/W, lower limit, upper limit, value, LimitedCredit / free GetValue
+  DF_CommandApdu<DF_Commands::CREATE_VALUE_FILE> apdu(fileNo, (byte)commMode, accessRightsRwCar, accessRightsRW, lowerLimit, upperLimit, value, limitedCreditOptions);
+  return DF_Plain_Command_native(DF_Commands::CREATE_VALUE_FILE, apdu.data, apdu.LENGTH, NULL, NULL);
+}
+
+// This gives a Value File with free accessible data, LimitedCredit and free GetValue are disabled
+ESP32_DESFire::DF_StatusCode ESP32_DESFire::DF_Plain_CreateValueFileDefaultFreeAccess(byte fileNo, int32_t lowerLimit, int32_t upperLimit, int32_t value, DF_CommMode commMode) {
+  byte accessRightsRwCar = 0xEE;  // free R&W and CAR access rights
+  byte accessRightsRW = 0xEE;     // free R and W access rights
+  return DF_Plain_CreateValueFile(fileNo, commMode, accessRightsRwCar, accessRightsRW, lowerLimit, upperLimit, value, 0x00);
+}
+
+// Note: GetValue returns the committed value, pending Credit or Debit operations are not included
+ESP32_DESFire::DF_StatusCode ESP32_DESFire::DF_Plain_GetValue(byte fileNo, int32_t* backValue) {
+  DF_CommandApdu<DF_Commands::GET_VALUE> apdu(fileNo);
+
+  byte backData[VALUE_SIZE];
+  byte backLen = sizeof(backData);
+
+  DF_StatusCode statusCode;
+  statusCode = DF_Plain_Command_native(DF_Commands::GET_VALUE, apdu.data, apdu.LENGTH, backData, &backLen);
+
+  if (statusCode != DF_STATUS_OK)
+    return statusCode;
+
+  *backValue = convertUint8_t4_2Int32Lsb(backData);
+
+  return DF_STATUS_OK;
+}
+
+ESP32_DESFire::DF_StatusCode ESP32_DESFire::DF_Plain_Credit(byte fileNo, int32_t value) {
+  return DF_Plain_ValueOperation_native(DF_Commands::CREDIT, fileNo, value);
+}
+
+ESP32_DESFire::DF_StatusCode ESP32_DESFire::DF_Plain_Debit(byte fileNo, int32_t value) {
+  return DF_Plain_ValueOperation_native(DF_Commands::DEBIT, fileNo, value);
+}
+
+ESP32_DESFire::DF_StatusCode ESP32_DESFire::DF_Plain_LimitedCredit(byte fileNo, int32_t value) {
+  return DF_Plain_ValueOperation_native(DF_Commands::LIMITED_CREDIT, fileNo, value);
+}
+
+// The card validates the complete transaction on commit, so a BOUNDARY_ERROR here means that
+// the sum of the pending operations exceeds the limits of at least one value file. On any
+// error the card discards all pending operations.
+ESP32_DESFire::DF_StatusCode ESP32_DESFire::DF_Plain_CommitTransaction() {
+  DF_StatusCode statusCode;
+  statusCode = DF_Plain_TransactionCommand_native(DF_Commands::COMMIT_TRANSACTION);
+  valueOperationsPending = 0;
+  return statusCode;
+}
+
+ESP32_DESFire::DF_StatusCode ESP32_DESFire::DF_Plain_AbortTransaction() {
+  DF_StatusCode statusCode;
+  statusCode = DF_Plain_TransactionCommand_native(DF_Commands::ABORT_TRANSACTION);
+  valueOperationsPending = 0;
+  return statusCode;
+}
+
+// All operations have to address value files in the currently selected application.
+// The values are sent frame by frame, but only one CommitTransaction is used for all of them.
+ESP32_DESFire::DF_StatusCode ESP32_DESFire::DF_Plain_ValueTransaction(DF_ValueOperation* ops, byte opCount, byte* backFailedIndex) {
+  DF_StatusCode statusCode;
+
+  for (byte i = 0; i < opCount; i++) {
+    const DF_CommandDescriptor* command = DF_Commands::find(ops[i].type);
+    if (command == NULL)
+      statusCode = DF_STATUS_INVALID;
+    else
+      statusCode = DF_Plain_ValueOperation_native(*command, ops[i].fileNo, ops[i].value);
+    if (statusCode != DF_STATUS_OK) {
+      *backFailedIndex = i;
+      DF_Plain_AbortTransaction();
+      return statusCode;
+    }
+  }
+
+  statusCode = DF_Plain_CommitTransaction();
+  if (statusCode != DF_STATUS_OK)
+    *backFailedIndex = opCount;
+
+  return statusCode;
+}
+
+byte ESP32_DESFire::DF_GetPendingValueOperations() {
+  return valueOperationsPending;
+}
+
 /////////////////////////////////////////////////////////////////////////////////////
 //
 // PICC management
@@ -516,34 +985,32 @@ CommMode.Full      - 11b
 // Note: arguments in brackets are optional; SW1 and SW2 are not included in backRespData
 
 ESP32_DESFire::DF_StatusCode ESP32_DESFire::DF_Plain_GetVersion(byte* backRespData, byte* backRespLen) {
-  byte backData[29];
+  byte backData[VERSION_SIZE];
   byte backLen;
 
+  // the version is sent in three frames, the first two end with 91AF
+  DF_CommandApdu<DF_Commands::GET_VERSION> apdu;
+  DF_CommandApdu<DF_Commands::GET_VERSION_MORE> apduMore;
+
   ESP32_DESFire::DF_StatusCode statusCode;
-  statusCode = DF_Plain_GetVersion_native(DESFIRE_GET_VERSION, DESFIRE_GET_MORE_DATA, backData, &backLen);
+  backLen = 7;
+  statusCode = DF_Plain_Command_native(DF_Commands::GET_VERSION, apdu.data, apdu.LENGTH, backData, &backLen);
 
   if (statusCode != DF_STATUS_OK)
     return statusCode;
 
-  if (backLen != 7)
-    return DF_WRONG_RESPONSE_LEN;
-
-  statusCode = DF_Plain_GetVersion_native(DESFIRE_GET_MORE_DATA, DESFIRE_GET_MORE_DATA, &backData[7], &backLen);
+  backLen = 7;
+  statusCode = DF_Plain_Command_native(DF_Commands::GET_VERSION_MORE, apduMore.data, apduMore.LENGTH, &backData[7], &backLen);
 
   if (statusCode != DF_STATUS_OK)
     return statusCode;
 
-  if (backLen != 7)
-    return DF_WRONG_RESPONSE_LEN;
-
-  statusCode = DF_Plain_GetVersion_native(DESFIRE_GET_MORE_DATA, DESFIRE_SV2_OK, &backData[14], &backLen);
+  backLen = 15;
+  statusCode = DF_Plain_Command_native(DF_Commands::GET_VERSION_LAST, apduMore.data, apduMore.LENGTH, &backData[14], &backLen);
 
   if (statusCode != DF_STATUS_OK)
     return statusCode;
 
-  if (backLen != 14 && backLen != 15)
-    return DF_WRONG_RESPONSE_LEN;
-
   if (*backRespLen < backLen + 14)
     return DF_STATUS_NO_ROOM;
 
@@ -553,71 +1020,48 @@ ESP32_DESFire::DF_StatusCode ESP32_DESFire::DF_Plain_GetVersion(byte* backRespDa
   return DF_STATUS_OK;
 }
 
-ESP32_DESFire::DF_StatusCode ESP32_DESFire::DF_Plain_GetVersion_native(byte Cmd, byte expectedSV2, byte* backRespData, byte* backRespLen) {
-  byte sendData[5];
+// Credit (0x0C), Debit (0xDC) and LimitedCredit (0x1C) share the same command layout
+ESP32_DESFire::DF_StatusCode ESP32_DESFire::DF_Plain_ValueOperation_native(const DF_CommandDescriptor& command, byte fileNo, int32_t value) {
+  if (value < 0)
+    return DF_STATUS_INVALID;
 
-  sendData[0] = 0x90;  // CLA
-  sendData[1] = Cmd;   // CMD
-  sendData[2] = 0x00;  // P1
-  sendData[3] = 0x00;  // P2
-  sendData[4] = 0x00;  // Le
+  // Credit, Debit and LimitedCredit have the same layout: FileNo, value
+  DF_CommandApdu<DF_Commands::CREDIT> apdu(fileNo, value);
+  apdu.data[1] = command.cmd;
 
-  byte backData[61];
-  byte backLen = 61;
   DF_StatusCode statusCode;
-
-  statusCode = DF_BasicTransceive(sendData, sizeof(sendData), backData, &backLen);
+  statusCode = DF_Plain_Command_native(command, apdu.data, apdu.LENGTH, NULL, NULL);
 
   if (statusCode != DF_STATUS_OK)
-    return (DF_StatusCode)statusCode;
-
-  if (backData[backLen - 2] != 0x91 || backData[backLen - 1] != expectedSV2)
-    return DF_InterpretErrorCode(&backData[backLen - 2]);
-
-  if (backLen != 9 && backLen != 16 && backLen != 17 && backLen != 24 && backLen != 25)
-    return DF_WRONG_RESPONSE_LEN;
-
-  memcpy(backRespData, backData, backLen - 2);
-  *backRespLen = backLen - 2;
+    return statusCode;
 
+  valueOperationsPending++;
   return DF_STATUS_OK;
 }
 
-ESP32_DESFire::DF_StatusCode ESP32_DESFire::DF_Plain_GetFreeMemory(byte* backRespData, byte* backRespLen) {
-  byte sendData[5];
-
-  sendData[0] = 0x90;                     // CLA
-  sendData[1] = DESFIRE_GET_FREE_MEMORY;  // CMD 0x6E
-  sendData[2] = 0x00;                     // P1
-  sendData[3] = 0x00;                     // P2
-  sendData[4] = 0x00;                     // Le
-
-  byte backData[61];
-  byte backLen = 61;
-  DF_StatusCode statusCode;
-  statusCode = DF_BasicTransceive(sendData, sizeof(sendData), backData, &backLen);
-
-  if (statusCode != DF_STATUS_OK)
-    return statusCode;
-
-  if (backLen < 2)
-    return DF_WRONG_RESPONSE_LEN;
-
-  if (backData[backLen - 2] != 0x91 || backData[backLen - 1] != 0x00)
-    return DF_InterpretErrorCode(&backData[backLen - 2]);
-
-  if (backLen != 5)
-    return DF_WRONG_RESPONSE_LEN;
+// CommitTransaction (0xC7) and AbortTransaction (0xA7)
+ESP32_DESFire::DF_StatusCode ESP32_DESFire::DF_Plain_TransactionCommand_native(const DF_CommandDescriptor& command) {
+  // CommitTransaction and AbortTransaction have no parameters
+  DF_CommandApdu<DF_Commands::COMMIT_TRANSACTION> apdu;
+  apdu.data[1] = command.cmd;
+  return DF_Plain_Command_native(command, apdu.data, apdu.LENGTH, NULL, NULL);
+}
 
-  memcpy(backRespData, backData, backLen - 2);
-  *backRespLen = backLen - 2;
+ESP32_DESFire::DF_StatusCode ESP32_DESFire::DF_Plain_GetFreeMemory(byte* backRespData, byte* backRespLen) {
+  DF_CommandApdu<DF_Commands::GET_FREE_MEMORY> apdu;
+  return DF_Plain_Command_native(DF_Commands::GET_FREE_MEMORY, apdu.data, apdu.LENGTH, backRespData, backRespLen);
+}
 
-  return DF_STATUS_OK;
+// Read_Sig with the address 0x00 of the originality signature, without an authentication the
+// card sends the signature in plain
+ESP32_DESFire::DF_StatusCode ESP32_DESFire::DF_Plain_ReadSig(byte* backSignature, byte* backSignatureLen) {
+  DF_CommandApdu<DF_Commands::READ_SIG> apdu((byte)0x00);
+  return DF_Plain_Command_native(DF_Commands::READ_SIG, apdu.data, apdu.LENGTH, backSignature, backSignatureLen);
 }
 
 // This is returning the full response, not just the data without status codes
 ESP32_DESFire::DF_StatusCode ESP32_DESFire::DF_Plain_GetMoreData_native(byte* backRespData, byte* backRespLen) {
-  byte sendData[5];
+  byte sendData[APDU_HEADER_SIZE];
 
   sendData[0] = 0x90;                   // CLA
   sendData[1] = DESFIRE_GET_MORE_DATA;  // CMD 0xAF
@@ -625,8 +1069,9 @@ ESP32_DESFire::DF_StatusCode ESP32_DESFire::DF_Plain_GetMoreData_native(byte* ba
   sendData[3] = 0x00;                   // P2
   sendData[4] = 0x00;                   // Le
 
-  byte backData[61];
-  byte backLen = 61;
+  // a frame of the card up to the largest response of the reader
+  byte backData[RESPONSE_BUFFER_SIZE];
+  byte backLen = sizeof(backData);
   DF_StatusCode statusCode;
 
   statusCode = DF_BasicTransceive(sendData, sizeof(sendData), backData, &backLen);
@@ -634,14 +1079,21 @@ ESP32_DESFire::DF_StatusCode ESP32_DESFire::DF_Plain_GetMoreData_native(byte* ba
   if (statusCode != DF_STATUS_OK)
     return (DF_StatusCode)statusCode;
 
+  if (backLen < 2)
+    return DF_WRONG_RESPONSE_LEN;
+  if (backLen > sizeof(backData) || backLen > *backRespLen)
+    return DF_STATUS_NO_ROOM;
+
   memcpy(backRespData, backData, backLen);  // return the complete response
   *backRespLen = backLen;
 
   if (backData[backLen - 2] == 0x91 && backData[backLen - 1] == 0xAF) {
-    Serial.println("Get_More_Data Returning ADDITIONAL_FRAME");
+    if (COMM_DEBUG_PRINT)
+      Serial.println("Get_More_Data Returning ADDITIONAL_FRAME");
     return ADDITIONAL_FRAME;
   } else if (backData[backLen - 2] == 0x91 && backData[backLen - 1] == 0x00) {
-    Serial.println("Get_More_Data Returning DF_STATUS_OK");
+    if (COMM_DEBUG_PRINT)
+      Serial.println("Get_More_Data Returning DF_STATUS_OK");
     return DF_STATUS_OK;
   } else {
     return DF_UNKNOWN_ERROR;
@@ -695,16 +1147,27 @@ int ESP32_DESFire::convertUint8_t4_2IntLsb(byte* input) {
 }
 
 void ESP32_DESFire::convertIntTo3BytesLsb(int input, byte* output) {
-  byte* out = new byte[3];
   if (input > 16777215) {
     memset(output, 0, 3);
-    //memcpy(output, out, 3);
     return;
   }
-  out[0] = input & 0xff;
-  out[1] = (input >> 8) & 0xff;
-  out[2] = (input >> 16) & 0xff;
-  memcpy(output, out, 3);
+  output[0] = input & 0xff;
+  output[1] = (input >> 8) & 0xff;
+  output[2] = (input >> 16) & 0xff;
+}
+
+// value files are using signed 32 bit values
+void ESP32_DESFire::convertInt32To4BytesLsb(int32_t input, byte* output) {
+  uint32_t value = (uint32_t)input;
+  output[0] = value & 0xff;
+  output[1] = (value >> 8) & 0xff;
+  output[2] = (value >> 16) & 0xff;
+  output[3] = (value >> 24) & 0xff;
+}
+
+int32_t ESP32_DESFire::convertUint8_t4_2Int32Lsb(byte* input) {
+  uint32_t value = (uint32_t)input[0] | ((uint32_t)input[1] << 8) | ((uint32_t)input[2] << 16) | ((uint32_t)input[3] << 24);
+  return (int32_t)value;
 }
 
 void ESP32_DESFire::revertAid(byte* aid, byte* revertAid) {
@@ -721,85 +1184,291 @@ void ESP32_DESFire::revertAid(byte* aid, byte* revertAid) {
 //
 /////////////////////////////////////////////////////////////////////////////////////
 
+// This is the exchange used by all commands, it applies the recovery policy:
+// - a lost exchange (no or invalid answer from the PN532) activates the card again and
+//   restores the selected application, an idempotent command is then sent again
+// - COMMAND_ABORTED (91CA) is retried in place for idempotent commands
+// - AUTHENTICATION_DELAY (91AD) is retried with a growing pause
+// - a timed out exchange is handled like a lost one while the deadline is not reached,
+//   no retry or pause is started that would end after the deadline (DF_STATUS_TIMEOUT)
+// The status word is returned unchanged to the command when no retry is left.
 ESP32_DESFire::DF_StatusCode ESP32_DESFire::DF_BasicTransceive(byte* sendData, byte sendLen, byte* backData, byte* backLen) {
-  ESP32_DESFire::DF_StatusCode result;
-  bool success;
+  byte backCapacity = *backLen;
+  byte retries = 0;
+  byte authDelayRetries = 0;
+  uint16_t authDelayMs = recoveryPolicy.authDelayBackoffMs;
+  bool idempotent = DF_IsIdempotentCommand(sendData, sendLen);
+  DF_StatusCode statusCode;
+
+  while (true) {
+    *backLen = backCapacity;
+    statusCode = DF_BasicTransceive_native(sendData, sendLen, backData, backLen);
+    if (isRecoveryActive)
+      return statusCode;
+
+    DF_StatusCode retryReason = DF_STATUS_OK;
+    if (statusCode == DF_STATUS_TIMEOUT && DF_GetRemainingTime() == 0) {
+      // the time budget is spent, there is no time left for a retry
+      return statusCode;
+    } else if (statusCode == DF_STATUS_ERROR || statusCode == DF_STATUS_TIMEOUT) {
+      retryReason = statusCode;
+    } else if (statusCode == DF_STATUS_OK && *backLen == 2 && backData[0] == 0x91) {
+      if (backData[1] == 0xCA)
+        retryReason = COMMAND_ABORTED;
+      else if (backData[1] == 0xAD)
+        retryReason = AUTHENTICATION_DELAY;
+    }
+    if (retryReason == DF_STATUS_OK)
+      return statusCode;
+
+    if (retryReason == AUTHENTICATION_DELAY) {
+      if (authDelayRetries >= recoveryPolicy.maxAuthDelayRetries) {
+        recoveryFailureCounter++;
+        return statusCode;
+      }
+      if (DF_GetRemainingTime() < authDelayMs)
+        return DF_STATUS_TIMEOUT;
+      authDelayRetries++;
+      recoveryCounters[AUTHENTICATION_DELAY]++;
+      delay(authDelayMs);
+      authDelayMs *= 2;
+      continue;
+    }
+
+    if (retryReason != COMMAND_ABORTED && recoveryPolicy.reactivateOnRfLoss) {
+      // the card may have left the field: bring the session back even if the command is not
+      // sent again, so the next command finds the card in the expected state
+      if (!DF_ReactivateCard()) {
+        recoveryFailureCounter++;
+        return statusCode;
+      }
+    }
+
+    if (!idempotent || retries >= recoveryPolicy.maxRetries) {
+      recoveryFailureCounter++;
+      return statusCode;
+    }
+    if (DF_GetRemainingTime() < recoveryPolicy.retryDelayMs)
+      return DF_STATUS_TIMEOUT;
+    retries++;
+    recoveryCounters[retryReason]++;
+    delay(recoveryPolicy.retryDelayMs);
+  }
+}
+
+// Sends a command that was built from its descriptor and checks the response against it:
+// the status word has to be 91 00 (or 91 AF for a frame that is followed by more frames),
+// the length of the response data has to be in the range of the descriptor.
+// backRespLen: in = size of backRespData, out = length of the response data without the
+// status word; backRespData may be NULL for commands without response data.
+ESP32_DESFire::DF_StatusCode ESP32_DESFire::DF_Plain_Command_native(const DF_CommandDescriptor& command, byte* sendData, byte sendLen, byte* backRespData, byte* backRespLen) {
+  byte backData[RESPONSE_BUFFER_SIZE];
+  byte backLen = sizeof(backData);
+
+  DF_StatusCode statusCode;
+  statusCode = DF_BasicTransceive(sendData, sendLen, backData, &backLen);
+
+  if (statusCode != DF_STATUS_OK)
+    return statusCode;
+
+  if (backLen < 2)
+    return DF_WRONG_RESPONSE_LEN;
+
+  if (backData[backLen - 2] != 0x91 || backData[backLen - 1] != command.successSW2)
+    return DF_InterpretErrorCode(&backData[backLen - 2]);
+
+  byte dataLen = backLen - 2;
+  if (dataLen < command.minResponseLength || dataLen > command.maxResponseLength)
+    return DF_WRONG_RESPONSE_LEN;
+
+  if (backRespLen == NULL)
+    return DF_STATUS_OK;
+
+  if (*backRespLen < dataLen)
+    return DF_STATUS_NO_ROOM;
+
+  memcpy(backRespData, backData, dataLen);
+  *backRespLen = dataLen;
+
+  return DF_STATUS_OK;
+}
+
+ESP32_DESFire::DF_StatusCode ESP32_DESFire::DF_Plain_CollectFrames_native(byte* sendData, byte sendLen, byte* backRespData, uint16_t* backRespLen) {
+  DF_CommandApdu<DF_Commands::GET_VERSION_MORE> apduMore;
+
+  byte backData[RESPONSE_BUFFER_SIZE];
+  byte backLen;
+  uint16_t received = 0;
+  DF_StatusCode statusCode;
+
+  while (true) {
+    backLen = sizeof(backData);
+    statusCode = DF_BasicTransceive(sendData, sendLen, backData, &backLen);
+    if (statusCode != DF_STATUS_OK)
+      return statusCode;
+    if (backLen < 2)
+      return DF_WRONG_RESPONSE_LEN;
+    if (backData[backLen - 2] != 0x91 || (backData[backLen - 1] != DESFIRE_SV2_OK && backData[backLen - 1] != DESFIRE_GET_MORE_DATA))
+      return DF_InterpretErrorCode(&backData[backLen - 2]);
+
+    byte dataLen = backLen - 2;
+    if (received + dataLen > *backRespLen)
+      return DF_STATUS_NO_ROOM;
+    memcpy(&backRespData[received], backData, dataLen);
+    received += dataLen;
+
+    if (backData[backLen - 1] == DESFIRE_SV2_OK)
+      break;
+    sendData = apduMore.data;
+    sendLen = apduMore.LENGTH;
+  }
+
+  *backRespLen = received;
+  return DF_STATUS_OK;
+}
+
+// Commands that only read data can be sent again without changing the card
+bool ESP32_DESFire::DF_IsIdempotentCommand(byte* sendData, byte sendLen) {
+  if (sendLen < 2 || sendData[0] != 0x90)
+    return false;
+  const DF_CommandDescriptor* descriptor = DF_Commands::find(sendData[1]);
+  return (descriptor != NULL && descriptor->isIdempotent);
+}
+
+// ISO commands end with the status word 90 00, the response data (Le) is checked by the caller
+ESP32_DESFire::DF_StatusCode ESP32_DESFire::DF_Iso_Command_native(byte* sendData, byte sendLen, byte* backRespData, byte* backRespLen) {
+  byte backData[RESPONSE_BUFFER_SIZE];
+  byte backLen = sizeof(backData);
+
   DF_StatusCode statusCode;
-  byte bLen = 255;  // ### changed from 61 to 255
+  statusCode = DF_BasicTransceive(sendData, sendLen, backData, &backLen);
+
+  if (statusCode != DF_STATUS_OK)
+    return statusCode;
+
+  if (backLen < 2)
+    return DF_WRONG_RESPONSE_LEN;
+
+  if (backData[backLen - 2] != ISO_SW1_OK || backData[backLen - 1] != 0x00)
+    return DF_InterpretErrorCode(&backData[backLen - 2]);
+
+  byte dataLen = backLen - 2;
+  if (backRespLen == NULL)
+    return (dataLen == 0) ? DF_STATUS_OK : DF_WRONG_RESPONSE_LEN;
+
+  if (*backRespLen < dataLen)
+    return DF_STATUS_NO_ROOM;
+
+  memcpy(backRespData, backData, dataLen);
+  *backRespLen = dataLen;
+  return DF_STATUS_OK;
+}
+
+// A file without ISO file identifier is reached natively only. In DF_PATH_AUTO every
+// PATH_PROBE_INTERVAL access uses the other path, so a change of the reader or the card is seen.
+ESP32_DESFire::DF_AccessPath ESP32_DESFire::DF_ChoosePath(uint16_t isoFileId, bool isWrite) {
+  if (isoFileId == 0)
+    return DF_PATH_NATIVE;
+  DF_AccessPath path = DF_GetPreferredPath(isWrite);
+  if (accessPath == DF_PATH_AUTO && ++pathAccessCounter >= PATH_PROBE_INTERVAL) {
+    pathAccessCounter = 0;
+    path = (path == DF_PATH_ISO) ? DF_PATH_NATIVE : DF_PATH_ISO;
+  }
+  return path;
+}
+
+// The sums are halved when they grow large, so older measurements fade out
+void ESP32_DESFire::DF_RecordPath(DF_AccessPath path, bool isWrite, uint16_t bytes, uint32_t elapsedMicros) {
+  DF_PathStats& stats = pathStats[isWrite][path - 1];
+  stats.bytes += bytes;
+  stats.micros += (elapsedMicros == 0) ? 1 : elapsedMicros;
+  if (stats.bytes > 0x10000) {
+    stats.bytes /= 2;
+    stats.micros /= 2;
+  }
+}
+
+// Activates the card of this session again and restores the selected application.
+// A different card in the field is not accepted.
+bool ESP32_DESFire::DF_ReactivateCard() {
+  byte uid[MAX_UID_SIZE];
+  byte uidLength = sizeof(uid);
+
+  // a replaced exchange has no reader that could activate the card
+  if (exchangeHandler != NULL)
+    return false;
+
+  if (!transport.DF_Activate(uid, &uidLength))
+    return false;
+  if (sessionUidLength > 0 && (uidLength != sessionUidLength || memcmp(uid, sessionUid, sessionUidLength) != 0))
+    return false;
+
+  reactivationCounter++;
+  valueOperationsPending = 0;  // the card has discarded the open transaction
+  fileSettingsIsValid = false;
+  isoSelectedFileId = 0;
+  if (!isApplicationSelected)
+    return true;
+
+  byte aid[AID_SIZE];
+  memcpy(aid, selectedAid, AID_SIZE);
+  isRecoveryActive = true;
+  DF_StatusCode statusCode = DF_Plain_SelectApplication(aid);
+  isRecoveryActive = false;
+  return (statusCode == DF_STATUS_OK);
+}
+
+// The exchange is addressed to the target number of this instance, so two instances can
+// alternate between two cards that were activated with ESP32_DESFire_Targets.
+ESP32_DESFire::DF_StatusCode ESP32_DESFire::DF_BasicTransceive_native(byte* sendData, byte sendLen, byte* backData, byte* backLen) {
+  byte backCapacity = *backLen;
+  bool success;
+
   if (COMM_DEBUG_PRINT) {
     Serial.printf("Send length %d\n", sendLen);
     printHex(sendData, sendLen);
     Serial.println("");
   }
-  success = nfcLib->inDataExchange(sendData, sendLen, backData, &bLen);
+
+  // the exchange gets the command timeout, but not more than the time left until the deadline
+  uint32_t remainingMs = DF_GetRemainingTime();
+  if (remainingMs == 0) {
+    *backLen = 0;
+    return DF_STATUS_TIMEOUT;
+  }
+  uint16_t timeoutMs = (remainingMs < commandTimeoutMs) ? remainingMs : commandTimeoutMs;
+
+  unsigned long startMillis = millis();
+  unsigned long startMicros = micros();
+  if (exchangeHandler != NULL)
+    success = exchangeHandler->DF_Exchange(transport.DF_GetTargetNumber(), sendData, sendLen, backData, backLen);
+  else
+    success = transport.DF_Exchange(sendData, sendLen, backData, backLen, timeoutMs);
+
+  if (!success) {
+    DF_StatusCode statusCode = (millis() - startMillis >= timeoutMs) ? DF_STATUS_TIMEOUT : DF_STATUS_ERROR;
+    if (traceRecorder != NULL)
+      traceRecorder->DF_Record(transport.DF_GetTargetNumber(), sendData, sendLen, NULL, 0, statusCode, startMicros, micros() - startMicros);
+    *backLen = 0;
+    return statusCode;
+  }
+  if (*backLen > backCapacity) {
+    *backLen = 0;
+    return DF_STATUS_NO_ROOM;
+  }
+  if (traceRecorder != NULL)
+    traceRecorder->DF_Record(transport.DF_GetTargetNumber(), sendData, sendLen, backData, *backLen, DF_STATUS_OK, startMicros, micros() - startMicros);
+
   if (COMM_DEBUG_PRINT) {
-    Serial.printf("Recv length %d\n", bLen);
-    printHex(backData, bLen);
+    Serial.printf("Recv length %d\n", *backLen);
+    printHex(backData, *backLen);
     Serial.println("");
-    *backLen = bLen;
-    return DF_STATUS_OK;
-  } else {
-    *backLen = 0;
-    return DF_STATUS_ERROR;
   }
+  return DF_STATUS_OK;
 }
 
 ESP32_DESFire::DF_StatusCode ESP32_DESFire::DF_InterpretErrorCode(byte* SW1_2) {
-  uint16_t SW = SW1_2[0] << 8 | SW1_2[1];
-  switch (SW) {
-    case 0x6581:
-      return ESP32_DESFire::MEMORY_ERROR;
-    case 0x6700:
-      return ESP32_DESFire::LENGTH_ERROR;
-    case 0x6982:
-      return ESP32_DESFire::SECURITY_NOT_SATISFIED;
-    case 0x6985:
-      return ESP32_DESFire::CONDITIONS_NOT_SATISFIED;
-    case 0x6A82:
-      return ESP32_DESFire::FILE_OR_APP_NOT_FOUND;
-    case 0x6A86:
-      return ESP32_DESFire::INCORRECT_PARAMS;
-    case 0x6A87:
-      return ESP32_DESFire::INCORRECT_LC;
-    case 0x6A00:
-      return ESP32_DESFire::CLA_NOT_SUPPORTED;
-    case 0x910B:
-      return ESP32_DESFire::COMMAND_NOT_FOUND;
-    case 0x910C:
-      return ESP32_DESFire::COMMAND_FORMAT_ERROR;
-    case 0x911C:
-      return ESP32_DESFire::ILLEGAL_COMMAND_CODE;
-    case 0x911E:
-      return ESP32_DESFire::INTEGRITY_ERROR;
-    case 0x9140:
-      return ESP32_DESFire::NO_SUCH_KEY;
-    case 0x917E:
-      return ESP32_DESFire::LENGTH_ERROR;
-    case 0x919D:
-      return ESP32_DESFire::PERMISSION_DENIED;
-    case 0x919E:
-      return ESP32_DESFire::PARAMETER_ERROR;
-    case 0x91AD:
-      return ESP32_DESFire::AUTHENTICATION_DELAY;
-    case 0x91AE:
-      return ESP32_DESFire::AUTHENTICATION_ERROR;
-    case 0x91AF:
-      return ESP32_DESFire::ADDITIONAL_FRAME;
-    case 0x91BE:
-      return ESP32_DESFire::BOUNDARY_ERROR;
-    case 0x91CA:
-      return ESP32_DESFire::COMMAND_ABORTED;
-    case 0x91EE:
-      return ESP32_DESFire::MEMORY_ERROR;
-    case 0x91F0:
-      return ESP32_DESFire::FILE_NOT_FOUND;
-    case 0x91DE:
-      return ESP32_DESFire::DUPLICATE_ERROR;
-    case 0x910E:
-      return ESP32_DESFire::OUT_OF_EEPROM_ERROR;
-    default:
-      return ESP32_DESFire::DF_UNKNOWN_ERROR;
-  }
+  return DF_StatusWords::lookup(SW1_2[0] << 8 | SW1_2[1]);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////
@@ -14,6 +14,9 @@
  * In line 78 change one parameter
  * old: #define PN532_PACKBUFFSIZ 64 ///< Packet buffer size in bytes
  * new: #define PN532_PACKBUFFSIZ 255 ///< Packet buffer size in bytes
+ * and the public method 'sendCommandReadResponse' needs to be added
+ * (see the modified library in the 'Adafruit_PN532_modified' folder).
+ * The reader module is selected in 'ESP32_DESFire_Transport.h', the PN532 is the default.
  *
  * Author: Michael Fehr (AndroidCrypto)
 */
@@ -59,7 +62,10 @@ all PINs are on the right side of the dev board, seen from display side and USB
 #define ESP32_DESFire_h
 
 #include "Arduino.h"
-#include "Adafruit_PN532.h"
+#include "ESP32_DESFire_Transport.h"
+
+class DF_TraceRecorder;
+struct DF_CommandDescriptor;
 
 class ESP32_DESFire {
 
@@ -69,7 +75,11 @@ public:
   // Contructors
   /////////////////////////////////////////////////////////////////////////////////////
 
-  ESP32_DESFire(Adafruit_PN532* nfc);
+  // reader is the reader library object of the selected transport (see ESP32_DESFire_Transport),
+  // e.g. Adafruit_PN532 for the PN532.
+  // targetNumber is the logical target number (Tg) assigned by the PN532 on InListPassiveTarget,
+  // the PN532 can handle up to two targets at once (see ESP32_DESFire_Targets)
+  ESP32_DESFire(DF_Transport::Reader* reader, byte targetNumber = 1);
 
   const uint8_t DESFIRE_SIMPLE_LIBRARY_VERSION = 02;
   bool COMM_DEBUG_PRINT = true;  // if true the send and received data is printed
@@ -78,14 +88,33 @@ public:
 // Mifare DESFireCommands
 #define DESFIRE_CREATE_APPLICATION (0xCA)
 #define DESFIRE_SELECT_APPLICATION (0x5A)
+#define DESFIRE_GET_APPLICATION_IDS (0x6A)
+#define DESFIRE_GET_KEY_SETTINGS (0x45)
 #define DESFIRE_GET_VERSION (0x60)
 #define DESFIRE_GET_FILE_SETTINGS (0xF5)
 #define DESFIRE_GET_FREE_MEMORY (0x6E)
 #define DESFIRE_GET_MORE_DATA (0xAF)
 #define DESFIRE_CREATE_STANDARD_DATA_FILE (0xCD)
+#define DESFIRE_DELETE_FILE (0xDF)
+#define DESFIRE_GET_FILE_IDS (0x6F)
 #define DESFIRE_READ_DATA_FILE (0xBD)
 #define DESFIRE_WRITE_DATA_FILE (0x8D)
+#define DESFIRE_CREATE_VALUE_FILE (0xCC)
+#define DESFIRE_GET_VALUE (0x6C)
+#define DESFIRE_CREDIT (0x0C)
+#define DESFIRE_DEBIT (0xDC)
+#define DESFIRE_LIMITED_CREDIT (0x1C)
+#define DESFIRE_COMMIT_TRANSACTION (0xC7)
+#define DESFIRE_ABORT_TRANSACTION (0xA7)
+#define DESFIRE_READ_SIG (0x3C)
 #define DESFIRE_SV2_OK (0x00)
+#define DESFIRE_SV2_SIGNATURE (0x90)  // Read_Sig ends with 9190
+
+// ISO/IEC 7816-4 commands (CLA 0x00) for standard data files
+#define ISO_SELECT_FILE (0xA4)
+#define ISO_READ_BINARY (0xB0)
+#define ISO_UPDATE_BINARY (0xD6)
+#define ISO_SW1_OK (0x90)
 
   enum DF_StatusCode : byte {
     DF_STATUS_OK = 0,              // Success (and 0x9000, 0x9100 - OPERATION_OK / Successful operaton)
@@ -125,8 +154,9 @@ public:
     DF_CMD_CTR_OVERFLOW = 32,
     DF_UNKNOWN_ERROR = 33,
     DF_SDM_NOT_IMPLEMENTED_IN_LIB = 34,
-    DUPLICATE_ERROR = 35,      // (91DE) on application or file creation: file or application is existing
-    OUT_OF_EEPROM_ERROR = 36,  // (910E) on application or file creation: no more memory available
+    DUPLICATE_ERROR = 35,        // (91DE) on application or file creation: file or application is existing
+    OUT_OF_EEPROM_ERROR = 36,    // (910E) on application or file creation: no more memory available
+    APPLICATION_NOT_FOUND = 37,  // (91A0) Requested AID not present on PICC.
 
     DF_STATUS_MIFARE_NACK = 0xff  // A MIFARE PICC responded with NAK.
   };
@@ -137,10 +167,144 @@ public:
     DF_COMMMODE_FULL = 0x03    // 0b11
   };
 
-  // Limitations on PN532 readers
-  const uint8_t MAX_BUFFER_SIZE = 125;  // the internal buffer is 128 - 3 for status bytes
+  enum DF_ValueOperationType : byte {
+    DF_VALUE_CREDIT = DESFIRE_CREDIT,
+    DF_VALUE_DEBIT = DESFIRE_DEBIT,
+    DF_VALUE_LIMITED_CREDIT = DESFIRE_LIMITED_CREDIT
+  };
+
+  // one entry of a value transaction, see DF_Plain_ValueTransaction
+  struct DF_ValueOperation {
+    byte fileNo;
+    DF_ValueOperationType type;
+    int32_t value;  // always positive, the direction is given by the type
+  };
+
+  // one file range of DF_Plain_ReadFiles, length 0 reads up to the end of the file
+  struct DF_FileReadRequest {
+    byte fileNo;
+    uint16_t offset;
+    uint16_t length;
+  };
+
+  // where DF_Plain_ReadFiles has put the data of one request
+  struct DF_FileReadResult {
+    DF_StatusCode statusCode;
+    uint16_t bufferOffset;
+    uint16_t length;
+  };
+
+  // how DF_ReadStandardFile and DF_WriteStandardFile reach the file
+  enum DF_AccessPath : byte {
+    DF_PATH_AUTO = 0,    // the path with the higher measured throughput
+    DF_PATH_NATIVE = 1,  // ReadData and WriteData with the file number
+    DF_PATH_ISO = 2      // ISO SelectFile, ReadBinary and UpdateBinary with the ISO file identifier
+  };
+
+  // Recovery from transient failures, see DF_BasicTransceive
+  struct DF_RecoveryPolicy {
+    byte maxRetries = 2;                // retries in place of idempotent (reading) commands
+    uint16_t retryDelayMs = 5;          // pause before a retry
+    byte maxAuthDelayRetries = 3;       // retries on AUTHENTICATION_DELAY (91AD)
+    uint16_t authDelayBackoffMs = 100;  // first pause on AUTHENTICATION_DELAY, doubled for each retry
+    bool reactivateOnRfLoss = true;     // activate the card again after a lost exchange and restore the selected application
+  };
+
+  static const byte DF_STATUS_CODE_COUNT = APPLICATION_NOT_FOUND + 1;
+
+  // Limitations of the reader, given by the transport
+  static constexpr uint8_t MAX_BUFFER_SIZE = DF_Transport::MAX_RESPONSE_DATA;
+  static constexpr uint8_t MAX_COMMAND_SIZE = 255;  // sendLen is a byte
+  static constexpr byte MAX_READ_REQUESTS = 16;     // requests of one DF_Plain_ReadFiles
+  static constexpr byte FILE_SIZE_CACHE_SIZE = 8;   // file sizes kept for the selected application
+  static constexpr byte READ_MERGE_GAP = 16;        // unused bytes accepted to save a ReadData command
+  static constexpr byte NATIVE_WRITE_CHUNK = 48;    // WriteData data that fits into one frame of the card
+  // ReadBinary and UpdateBinary data of one APDU, the ISO-DEP chaining to the frame size of the
+  // card is done by the PN532 (or the MFRC522 transport)
+  static constexpr uint8_t ISO_CHUNK = MAX_BUFFER_SIZE;
+  static constexpr uint16_t ISO_MAX_OFFSET = 0x7FFF;  // 15 bit offset in P1 and P2
+  static constexpr byte PATH_PROBE_INTERVAL = 32;     // DF_PATH_AUTO measures the slower path again every 32nd time
+  // Buffers of the commands, summed up in ESP32_DESFire_Memory.h
+  static constexpr uint16_t RESPONSE_BUFFER_SIZE = MAX_BUFFER_SIZE + 2;  // data of one frame, SW1 and SW2
+  static constexpr byte APDU_HEADER_SIZE = 5;               // CLA, INS, P1, P2, Lc or Le
+  static constexpr byte ISO_MAX_DF_NAME_LENGTH = 16;
+  static constexpr byte ISO_SELECT_SIZE = APDU_HEADER_SIZE + ISO_MAX_DF_NAME_LENGTH;  // SelectFile by DF name
+  static constexpr byte KEY_SETTINGS_SIZE = 2;              // KeySettings, MaxNoOfKeys
+  static constexpr byte FILE_SETTINGS_RESPONSE_SIZE = 61;   // GetFileSettings response as the card sends it
+  static constexpr byte FILE_SETTINGS_SIZE = 34;            // settings of a data or value file kept by the callers
+  static constexpr byte VERSION_SIZE = 29;                  // GetVersion including the optional FabKeyID
+  static constexpr byte VALUE_SIZE = 4;                     // GetValue, LSB first
+  static constexpr byte MAX_UID_SIZE = 10;
+  static constexpr byte AID_SIZE = 3;
   const uint8_t PLAIN_MAX_WRITE_LENGTH = 96;
 
+  /////////////////////////////////////////////////////////////////////////////////////
+  //
+  // Target Handling
+  //
+  /////////////////////////////////////////////////////////////////////////////////////
+
+  void DF_SetTargetNumber(byte targetNumber);
+  byte DF_GetTargetNumber();
+  // the application selected by the last successful DF_Plain_SelectApplication
+  bool DF_GetSelectedApplication(byte* aid);
+  // drops the session state, call this when a new card is activated for this target
+  void DF_ResetSession();
+  // resets the session and binds it to the card activated with the target number and uid
+  void DF_StartSession(byte targetNumber, byte* uid, byte uidLength);
+  // activates a card in the field with the transport and starts its session,
+  // backUidLength: in = size of backUid, out = length of the UID
+  bool DF_ActivateCard(byte* backUid, byte* backUidLength);
+
+#ifdef DF_TRANSPORT_PN532
+  // Shares the host link with other readers (see ESP32_DESFire_Readers). The bus is released
+  // while the PN532 talks to the card; with irqPin connected the readiness is taken from the
+  // IRQ line instead of polling the PN532 status over the bus.
+  void DF_SetBusScheduler(DF_BusScheduler* bus, int8_t irqPin = -1);
+  // Sends a raw PN532 command (cmd[0] = command code) and returns the response data,
+  // using the bus scheduler if one is set
+  bool DF_PN532Command(byte* cmd, byte cmdLen, byte* resp, byte* respLen, uint16_t timeout);
+  // wakes the PN532 from PowerDown and sets the SAM to normal mode again
+  void DF_PN532Wakeup();
+#endif
+  // all card exchanges are sent to the handler instead of the reader, NULL restores the reader
+  void DF_SetExchangeHandler(DF_ExchangeHandler* handler);
+  // every card exchange is written to the recorder (see ESP32_DESFire_Trace), NULL stops the recording
+  void DF_SetTraceRecorder(DF_TraceRecorder* recorder);
+
+  /////////////////////////////////////////////////////////////////////////////////////
+  //
+  // Deadlines
+  //
+  /////////////////////////////////////////////////////////////////////////////////////
+
+  // longest time for one exchange with the card, default is the PN532 InDataExchange timeout
+  void DF_SetCommandTimeout(uint16_t timeoutMs);
+  // All following commands (and the frames and retries inside them) have to be finished at
+  // the deadline (a millis() value). An exchange is limited to the remaining time, a command
+  // that would start or wait after the deadline returns DF_STATUS_TIMEOUT.
+  void DF_SetDeadline(unsigned long deadlineMillis);
+  // sets the deadline to now + budgetMs, e.g. the latency budget of one tap
+  void DF_SetTimeBudget(uint32_t budgetMs);
+  void DF_ClearDeadline();
+  // remaining milliseconds until the deadline, 0xFFFFFFFF without a deadline
+  uint32_t DF_GetRemainingTime();
+
+  /////////////////////////////////////////////////////////////////////////////////////
+  //
+  // Error Recovery
+  //
+  /////////////////////////////////////////////////////////////////////////////////////
+
+  void DF_SetRecoveryPolicy(const DF_RecoveryPolicy& policy);
+  DF_RecoveryPolicy DF_GetRecoveryPolicy();
+  // number of retries that were triggered by the status code
+  uint16_t DF_GetRecoveryCounter(DF_StatusCode statusCode);
+  uint16_t DF_GetReactivationCounter();
+  uint16_t DF_GetRecoveryFailureCounter();  // failures that were left after all retries
+  void DF_ResetRecoveryCounters();
+  void DF_RecoveryDebugPrint();
+
   /////////////////////////////////////////////////////////////////////////////////////
   //
   // Application Handling
@@ -151,6 +315,12 @@ public:
   DF_StatusCode DF_Plain_SelectApplication(byte* aid);
   DF_StatusCode DF_Plain_CreateApplication(byte* aid, byte keySettings, byte appSettings);
   DF_StatusCode DF_Plain_CreateApplicationDefaultAes(byte* aid);
+  // backAids: 3 bytes for each application on the card, up to 28 applications (84 bytes)
+  DF_StatusCode DF_Plain_GetApplicationIds(byte* backAids, byte* backAidsLen);
+  // Key settings of the selected application (or the PICC): backKeySettings is the key
+  // settings byte of CreateApplication, backKeyCount the number of keys and the key type
+  // (the appSettings of CreateApplication)
+  DF_StatusCode DF_Plain_GetKeySettings(byte* backKeySettings, byte* backKeyCount);
 
   /////////////////////////////////////////////////////////////////////////////////////
   //
@@ -158,20 +328,84 @@ public:
   //
   /////////////////////////////////////////////////////////////////////////////////////
 
-  DF_StatusCode DF_Plain_CreateStandardDataFile(byte fileNo, DF_CommMode commMode, byte accessRightsRwCar, byte accessRightsRW, byte length);
+  DF_StatusCode DF_Plain_CreateStandardDataFile(byte fileNo, DF_CommMode commMode, byte accessRightsRwCar, byte accessRightsRW, uint32_t length);
   DF_StatusCode DF_Plain_CreateStandardFileDefault32(byte fileNo, DF_CommMode commMode);
   DF_StatusCode DF_Plain_CreateStandardFileDefaultSized(byte fileNo, byte fileSize, DF_CommMode commMode);
   DF_StatusCode DF_Plain_CreateStandardFileDefaultFreeAccessSized(byte fileNo, byte fileSize, DF_CommMode commMode);
-
-  DF_StatusCode DF_Plain_ReadData_Simple(byte fileNo, uint16_t length, byte offset, byte* backReadData, uint16_t* backReadLen);
+  // Note: without an authentication the card accepts DeleteFile when bit 2 of the key settings
+  // of the application allows it (CreateApplicationDefaultAes does). The memory of the file is
+  // given free by FormatPICC only, that needs the PICC master key and is not part of the library.
+  DF_StatusCode DF_Plain_DeleteFile(byte fileNo);
+  // backFileIds: the file numbers of the selected application, up to 32 files
+  DF_StatusCode DF_Plain_GetFileIds(byte* backFileIds, byte* backFileIdsLen);
+
+  DF_StatusCode DF_Plain_ReadData_Simple(byte fileNo, uint16_t length, uint16_t offset, byte* backReadData, uint16_t* backReadLen);
+  // reads a range of any length, the additional frames of the card (91AF) are collected
+  DF_StatusCode DF_Plain_ReadData_native(byte fileNo, uint16_t offset, uint16_t length, byte* backReadData, uint16_t* backReadLen);
+  // Reads several ranges of files in the selected application with the fewest commands:
+  // requests for the same file are merged when they overlap or are close together and the
+  // file sizes (for length 0) are looked up once per application. The data lands in
+  // backRespData range by range, results (one per request) tell where. Returns the first error.
+  DF_StatusCode DF_Plain_ReadFiles(const DF_FileReadRequest* requests, byte requestCount, byte* backRespData, uint16_t backRespSize, DF_FileReadResult* results);
   DF_StatusCode DF_Plain_GetMoreData_native(byte* backRespData, byte* backRespLen);
 
-  DF_StatusCode DF_Plain_WriteData_Simple(byte fileNo, byte length, byte offset, byte* sendData);
+  DF_StatusCode DF_Plain_WriteData_Simple(byte fileNo, byte length, uint16_t offset, byte* sendData);
 
   DF_StatusCode DF_Plain_GetFileSettings(byte fileNo, byte* backRespData, byte* backRespLen);
+  // the size of a standard or backup data file of the selected application, GetFileSettings is
+  // sent once per application and file
+  DF_StatusCode DF_GetFileSize(byte fileNo, uint32_t* backSize);
   void DF_FileSettingsDebugPrint();
   void DF_StatusCodeDebugPrint(DF_StatusCode statusCode);
 
+  /////////////////////////////////////////////////////////////////////////////////////
+  //
+  // ISO 7816-4 File Handling
+  //
+  /////////////////////////////////////////////////////////////////////////////////////
+
+  // Selects an application by its ISO DF name (up to 16 bytes). The AID of the application is
+  // not known to the library, so the recovery can not select it again after a RF loss.
+  DF_StatusCode DF_Iso_SelectApplication(const byte* dfName, byte dfNameLen);
+  // selects a file of the selected application by its ISO file identifier
+  DF_StatusCode DF_Iso_SelectFile(uint16_t fileId);
+  // Reads from and writes to the file selected by DF_Iso_SelectFile, the data is split into
+  // APDUs of ISO_CHUNK bytes; offset + length is limited to ISO_MAX_OFFSET + 1
+  DF_StatusCode DF_Iso_ReadBinary(uint16_t offset, uint16_t length, byte* backReadData, uint16_t* backReadLen);
+  DF_StatusCode DF_Iso_UpdateBinary(uint16_t offset, const byte* data, uint16_t length);
+
+  // Reads and writes a standard data file of the selected application by its file number or its
+  // ISO file identifier (isoFileId 0 = the file has none, the native path is used). The time of
+  // every access is measured per path, DF_PATH_AUTO takes the path with the higher throughput.
+  void DF_SetAccessPath(DF_AccessPath path);
+  DF_AccessPath DF_GetPreferredPath(bool isWrite);
+  // measured bytes per second, 0 when the path was not used yet
+  uint32_t DF_GetPathThroughput(DF_AccessPath path, bool isWrite);
+  DF_StatusCode DF_ReadStandardFile(byte fileNo, uint16_t isoFileId, uint16_t offset, uint16_t length, byte* backReadData, uint16_t* backReadLen);
+  DF_StatusCode DF_WriteStandardFile(byte fileNo, uint16_t isoFileId, uint16_t offset, const byte* data, uint16_t length);
+
+  /////////////////////////////////////////////////////////////////////////////////////
+  //
+  // Value File Handling
+  //
+  /////////////////////////////////////////////////////////////////////////////////////
+
+  // Credit, Debit and LimitedCredit are not applied on the card before a CommitTransaction
+  // is sent, so several operations on different value files of the selected application
+  // can be collected and committed in one exchange.
+  DF_StatusCode DF_Plain_CreateValueFile(byte fileNo, DF_CommMode commMode, byte accessRightsRwCar, byte accessRightsRW, int32_t lowerLimit, int32_t upperLimit, int32_t value, byte limitedCreditOptions);
+  DF_StatusCode DF_Plain_CreateValueFileDefaultFreeAccess(byte fileNo, int32_t lowerLimit, int32_t upperLimit, int32_t value, DF_CommMode commMode);
+  DF_StatusCode DF_Plain_GetValue(byte fileNo, int32_t* backValue);
+  DF_StatusCode DF_Plain_Credit(byte fileNo, int32_t value);
+  DF_StatusCode DF_Plain_Debit(byte fileNo, int32_t value);
+  DF_StatusCode DF_Plain_LimitedCredit(byte fileNo, int32_t value);
+  DF_StatusCode DF_Plain_CommitTransaction();
+  DF_StatusCode DF_Plain_AbortTransaction();
+  // sends all operations and commits them with a single CommitTransaction. On any error the
+  // transaction is aborted and backFailedIndex holds the failing operation (or opCount for the commit)
+  DF_StatusCode DF_Plain_ValueTransaction(DF_ValueOperation* ops, byte opCount, byte* backFailedIndex);
+  byte DF_GetPendingValueOperations();
+
   /////////////////////////////////////////////////////////////////////////////////////
   //
   // PICC Handling
@@ -179,6 +413,9 @@ public:
   /////////////////////////////////////////////////////////////////////////////////////
 
   DF_StatusCode DF_Plain_GetFreeMemory(byte* backData, byte* backLen);
+  // Reads the 56 bytes originality signature (r || s) of NXP over the UID, the signature is
+  // verified with ESP32_DESFire_Originality. The card answers on the PICC level.
+  DF_StatusCode DF_Plain_ReadSig(byte* backSignature, byte* backSignatureLen);
 
   // Writes to backRespData 28 or 29 bytes according to tables 54, 56 and 58 from NT4H2421Gx (NTAG 424 DNA) datasheet:
   // VendorID, HWType, HWSubType, HWMajorVersion, HWMinorVersion, HWStorageSize, HWProtocol,
@@ -194,6 +431,8 @@ public:
   int convertUint8_t3_2IntLsb(byte* input);
   int convertUint8_t4_2IntLsb(byte* input);
   void convertIntTo3BytesLsb(int input, byte* output);
+  void convertInt32To4BytesLsb(int32_t input, byte* output);
+  int32_t convertUint8_t4_2Int32Lsb(byte* input);
   void revertAid(byte* aid, byte* revertAid);
   void hexCharacterStringToBytes(byte* byteArray, const char* hexString);
   byte nibble(char c);
@@ -201,7 +440,25 @@ public:
 
 private:
 
-  Adafruit_PN532* nfcLib;
+  DF_Transport transport;
+  DF_ExchangeHandler* exchangeHandler = NULL;
+  DF_TraceRecorder* traceRecorder = NULL;
+
+  // session state of the card on this target
+  bool isApplicationSelected = false;
+  byte selectedAid[AID_SIZE];
+  byte sessionUid[MAX_UID_SIZE];
+  byte sessionUidLength = 0;
+
+  uint16_t commandTimeoutMs = DF_PN532_INDATAEXCHANGE_TIMEOUT;
+  bool isDeadlineSet = false;
+  unsigned long deadlineMillis = 0;
+
+  DF_RecoveryPolicy recoveryPolicy;
+  bool isRecoveryActive = false;  // no nested recovery while the application is restored
+  uint16_t recoveryCounters[DF_STATUS_CODE_COUNT];
+  uint16_t reactivationCounter = 0;
+  uint16_t recoveryFailureCounter = 0;
 
   // data is retrieved by getFileSettings
   // see https://www.nxp.com/docs/en/data-sheet/MF2DLHX0.pdf DESFire Light Features & Hints, pages 75ff
@@ -215,15 +472,38 @@ private:
   byte fileSettingsRwCarAccessRights;
   byte fileSettingsRWAccessRights;
   uint16_t fileSettingsFileSize;                    // data files only
-  uint16_t fileSettingsLowerLimit;                  // value files only
-  uint16_t fileSettingsUpperLimit;                  // value files only
-  uint16_t fileSettingsLimitedCreditValue;          // value files only
+  int32_t fileSettingsLowerLimit;                   // value files only
+  int32_t fileSettingsUpperLimit;                   // value files only
+  int32_t fileSettingsLimitedCreditValue;           // value files only
   bool fileSettingsIsLimitedCreditEnabled = false;  // value files only
   bool fileSettingsIsFreeAccessToGetValue = false;  // value files only
   uint16_t fileSettingsRecordSize;                  // record files only
   uint16_t fileSettingsMaxNoOfRecs;                 // record files only
   uint16_t fileSettingsCurrentNoOfRecs;             // record files only
 
+  // number of Credit, Debit and LimitedCredit operations waiting for a CommitTransaction
+  byte valueOperationsPending = 0;
+
+  // file selected with DF_Iso_SelectFile, 0 = none
+  uint16_t isoSelectedFileId = 0;
+
+  // throughput of the access paths, [isWrite][path - 1]
+  struct DF_PathStats {
+    uint32_t bytes;
+    uint32_t micros;
+  };
+  DF_AccessPath accessPath = DF_PATH_AUTO;
+  DF_PathStats pathStats[2][2] = {};
+  byte pathAccessCounter = 0;
+
+  // sizes of the data files in the selected application, see DF_GetFileSize
+  struct DF_FileSizeEntry {
+    byte fileNo;
+    uint32_t size;
+  };
+  DF_FileSizeEntry fileSizeCache[FILE_SIZE_CACHE_SIZE];
+  byte fileSizeCacheCount = 0;
+
 protected:
 
   /////////////////////////////////////////////////////////////////////////////////////
@@ -233,10 +513,23 @@ protected:
   /////////////////////////////////////////////////////////////////////////////////////
 
   DF_StatusCode DF_BasicTransceive(byte* sendData, byte sendLen, byte* backData, byte* backLen);
+  DF_StatusCode DF_BasicTransceive_native(byte* sendData, byte sendLen, byte* backData, byte* backLen);
+  bool DF_IsIdempotentCommand(byte* sendData, byte sendLen);
+  bool DF_ReactivateCard();
   DF_StatusCode DF_InterpretErrorCode(byte* SW1_2);
 
-  DF_StatusCode DF_Plain_CreateDataFile_native(byte CMD, byte fileNo, DF_CommMode commMode, byte accessRightsRwCar, byte accessRightsRW, byte length);
-  DF_StatusCode DF_Plain_GetVersion_native(byte Cmd, byte expectedSV2, byte* backRespData, byte* backRespLen);
+  // see ESP32_DESFire_Commands.h
+  DF_StatusCode DF_Plain_Command_native(const DF_CommandDescriptor& command, byte* sendData, byte sendLen, byte* backRespData, byte* backRespLen);
+  // sends the command and collects the data of the additional frames (91AF)
+  DF_StatusCode DF_Plain_CollectFrames_native(byte* sendData, byte sendLen, byte* backRespData, uint16_t* backRespLen);
+
+  DF_StatusCode DF_Plain_CreateDataFile_native(byte CMD, byte fileNo, DF_CommMode commMode, byte accessRightsRwCar, byte accessRightsRW, uint32_t length);
+  DF_StatusCode DF_Plain_ValueOperation_native(const DF_CommandDescriptor& command, byte fileNo, int32_t value);
+  DF_StatusCode DF_Plain_TransactionCommand_native(const DF_CommandDescriptor& command);
+
+  DF_StatusCode DF_Iso_Command_native(byte* sendData, byte sendLen, byte* backRespData, byte* backRespLen);
+  DF_AccessPath DF_ChoosePath(uint16_t isoFileId, bool isWrite);
+  void DF_RecordPath(DF_AccessPath path, bool isWrite, uint16_t bytes, uint32_t elapsedMicros);
 
   bool DF_GetFileSettingsAnalyzer(byte fileNo, byte* resData, uint8_t resLen);
 };
@@ -0,0 +1,218 @@
+#include "ESP32_DESFire_AccessIndex.h"
+
+#ifdef ESP_PLATFORM
+#include "esp_partition.h"
+#endif
+
+size_t ESP32_DESFire_AccessIndex::DF_GetImageSize(uint32_t capacity) {
+  return sizeof(DF_AccessIndexHeader) + (size_t)capacity * sizeof(DF_AccessEntry);
+}
+
+bool ESP32_DESFire_AccessIndex::DF_Format(byte* memory, size_t memorySize) {
+  if (memory == NULL || ((uintptr_t)memory & 0x03) != 0 || memorySize < DF_GetImageSize(4))
+    return false;
+  uint32_t capacity = 4;
+  while (DF_GetImageSize(capacity * 2) <= memorySize && capacity < 0x40000000)
+    capacity *= 2;
+
+  memset(memory, 0, DF_GetImageSize(capacity));
+  header = (DF_AccessIndexHeader*)memory;
+  memcpy(header->magic, "DFAI", 4);
+  header->version = DF_ACCESS_INDEX_VERSION;
+  header->capacity = capacity;
+  entries = (DF_AccessEntry*)&memory[sizeof(DF_AccessIndexHeader)];
+  isWritable = true;
+  return true;
+}
+
+bool ESP32_DESFire_AccessIndex::DF_Attach(byte* memory, size_t memorySize) {
+  if (!DF_AttachReadOnly(memory, memorySize))
+    return false;
+  isWritable = true;
+  return true;
+}
+
+bool ESP32_DESFire_AccessIndex::DF_AttachReadOnly(const byte* image, size_t imageSize) {
+  header = NULL;
+  entries = NULL;
+  isWritable = false;
+  if (!DF_CheckImage(image, imageSize))
+    return false;
+  header = (DF_AccessIndexHeader*)image;
+  entries = (DF_AccessEntry*)&image[sizeof(DF_AccessIndexHeader)];
+  return true;
+}
+
+bool ESP32_DESFire_AccessIndex::DF_CheckImage(const byte* image, size_t imageSize) {
+  if (image == NULL || ((uintptr_t)image & 0x03) != 0 || imageSize < sizeof(DF_AccessIndexHeader))
+    return false;
+  const DF_AccessIndexHeader* imageHeader = (const DF_AccessIndexHeader*)image;
+  if (memcmp(imageHeader->magic, "DFAI", 4) != 0 || imageHeader->version != DF_ACCESS_INDEX_VERSION)
+    return false;
+  uint32_t capacity = imageHeader->capacity;
+  // the capacity has to be a power of 2 for the probe mask
+  if (capacity < 4 || (capacity & (capacity - 1)) != 0)
+    return false;
+  return (DF_GetImageSize(capacity) <= imageSize);
+}
+
+#ifdef ESP_PLATFORM
+bool ESP32_DESFire_AccessIndex::DF_MapPartition(const char* label) {
+  const esp_partition_t* partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+  if (partition == NULL)
+    return false;
+  const void* mapped;
+  esp_partition_mmap_handle_t mapHandle;
+  if (esp_partition_mmap(partition, 0, partition->size, ESP_PARTITION_MMAP_DATA, &mapped, &mapHandle) != ESP_OK)
+    return false;
+  // the mapping stays for the lifetime of the sketch
+  return DF_AttachReadOnly((const byte*)mapped, partition->size);
+}
+
+bool ESP32_DESFire_AccessIndex::DF_LoadPartition(const char* label, byte* memory, size_t memorySize) {
+  const esp_partition_t* partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+  if (partition == NULL || memorySize < sizeof(DF_AccessIndexHeader))
+    return false;
+  if (esp_partition_read(partition, 0, memory, sizeof(DF_AccessIndexHeader)) != ESP_OK)
+    return false;
+  size_t imageSize = DF_GetImageSize(((DF_AccessIndexHeader*)memory)->capacity);
+  if (!DF_CheckImage(memory, memorySize) || imageSize > partition->size)
+    return false;
+  if (esp_partition_read(partition, 0, memory, imageSize) != ESP_OK)
+    return false;
+  return DF_Attach(memory, memorySize);
+}
+
+bool ESP32_DESFire_AccessIndex::DF_SavePartition(const char* label) {
+  if (header == NULL || !isWritable)
+    return false;
+  const esp_partition_t* partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+  size_t imageSize = DF_GetImageLength();
+  if (partition == NULL || imageSize > partition->size)
+    return false;
+  // the erase size has to be a multiple of the flash sector size
+  size_t eraseSize = (imageSize + partition->erase_size - 1) / partition->erase_size * partition->erase_size;
+  if (esp_partition_erase_range(partition, 0, eraseSize) != ESP_OK)
+    return false;
+  return (esp_partition_write(partition, 0, header, imageSize) == ESP_OK);
+}
+#endif
+
+uint32_t ESP32_DESFire_AccessIndex::DF_Hash(byte* key, byte keyLength) {
+  // FNV-1a, 32 bit
+  uint32_t hash = 0x811C9DC5;
+  for (byte i = 0; i < keyLength; i++) {
+    hash ^= key[i];
+    hash *= 0x01000193;
+  }
+  return hash;
+}
+
+int32_t ESP32_DESFire_AccessIndex::DF_FindSlot(byte* key, byte keyLength) {
+  uint32_t mask = header->capacity - 1;
+  uint32_t slot = DF_Hash(key, keyLength) & mask;
+  // the fill limit guarantees an empty slot, so the loop ends
+  for (uint32_t probe = 0; probe < header->capacity; probe++) {
+    DF_AccessEntry* entry = &entries[slot];
+    if (entry->keyLength == DF_ACCESS_ENTRY_EMPTY)
+      return -1;
+    if (entry->keyLength == keyLength && memcmp(entry->key, key, keyLength) == 0)
+      return (int32_t)slot;
+    slot = (slot + 1) & mask;
+  }
+  return -1;
+}
+
+bool ESP32_DESFire_AccessIndex::DF_Lookup(byte* key, byte keyLength, DF_AccessEntry* backEntry) {
+  if (header == NULL || keyLength == 0 || keyLength > DF_ACCESS_KEY_MAX_LENGTH)
+    return false;
+  int32_t slot = DF_FindSlot(key, keyLength);
+  if (slot < 0)
+    return false;
+  if (backEntry != NULL)
+    memcpy(backEntry, &entries[slot], sizeof(DF_AccessEntry));
+  return true;
+}
+
+bool ESP32_DESFire_AccessIndex::DF_Put(byte* key, byte keyLength, byte decision, uint32_t data) {
+  if (header == NULL || !isWritable || keyLength == 0 || keyLength > DF_ACCESS_KEY_MAX_LENGTH)
+    return false;
+
+  uint32_t mask = header->capacity - 1;
+  uint32_t slot = DF_Hash(key, keyLength) & mask;
+  for (uint32_t probe = 0; probe < header->capacity; probe++) {
+    DF_AccessEntry* entry = &entries[slot];
+    if (entry->keyLength == DF_ACCESS_ENTRY_EMPTY)
+      break;
+    if (entry->keyLength == keyLength && memcmp(entry->key, key, keyLength) == 0) {
+      // update in place
+      entry->decision = decision;
+      entry->data = data;
+      return true;
+    }
+    slot = (slot + 1) & mask;
+  }
+
+  if ((header->count + 1) > header->capacity / 4 * 3)
+    return false;
+
+  DF_AccessEntry* entry = &entries[slot];
+  memset(entry, 0, sizeof(DF_AccessEntry));
+  entry->keyLength = keyLength;
+  entry->decision = decision;
+  entry->data = data;
+  memcpy(entry->key, key, keyLength);
+  header->count++;
+  return true;
+}
+
+bool ESP32_DESFire_AccessIndex::DF_Remove(byte* key, byte keyLength) {
+  if (header == NULL || !isWritable || keyLength == 0 || keyLength > DF_ACCESS_KEY_MAX_LENGTH)
+    return false;
+  int32_t slot = DF_FindSlot(key, keyLength);
+  if (slot < 0)
+    return false;
+  // backward shift deletion: move the following entries of the probe sequence into the gap,
+  // unless their home slot lies cyclically between the gap and their current slot
+  uint32_t mask = header->capacity - 1;
+  uint32_t gap = (uint32_t)slot;
+  uint32_t next = gap;
+  while (true) {
+    next = (next + 1) & mask;
+    DF_AccessEntry* entry = &entries[next];
+    if (entry->keyLength == DF_ACCESS_ENTRY_EMPTY)
+      break;
+    uint32_t home = DF_Hash(entry->key, entry->keyLength) & mask;
+    bool stays = (gap <= next) ? (gap < home && home <= next) : (gap < home || home <= next);
+    if (stays)
+      continue;
+    memcpy(&entries[gap], entry, sizeof(DF_AccessEntry));
+    gap = next;
+  }
+  memset(&entries[gap], 0, sizeof(DF_AccessEntry));
+  header->count--;
+  return true;
+}
+
+bool ESP32_DESFire_AccessIndex::DF_IsGranted(byte* key, byte keyLength) {
+  DF_AccessEntry entry;
+  if (!DF_Lookup(key, keyLength, &entry))
+    return false;
+  return (entry.decision == DF_ACCESS_GRANTED);
+}
+
+uint32_t ESP32_DESFire_AccessIndex::DF_GetCount() {
+  return (header == NULL) ? 0 : header->count;
+}
+
+uint32_t ESP32_DESFire_AccessIndex::DF_GetCapacity() {
+  return (header == NULL) ? 0 : header->capacity;
+}
+
+const byte* ESP32_DESFire_AccessIndex::DF_GetImage() {
+  return (const byte*)header;
+}
+
+size_t ESP32_DESFire_AccessIndex::DF_GetImageLength() {
+  return (header == NULL) ? 0 : DF_GetImageSize(header->capacity);
+}
@@ -0,0 +1,102 @@
+/**
+ * Offline access decision index for the ESP32_DESFire library.
+ *
+ * The index maps a card key (the UID or an identifier read from an application file, up to
+ * 16 bytes) to an access decision and 4 bytes of user data (e.g. an expiry date or a door
+ * group), so a reader can decide on a tap without reading files and without the backend.
+ *
+ * The index is an open addressing hash table (FNV-1a, linear probing) in one flat memory
+ * image, the lookup costs one hash and a few compares regardless of the number of cards.
+ * The image can live in RAM/PSRAM (lookup and incremental updates) or be memory mapped
+ * read-only from a flash data partition (lookup only). The image layout is:
+ * Header (16 bytes): 'D' 'F' 'A' 'I', version (1), reserved (3), capacity (4), count (4)
+ * Entries (24 bytes each): key length (1, 0x00 = empty), decision (1), reserved (2), data (4),
+ *                          key (16)
+ * Numbers are stored little endian as on the ESP32.
+ *
+ * To keep the probe sequences short the table is filled up to 3/4 of the capacity. A removed
+ * entry is closed by shifting the following entries of its probe sequence back, so there are
+ * no deleted markers and the index never needs a rebuild.
+ *
+ * Author: Michael Fehr (AndroidCrypto)
+*/
+
+#ifndef ESP32_DESFire_AccessIndex_h
+#define ESP32_DESFire_AccessIndex_h
+
+#include "Arduino.h"
+
+#define DF_ACCESS_INDEX_VERSION (0x01)
+#define DF_ACCESS_KEY_MAX_LENGTH (16)
+#define DF_ACCESS_ENTRY_EMPTY (0x00)
+
+struct DF_AccessEntry {
+  byte keyLength;
+  byte decision;
+  uint16_t reserved;
+  uint32_t data;
+  byte key[DF_ACCESS_KEY_MAX_LENGTH];
+};
+
+struct DF_AccessIndexHeader {
+  byte magic[4];
+  byte version;
+  byte reserved[3];
+  uint32_t capacity;
+  uint32_t count;
+};
+
+class ESP32_DESFire_AccessIndex {
+
+public:
+
+  enum DF_AccessDecision : byte {
+    DF_ACCESS_DENIED = 0,
+    DF_ACCESS_GRANTED = 1
+  };
+
+  // memory needed for an index with the capacity (a power of 2)
+  static size_t DF_GetImageSize(uint32_t capacity);
+
+  // creates an empty index with the largest capacity that fits into the memory
+  bool DF_Format(byte* memory, size_t memorySize);
+  // uses an existing image in RAM, lookups and updates are possible
+  bool DF_Attach(byte* memory, size_t memorySize);
+  // uses an existing image that can not be written (e.g. memory mapped flash), lookups only
+  bool DF_AttachReadOnly(const byte* image, size_t imageSize);
+
+#ifdef ESP_PLATFORM
+  // maps the index from the data partition with the label into the address space, lookups only
+  bool DF_MapPartition(const char* label);
+  // copies the index from the data partition into the memory (e.g. PSRAM), lookups and updates
+  bool DF_LoadPartition(const char* label, byte* memory, size_t memorySize);
+  // writes the image of a RAM index to the data partition
+  bool DF_SavePartition(const char* label);
+#endif
+
+  bool DF_Lookup(byte* key, byte keyLength, DF_AccessEntry* backEntry);
+  // inserts or updates the entry for the key
+  bool DF_Put(byte* key, byte keyLength, byte decision, uint32_t data);
+  bool DF_Remove(byte* key, byte keyLength);
+
+  // shortcut for the tap: false if the key is unknown or denied
+  bool DF_IsGranted(byte* key, byte keyLength);
+
+  uint32_t DF_GetCount();
+  uint32_t DF_GetCapacity();
+  const byte* DF_GetImage();
+  size_t DF_GetImageLength();
+
+private:
+
+  uint32_t DF_Hash(byte* key, byte keyLength);
+  // returns the slot of the key or -1
+  int32_t DF_FindSlot(byte* key, byte keyLength);
+  bool DF_CheckImage(const byte* image, size_t imageSize);
+
+  DF_AccessIndexHeader* header = NULL;
+  DF_AccessEntry* entries = NULL;
+  bool isWritable = false;
+};
+
+#endif
@@ -0,0 +1,605 @@
+#include "ESP32_DESFire_Benchmark.h"
+#include "ESP32_DESFire_Originality.h"
+
+#if defined(ESP_PLATFORM)
+#include <thread>
+#include "esp_pthread.h"
+#else
+#include <pthread.h>
+#include <limits.h>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+#endif
+
+static long DF_HeapInUse() {
+#if defined(ESP_PLATFORM)
+  return (long)ESP.getHeapSize() - (long)ESP.getFreeHeap();
+#elif defined(__GLIBC__)
+  return (long)mallinfo2().uordblks;
+#else
+  return 0;
+#endif
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+//
+// Scripted card
+//
+/////////////////////////////////////////////////////////////////////////////////////
+
+// A key pair generated for the benchmark only, it is NOT an NXP key: a card that verifies
+// with it is not genuine.
+static const uint8_t DF_BENCH_TEST_KEY[DF_P224_PUBLIC_KEY_LENGTH] = {
+  0x04,
+  0xE1, 0x69, 0x0C, 0xC7, 0x49, 0xB5, 0x28, 0xAA, 0xE9, 0x34, 0x53, 0xFD, 0xED, 0xEB,
+  0xBA, 0x99, 0x3E, 0xBD, 0xB0, 0xCB, 0xEB, 0xD2, 0x0D, 0x48, 0x86, 0x13, 0xD2, 0x6A,
+  0x1C, 0xC4, 0xFD, 0x85, 0xB9, 0x19, 0xB8, 0xEF, 0xC5, 0xB3, 0x05, 0xF2, 0x58, 0x52,
+  0x03, 0x3F, 0xDD, 0x7C, 0xF0, 0x3E, 0x75, 0x3B, 0xE8, 0xC4, 0x53, 0x3C, 0xD7, 0x85
+};
+
+const byte DF_BENCH_TEST_UID[7] = { 0x04, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66 };
+
+// the signature of the test key over DF_BENCH_TEST_UID, r || s
+static const byte DF_BENCH_TEST_SIGNATURE[DF_P224_SIGNATURE_LENGTH] = {
+  0x55, 0xBA, 0x23, 0x4A, 0x8F, 0x3C, 0xC1, 0xA8, 0x02, 0x7A, 0x25, 0x44, 0x23, 0x08,
+  0x53, 0x93, 0x0F, 0x03, 0xC1, 0xA1, 0xBD, 0xEA, 0x47, 0xA9, 0xB2, 0xED, 0x52, 0xBE,
+  0xAC, 0x04, 0xC6, 0x39, 0xEA, 0x4E, 0xCF, 0xBD, 0x28, 0xBB, 0x4F, 0x44, 0xDE, 0x56,
+  0x5B, 0xF9, 0x95, 0x51, 0x0A, 0xF4, 0x22, 0x64, 0x76, 0xA1, 0xE0, 0x02, 0x7F, 0xD7
+};
+
+bool DF_ScriptedCard::DF_Exchange(byte targetNumber, byte* sendData, byte sendLen, byte* backData, byte* backLen) {
+  frameCounter++;
+  if (isHeapTracked) {
+    long heapInUse = DF_HeapInUse();
+    if (heapInUse > heapHighWater)
+      heapHighWater = heapInUse;
+  }
+  if (frameLatencyUs > 0) {
+    unsigned long startMicros = micros();
+    delayMicroseconds(frameLatencyUs);
+    simulatedLatencyUs += micros() - startMicros;
+  }
+
+  if (sendLen < 5 || sendData[0] != 0x90)
+    return DF_Respond(NULL, 0, 0x1C, backData, backLen);
+
+  byte data[DF_BENCH_MAX_FILE_SIZE];
+  byte cmd = sendData[1];
+  if (cmd != DESFIRE_GET_MORE_DATA) {
+    getVersionStep = 0;
+    readEnd = 0;
+  }
+
+  switch (cmd) {
+    case DESFIRE_GET_VERSION:
+      {
+        const byte hwVersion[7] = { 0x04, 0x01, 0x01, 0x33, 0x00, 0x18, 0x05 };
+        memcpy(data, hwVersion, 7);
+        getVersionStep = 1;
+        return DF_Respond(data, 7, 0xAF, backData, backLen);
+      }
+    case DESFIRE_GET_MORE_DATA:
+      if (getVersionStep == 1) {
+        const byte swVersion[7] = { 0x04, 0x01, 0x01, 0x03, 0x00, 0x18, 0x05 };
+        memcpy(data, swVersion, 7);
+        getVersionStep = 2;
+        return DF_Respond(data, 7, 0xAF, backData, backLen);
+      }
+      if (getVersionStep == 2) {
+        for (byte i = 0; i < 14; i++)
+          data[i] = i;
+        getVersionStep = 0;
+        return DF_Respond(data, 14, 0x00, backData, backLen);
+      }
+      if (readPosition < readEnd)
+        return DF_RespondRead(backData, backLen);
+      // no open chain: answer with a full frame
+      for (byte i = 0; i < maxFrameSize; i++)
+        data[i] = i;
+      return DF_Respond(data, maxFrameSize, 0x00, backData, backLen);
+    case DESFIRE_GET_FILE_SETTINGS:
+      data[0] = 0x00;  // standard data file
+      data[1] = 0x00;  // plain
+      data[2] = 0xEE;
+      data[3] = 0xEE;
+      data[4] = DF_BENCH_MAX_FILE_SIZE;
+      data[5] = 0x00;
+      data[6] = 0x00;
+      return DF_Respond(data, 7, 0x00, backData, backLen);
+    case DESFIRE_READ_DATA_FILE:
+      {
+        if (sendLen < 12)
+          return DF_Respond(NULL, 0, 0x7E, backData, backLen);
+        // FileNo, Offset (3), Length (3), length 0 reads up to the end of the file
+        uint32_t offset = sendData[6] | ((uint32_t)sendData[7] << 8) | ((uint32_t)sendData[8] << 16);
+        uint32_t length = sendData[9] | ((uint32_t)sendData[10] << 8) | ((uint32_t)sendData[11] << 16);
+        if (length == 0 && offset < DF_BENCH_MAX_FILE_SIZE)
+          length = DF_BENCH_MAX_FILE_SIZE - offset;
+        if (offset + length > DF_BENCH_MAX_FILE_SIZE)
+          return DF_Respond(NULL, 0, 0xBE, backData, backLen);
+        // a read beyond the frame size is answered frame by frame with 91AF
+        readPosition = offset;
+        readEnd = offset + length;
+        return DF_RespondRead(backData, backLen);
+      }
+    case DESFIRE_WRITE_DATA_FILE:
+      {
+        byte length = (sendLen > 9) ? sendData[9] : 0;
+        if (length > DF_BENCH_MAX_FILE_SIZE || sendLen < 12 + length)
+          return DF_Respond(NULL, 0, 0x7E, backData, backLen);
+        memcpy(fileData, &sendData[12], length);
+        return DF_Respond(NULL, 0, 0x00, backData, backLen);
+      }
+    case DESFIRE_GET_FREE_MEMORY:
+      data[0] = 0x00;
+      data[1] = 0x14;
+      data[2] = 0x00;
+      return DF_Respond(data, 3, 0x00, backData, backLen);
+    case DESFIRE_GET_APPLICATION_IDS:
+      {
+        const byte aids[6] = { 0x56, 0x78, 0x9A, 0x11, 0x22, 0x33 };
+        memcpy(data, aids, sizeof(aids));
+        return DF_Respond(data, sizeof(aids), 0x00, backData, backLen);
+      }
+    case DESFIRE_GET_KEY_SETTINGS:
+      data[0] = 0x0F;
+      data[1] = 0x85;
+      return DF_Respond(data, 2, 0x00, backData, backLen);
+    case DESFIRE_GET_FILE_IDS:
+      data[0] = 0x01;
+      data[1] = 0x02;
+      data[2] = 0x03;
+      return DF_Respond(data, 3, 0x00, backData, backLen);
+    case DESFIRE_GET_VALUE:
+      data[0] = 0x64;
+      data[1] = 0x00;
+      data[2] = 0x00;
+      data[3] = 0x00;
+      return DF_Respond(data, 4, 0x00, backData, backLen);
+    case DESFIRE_READ_SIG:
+      memcpy(data, DF_BENCH_TEST_SIGNATURE, DF_P224_SIGNATURE_LENGTH);
+      return DF_Respond(data, DF_P224_SIGNATURE_LENGTH, DESFIRE_SV2_SIGNATURE, backData, backLen);
+    case DESFIRE_SELECT_APPLICATION:
+    case DESFIRE_CREATE_APPLICATION:
+    case DESFIRE_CREATE_STANDARD_DATA_FILE:
+    case DESFIRE_CREATE_VALUE_FILE:
+    case DESFIRE_DELETE_FILE:
+    case DESFIRE_CREDIT:
+    case DESFIRE_DEBIT:
+    case DESFIRE_LIMITED_CREDIT:
+    case DESFIRE_COMMIT_TRANSACTION:
+    case DESFIRE_ABORT_TRANSACTION:
+      return DF_Respond(NULL, 0, 0x00, backData, backLen);
+    default:
+      return DF_Respond(NULL, 0, 0x1C, backData, backLen);
+  }
+}
+
+bool DF_ScriptedCard::DF_Respond(byte* data, byte dataLen, byte sw2, byte* backData, byte* backLen) {
+  if (dataLen + 2 > *backLen)
+    return false;
+  if (dataLen > 0)
+    memcpy(backData, data, dataLen);
+  backData[dataLen] = 0x91;
+  backData[dataLen + 1] = sw2;
+  *backLen = dataLen + 2;
+  return true;
+}
+
+bool DF_ScriptedCard::DF_RespondRead(byte* backData, byte* backLen) {
+  byte chunk = (readEnd - readPosition > maxFrameSize) ? maxFrameSize : readEnd - readPosition;
+  byte* data = &fileData[readPosition];
+  readPosition += chunk;
+  return DF_Respond(data, chunk, (readPosition < readEnd) ? 0xAF : 0x00, backData, backLen);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+//
+// Benchmark runner
+//
+/////////////////////////////////////////////////////////////////////////////////////
+
+ESP32_DESFire_Benchmark::ESP32_DESFire_Benchmark(ESP32_DESFire* desfire, Print* output) {
+  desfireLib = desfire;
+  out = output;
+}
+
+uint32_t ESP32_DESFire_Benchmark::DF_Run(const DF_BenchmarkConfig& config) {
+  uint32_t errors = 0;
+  bool debugPrint = desfireLib->COMM_DEBUG_PRINT;
+
+  desfireLib->COMM_DEBUG_PRINT = false;
+  desfireLib->DF_SetExchangeHandler(&card);
+
+  for (byte l = 0; l < config.latencyCount; l++) {
+    for (byte f = 0; f < config.frameSizeCount; f++) {
+      card.frameLatencyUs = config.latenciesUs[l];
+      card.maxFrameSize = config.frameSizes[f];
+      for (byte command = 0; command < BENCH_COMMAND_COUNT; command++) {
+        bool sizeDependent = DF_IsSizeDependent(command);
+        byte sizeCount = sizeDependent ? config.fileSizeCount : 1;
+        for (byte s = 0; s < sizeCount; s++) {
+          DF_Measure(command, sizeDependent ? config.fileSizes[s] : 0, config.iterations, &errors);
+        }
+      }
+    }
+  }
+
+  desfireLib->DF_SetExchangeHandler(NULL);
+  desfireLib->COMM_DEBUG_PRINT = debugPrint;
+  return errors;
+}
+
+uint32_t ESP32_DESFire_Benchmark::DF_Soak(uint32_t taps, long* heapGrowth) {
+  uint32_t errors = 0;
+  bool debugPrint = desfireLib->COMM_DEBUG_PRINT;
+
+  desfireLib->COMM_DEBUG_PRINT = false;
+  desfireLib->DF_SetExchangeHandler(&card);
+  card.frameLatencyUs = 0;
+  card.maxFrameSize = 59;
+
+  // the first tap may allocate once (e.g. buffers of the C library), it is not counted
+  DF_RunTap();
+  long heapBefore = DF_HeapInUse();
+  unsigned long startMillis = millis();
+  for (uint32_t i = 0; i < taps; i++) {
+    if (!DF_RunTap())
+      errors++;
+  }
+  unsigned long elapsedMs = millis() - startMillis;
+  *heapGrowth = DF_HeapInUse() - heapBefore;
+
+  desfireLib->DF_SetExchangeHandler(NULL);
+  desfireLib->COMM_DEBUG_PRINT = debugPrint;
+
+  if (elapsedMs == 0)
+    elapsedMs = 1;
+  out->printf("{\"soak_taps\":%lu,\"errors\":%lu,\"heap_growth\":%ld,\"taps_per_s\":%.1f}\n",
+              (unsigned long)taps, (unsigned long)errors, *heapGrowth, taps * 1000.0 / elapsedMs);
+  return errors;
+}
+
+uint32_t ESP32_DESFire_Benchmark::DF_RunOriginality(uint16_t iterations) {
+  uint32_t errors = 0;
+  bool debugPrint = desfireLib->COMM_DEBUG_PRINT;
+
+  desfireLib->COMM_DEBUG_PRINT = false;
+  desfireLib->DF_SetExchangeHandler(&card);
+  card.frameLatencyUs = 0;
+  card.maxFrameSize = 59;
+
+  // the tables of the curve are static, they are built by the first key of the program
+  ESP32_DESFire_Originality originality(desfireLib);
+  unsigned long startMicros = micros();
+  if (!originality.DF_AddPublicKey(DF_BENCH_TEST_KEY))
+    errors++;
+  unsigned long precomputeUs = micros() - startMicros;
+
+  startMicros = micros();
+  for (uint16_t i = 0; i < iterations; i++) {
+    if (!originality.DF_VerifySignature(DF_BENCH_TEST_UID, sizeof(DF_BENCH_TEST_UID), DF_BENCH_TEST_SIGNATURE, NULL))
+      errors++;
+  }
+  unsigned long verifyUs = micros() - startMicros;
+
+  // the first check verifies and fills the cache, the repeated taps are measured
+  bool isGenuine = false;
+  if (originality.DF_CheckCard(DF_BENCH_TEST_UID, sizeof(DF_BENCH_TEST_UID), &isGenuine) != ESP32_DESFire::DF_STATUS_OK || !isGenuine)
+    errors++;
+  startMicros = micros();
+  for (uint16_t i = 0; i < iterations; i++) {
+    if (originality.DF_CheckCard(DF_BENCH_TEST_UID, sizeof(DF_BENCH_TEST_UID), &isGenuine) != ESP32_DESFire::DF_STATUS_OK || !isGenuine)
+      errors++;
+  }
+  unsigned long cachedUs = micros() - startMicros;
+
+  desfireLib->DF_SetExchangeHandler(NULL);
+  desfireLib->COMM_DEBUG_PRINT = debugPrint;
+
+  if (verifyUs == 0)
+    verifyUs = 1;
+  if (cachedUs == 0)
+    cachedUs = 1;
+  out->printf("{\"originality_iterations\":%d,\"errors\":%lu,\"precompute_ms\":%.2f,\"verifications_per_s\":%.1f,\"cached_checks_per_s\":%.1f}\n",
+              iterations, (unsigned long)errors, precomputeUs / 1000.0, iterations * 1000000.0 / verifyUs, iterations * 1000000.0 / cachedUs);
+  return errors;
+}
+
+// The flow of T01_Basic: select, version, file settings, write and read a file, value transaction
+bool ESP32_DESFire_Benchmark::DF_RunTap() {
+  static const byte tapCommands[] = { BENCH_SELECT_APPLICATION, BENCH_GET_VERSION, BENCH_GET_FREE_MEMORY, BENCH_GET_FILE_SETTINGS,
+                                      BENCH_WRITE_DATA, BENCH_READ_DATA, BENCH_GET_VALUE, BENCH_VALUE_TRANSACTION };
+  uint16_t payloadBytes;
+  bool success = true;
+  for (byte i = 0; i < sizeof(tapCommands); i++) {
+    if (!DF_RunCommand(tapCommands[i], 32, &payloadBytes))
+      success = false;
+  }
+  return success;
+}
+
+const char* ESP32_DESFire_Benchmark::DF_CommandName(byte command) {
+  switch (command) {
+    case BENCH_SELECT_APPLICATION: return "SelectApplication";
+    case BENCH_CREATE_APPLICATION: return "CreateApplication";
+    case BENCH_CREATE_APPLICATION_DEFAULT_AES: return "CreateApplicationDefaultAes";
+    case BENCH_GET_APPLICATION_IDS: return "GetApplicationIds";
+    case BENCH_GET_KEY_SETTINGS: return "GetKeySettings";
+    case BENCH_CREATE_STANDARD_FILE: return "CreateStandardDataFile";
+    case BENCH_CREATE_STANDARD_FILE_DEFAULT_32: return "CreateStandardFileDefault32";
+    case BENCH_CREATE_STANDARD_FILE_DEFAULT_SIZED: return "CreateStandardFileDefaultSized";
+    case BENCH_CREATE_STANDARD_FILE_FREE_ACCESS: return "CreateStandardFileDefaultFreeAccessSized";
+    case BENCH_DELETE_FILE: return "DeleteFile";
+    case BENCH_GET_FILE_IDS: return "GetFileIds";
+    case BENCH_GET_FILE_SETTINGS: return "GetFileSettings";
+    case BENCH_WRITE_DATA: return "WriteData_Simple";
+    case BENCH_READ_DATA: return "ReadData_Simple";
+    case BENCH_READ_DATA_NATIVE: return "ReadData_native";
+    case BENCH_READ_FILES: return "ReadFiles";
+    case BENCH_GET_MORE_DATA: return "GetMoreData_native";
+    case BENCH_GET_FREE_MEMORY: return "GetFreeMemory";
+    case BENCH_READ_SIG: return "ReadSig";
+    case BENCH_GET_VERSION: return "GetVersion";
+    case BENCH_CREATE_VALUE_FILE: return "CreateValueFile";
+    case BENCH_CREATE_VALUE_FILE_FREE_ACCESS: return "CreateValueFileDefaultFreeAccess";
+    case BENCH_GET_VALUE: return "GetValue";
+    case BENCH_CREDIT: return "Credit";
+    case BENCH_DEBIT: return "Debit";
+    case BENCH_LIMITED_CREDIT: return "LimitedCredit";
+    case BENCH_COMMIT_TRANSACTION: return "CommitTransaction";
+    case BENCH_ABORT_TRANSACTION: return "AbortTransaction";
+    case BENCH_VALUE_TRANSACTION: return "ValueTransaction";
+    default: return "Unknown";
+  }
+}
+
+// the commands that create, write or read a file of the configured sizes
+bool ESP32_DESFire_Benchmark::DF_IsSizeDependent(byte command) {
+  switch (command) {
+    case BENCH_CREATE_STANDARD_FILE:
+    case BENCH_CREATE_STANDARD_FILE_DEFAULT_SIZED:
+    case BENCH_CREATE_STANDARD_FILE_FREE_ACCESS:
+    case BENCH_WRITE_DATA:
+    case BENCH_READ_DATA:
+    case BENCH_READ_DATA_NATIVE:
+    case BENCH_READ_FILES:
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool ESP32_DESFire_Benchmark::DF_RunCommand(byte command, byte fileSize, uint16_t* payloadBytes) {
+  byte aid[3] = { 0x56, 0x78, 0x9A };
+  byte len = sizeof(buffer);
+  uint16_t lenExt = sizeof(buffer);
+  int32_t value;
+  byte keySettings;
+  byte keyCount;
+  ESP32_DESFire::DF_StatusCode statusCode;
+
+  *payloadBytes = 0;
+  switch (command) {
+    case BENCH_SELECT_APPLICATION:
+      statusCode = desfireLib->DF_Plain_SelectApplication(aid);
+      break;
+    case BENCH_CREATE_APPLICATION:
+      statusCode = desfireLib->DF_Plain_CreateApplication(aid, 0x0F, 0x85);
+      break;
+    case BENCH_CREATE_APPLICATION_DEFAULT_AES:
+      statusCode = desfireLib->DF_Plain_CreateApplicationDefaultAes(aid);
+      break;
+    case BENCH_GET_APPLICATION_IDS:
+      statusCode = desfireLib->DF_Plain_GetApplicationIds(buffer, &len);
+      *payloadBytes = len;
+      break;
+    case BENCH_GET_KEY_SETTINGS:
+      statusCode = desfireLib->DF_Plain_GetKeySettings(&keySettings, &keyCount);
+      *payloadBytes = 2;
+      break;
+    case BENCH_CREATE_STANDARD_FILE:
+      statusCode = desfireLib->DF_Plain_CreateStandardDataFile(0x01, ESP32_DESFire::DF_COMMMODE_PLAIN, 0xEE, 0xEE, fileSize);
+      break;
+    case BENCH_CREATE_STANDARD_FILE_DEFAULT_32:
+      statusCode = desfireLib->DF_Plain_CreateStandardFileDefault32(0x01, ESP32_DESFire::DF_COMMMODE_PLAIN);
+      break;
+    case BENCH_CREATE_STANDARD_FILE_DEFAULT_SIZED:
+      statusCode = desfireLib->DF_Plain_CreateStandardFileDefaultSized(0x01, fileSize, ESP32_DESFire::DF_COMMMODE_PLAIN);
+      break;
+    case BENCH_CREATE_STANDARD_FILE_FREE_ACCESS:
+      statusCode = desfireLib->DF_Plain_CreateStandardFileDefaultFreeAccessSized(0x01, fileSize, ESP32_DESFire::DF_COMMMODE_PLAIN);
+      break;
+    case BENCH_DELETE_FILE:
+      statusCode = desfireLib->DF_Plain_DeleteFile(0x01);
+      break;
+    case BENCH_GET_FILE_IDS:
+      statusCode = desfireLib->DF_Plain_GetFileIds(buffer, &len);
+      *payloadBytes = len;
+      break;
+    case BENCH_GET_FILE_SETTINGS:
+      statusCode = desfireLib->DF_Plain_GetFileSettings(0x01, buffer, &len);
+      *payloadBytes = len;
+      break;
+    case BENCH_WRITE_DATA:
+      statusCode = desfireLib->DF_Plain_WriteData_Simple(0x01, fileSize, 0, buffer);
+      *payloadBytes = fileSize;
+      break;
+    case BENCH_READ_DATA:
+      statusCode = desfireLib->DF_Plain_ReadData_Simple(0x01, fileSize, 0, buffer, &lenExt);
+      *payloadBytes = lenExt;
+      break;
+    case BENCH_READ_DATA_NATIVE:
+      statusCode = desfireLib->DF_Plain_ReadData_native(0x01, 0, fileSize, buffer, &lenExt);
+      *payloadBytes = lenExt;
+      break;
+    case BENCH_READ_FILES:
+      {
+        // two ranges of the file that are merged into one read, the second one up to the end
+        ESP32_DESFire::DF_FileReadRequest requests[2] = {
+          { 0x01, 0, (uint16_t)(fileSize / 2) },
+          { 0x01, (uint16_t)(fileSize / 2), 0 }
+        };
+        ESP32_DESFire::DF_FileReadResult results[2];
+        statusCode = desfireLib->DF_Plain_ReadFiles(requests, 2, buffer, sizeof(buffer), results);
+        *payloadBytes = results[0].length + results[1].length;
+      }
+      break;
+    case BENCH_GET_MORE_DATA:
+      statusCode = desfireLib->DF_Plain_GetMoreData_native(buffer, &len);
+      *payloadBytes = len - 2;
+      break;
+    case BENCH_GET_FREE_MEMORY:
+      statusCode = desfireLib->DF_Plain_GetFreeMemory(buffer, &len);
+      *payloadBytes = len;
+      break;
+    case BENCH_READ_SIG:
+      statusCode = desfireLib->DF_Plain_ReadSig(buffer, &len);
+      *payloadBytes = len;
+      break;
+    case BENCH_GET_VERSION:
+      statusCode = desfireLib->DF_Plain_GetVersion(buffer, &len);
+      *payloadBytes = len;
+      break;
+    case BENCH_CREATE_VALUE_FILE:
+      statusCode = desfireLib->DF_Plain_CreateValueFile(0x02, ESP32_DESFire::DF_COMMMODE_PLAIN, 0xEE, 0xEE, 0, 1000, 100, 0x00);
+      break;
+    case BENCH_CREATE_VALUE_FILE_FREE_ACCESS:
+      statusCode = desfireLib->DF_Plain_CreateValueFileDefaultFreeAccess(0x02, 0, 1000, 100, ESP32_DESFire::DF_COMMMODE_PLAIN);
+      break;
+    case BENCH_GET_VALUE:
+      statusCode = desfireLib->DF_Plain_GetValue(0x02, &value);
+      *payloadBytes = 4;
+      break;
+    case BENCH_CREDIT:
+      statusCode = desfireLib->DF_Plain_Credit(0x02, 1);
+      *payloadBytes = 4;
+      break;
+    case BENCH_DEBIT:
+      statusCode = desfireLib->DF_Plain_Debit(0x02, 1);
+      *payloadBytes = 4;
+      break;
+    case BENCH_LIMITED_CREDIT:
+      statusCode = desfireLib->DF_Plain_LimitedCredit(0x02, 1);
+      *payloadBytes = 4;
+      break;
+    case BENCH_COMMIT_TRANSACTION:
+      statusCode = desfireLib->DF_Plain_CommitTransaction();
+      break;
+    case BENCH_ABORT_TRANSACTION:
+      statusCode = desfireLib->DF_Plain_AbortTransaction();
+      break;
+    case BENCH_VALUE_TRANSACTION:
+      {
+        ESP32_DESFire::DF_ValueOperation ops[2] = {
+          { 0x02, ESP32_DESFire::DF_VALUE_DEBIT, 1 },
+          { 0x03, ESP32_DESFire::DF_VALUE_CREDIT, 1 }
+        };
+        byte failedIndex;
+        statusCode = desfireLib->DF_Plain_ValueTransaction(ops, 2, &failedIndex);
+        *payloadBytes = 8;
+      }
+      break;
+    default:
+      return false;
+  }
+  return (statusCode == ESP32_DESFire::DF_STATUS_OK);
+}
+
+void ESP32_DESFire_Benchmark::DF_Measure(byte command, byte fileSize, uint16_t iterations, uint32_t* errors) {
+  uint32_t commandErrors = 0;
+  uint32_t payloadTotal = 0;
+  uint16_t payloadBytes;
+
+  for (byte i = 0; i < sizeof(buffer); i++)
+    buffer[i] = i;
+  size_t stackBytes = DF_MeasureStack(command, fileSize);
+
+  // the heap is sampled at every frame of one untimed run, the timed runs are not slowed down
+  long heapBefore = DF_HeapInUse();
+  card.heapHighWater = heapBefore;
+  card.isHeapTracked = true;
+  DF_RunCommand(command, fileSize, &payloadBytes);
+  card.isHeapTracked = false;
+  long heapHighWater = card.heapHighWater;
+
+  card.simulatedLatencyUs = 0;
+  unsigned long startMicros = micros();
+  for (uint16_t i = 0; i < iterations; i++) {
+    if (!DF_RunCommand(command, fileSize, &payloadBytes))
+      commandErrors++;
+    payloadTotal += payloadBytes;
+  }
+  unsigned long elapsedUs = micros() - startMicros;
+  long heapAfter = DF_HeapInUse();
+  if (heapAfter > heapHighWater)
+    heapHighWater = heapAfter;
+
+  if (elapsedUs == 0)
+    elapsedUs = 1;
+  double seconds = elapsedUs / 1000000.0;
+  double cpuUsPerCommand = (double)(elapsedUs - card.simulatedLatencyUs) / iterations;
+
+  out->printf("{\"cmd\":\"%s\",\"file_size\":%d,\"frame_size\":%d,\"latency_us\":%lu,\"iterations\":%d,\"errors\":%lu,",
+              DF_CommandName(command), fileSize, card.maxFrameSize, (unsigned long)card.frameLatencyUs, iterations, (unsigned long)commandErrors);
+  out->printf("\"cmds_per_s\":%.1f,\"payload_bytes_per_s\":%.1f,\"cpu_us_per_cmd\":%.2f,\"stack_bytes\":%u,\"heap_high_water\":%ld}\n",
+              iterations / seconds, payloadTotal / seconds, cpuUsPerCommand, (unsigned int)stackBytes, heapHighWater - heapBefore);
+  *errors += commandErrors;
+}
+
+// The used stack of the thread minus the used stack of the same thread without a command
+size_t ESP32_DESFire_Benchmark::DF_MeasureStack(byte command, byte fileSize) {
+  size_t commandBytes = DF_StackOfRun(command, fileSize);
+  size_t threadBytes = DF_StackOfRun(BENCH_COMMAND_COUNT, 0);
+  return (commandBytes > threadBytes) ? commandBytes - threadBytes : 0;
+}
+
+void* ESP32_DESFire_Benchmark::DF_StackThread(void* arg) {
+  DF_StackRun* run = (DF_StackRun*)arg;
+  uint16_t payloadBytes;
+  if (run->command < BENCH_COMMAND_COUNT)
+    run->benchmark->DF_RunCommand(run->command, run->fileSize, &payloadBytes);
+#if defined(ESP_PLATFORM)
+  // the thread is a FreeRTOS task, the high water mark is given in bytes
+  run->freeBytes = uxTaskGetStackHighWaterMark(NULL);
+#endif
+  return NULL;
+}
+
+// Runs one command on a new thread and returns the stack used by the thread
+size_t ESP32_DESFire_Benchmark::DF_StackOfRun(byte command, byte fileSize) {
+  DF_StackRun run = { this, command, fileSize, 0 };
+#if defined(ESP_PLATFORM)
+  esp_pthread_cfg_t cfg = esp_pthread_get_default_config();
+  cfg.stack_size = DF_BENCH_STACK_SIZE;
+  cfg.thread_name = "df_bench";
+  esp_pthread_set_cfg(&cfg);
+  std::thread worker(DF_StackThread, &run);
+  worker.join();
+  return DF_BENCH_STACK_SIZE - run.freeBytes;
+#else
+  // the stack grows down from the end of the buffer, the painted bytes left at its start
+  // have not been touched
+  size_t stackSize = (DF_BENCH_STACK_SIZE > (size_t)PTHREAD_STACK_MIN) ? DF_BENCH_STACK_SIZE : (size_t)PTHREAD_STACK_MIN;
+  byte* stack = (byte*)malloc(stackSize);
+  if (stack == NULL)
+    return 0;
+  memset(stack, 0xA5, stackSize);
+
+  size_t usedBytes = 0;
+  pthread_attr_t attr;
+  pthread_t thread;
+  pthread_attr_init(&attr);
+  if (pthread_attr_setstack(&attr, stack, stackSize) == 0 && pthread_create(&thread, &attr, DF_StackThread, &run) == 0) {
+    pthread_join(thread, NULL);
+    size_t untouched = 0;
+    while (untouched < stackSize && stack[untouched] == 0xA5)
+      untouched++;
+    usedBytes = stackSize - untouched;
+  }
+  pthread_attr_destroy(&attr);
+  free(stack);
+  return usedBytes;
+#endif
+}
@@ -0,0 +1,158 @@
+/**
+ * Benchmark for the ESP32_DESFire command layer.
+ *
+ * The benchmark replaces the PN532 by DF_ScriptedCard, a stand-in that answers every
+ * command implemented in the library with a scripted, well formed response. The card can
+ * be configured with a maximum response frame size and a latency per frame, so the cost of
+ * the library itself (framing, parsing, copying) can be measured and compared between
+ * versions without any hardware in the field.
+ *
+ * For each command and configuration one line in JSON format is written to the output:
+ * {"cmd":"ReadData_Simple","file_size":32,"frame_size":59,"latency_us":0,"iterations":200,
+ *  "errors":0,"cmds_per_s":...,"payload_bytes_per_s":...,"cpu_us_per_cmd":...,
+ *  "stack_bytes":...,"heap_high_water":...}
+ * - cmd is the name of the DF_Plain_ method without the prefix
+ * - cpu_us_per_cmd is the measured time per command minus the simulated card latency
+ * - stack_bytes is the stack depth used by the command. The command runs once on a thread with
+ *   a stack of DF_BENCH_STACK_SIZE bytes: on the ESP32 the high water mark of its task is read,
+ *   on a host the stack is a painted buffer and the overwritten bytes are counted. The same
+ *   thread without a command is subtracted.
+ * - heap_high_water is the highest heap in use above the level before the command, sampled at
+ *   every frame of an untimed run and after all iterations (should be 0)
+ *
+ * DF_Soak repeats the tap flow of the tutorial many times and reports the failed taps and the
+ * growth of the heap, a reader that runs for months has to end at the same heap as it started.
+ * On a host the heap is read with mallinfo2 (glibc), so the soak runs on Linux as well:
+ * {"soak_taps":1000000,"errors":0,"heap_growth":0,"taps_per_s":...}
+ *
+ * DF_RunOriginality measures the originality check (see ESP32_DESFire_Originality) with a
+ * test key pair: the scripted card answers Read_Sig with a signature of the test key over
+ * DF_BENCH_TEST_UID, the NXP keys are not used. verifications_per_s is the EC math alone,
+ * cached_checks_per_s a repeated tap (Read_Sig and the cache lookup):
+ * {"originality_iterations":100,"errors":0,"precompute_ms":...,"verifications_per_s":...,
+ *  "cached_checks_per_s":...}
+ *
+ * Author: Michael Fehr (AndroidCrypto)
+*/
+
+#ifndef ESP32_DESFire_Benchmark_h
+#define ESP32_DESFire_Benchmark_h
+
+#include "Arduino.h"
+#include "ESP32_DESFire.h"
+
+#define DF_BENCH_STACK_SIZE (8192)
+#define DF_BENCH_MAX_FILE_SIZE (128)
+
+class DF_ScriptedCard : public DF_ExchangeHandler {
+
+public:
+
+  byte maxFrameSize = 59;     // maximum data bytes in one response frame (without status word)
+  uint32_t frameLatencyUs = 0;  // simulated card and RF time per frame
+  uint32_t frameCounter = 0;
+  uint32_t simulatedLatencyUs = 0;  // sum of the simulated latency
+  bool isHeapTracked = false;       // the heap in use is sampled at every frame (not timed runs)
+  long heapHighWater = 0;           // the highest heap in use seen at a frame
+
+  bool DF_Exchange(byte targetNumber, byte* sendData, byte sendLen, byte* backData, byte* backLen);
+
+private:
+
+  byte getVersionStep = 0;
+  byte fileData[DF_BENCH_MAX_FILE_SIZE];
+  // the open chain of a read longer than one frame, continued by GetMoreData
+  uint32_t readPosition = 0;
+  uint32_t readEnd = 0;
+
+  bool DF_Respond(byte* data, byte dataLen, byte sw2, byte* backData, byte* backLen);
+  bool DF_RespondRead(byte* backData, byte* backLen);
+};
+
+// the UID signed by the test key of the benchmark
+extern const byte DF_BENCH_TEST_UID[7];
+
+
+class ESP32_DESFire_Benchmark {
+
+public:
+
+  struct DF_BenchmarkConfig {
+    uint16_t iterations = 200;
+    const byte* fileSizes;
+    byte fileSizeCount;
+    const byte* frameSizes;
+    byte frameSizeCount;
+    const uint32_t* latenciesUs;
+    byte latencyCount;
+  };
+
+  ESP32_DESFire_Benchmark(ESP32_DESFire* desfire, Print* output);
+
+  // runs all commands with all combinations of the configuration, returns the number of failed commands
+  uint32_t DF_Run(const DF_BenchmarkConfig& config);
+  // runs the tap flow taps times, returns the number of failed taps and the growth of the
+  // allocated heap in bytes in heapGrowth (0 = no leak)
+  uint32_t DF_Soak(uint32_t taps, long* heapGrowth);
+  // verifies the test signature iterations times, returns the number of failed checks
+  uint32_t DF_RunOriginality(uint16_t iterations);
+
+private:
+
+  ESP32_DESFire* desfireLib;
+  Print* out;
+  DF_ScriptedCard card;
+  byte buffer[DF_BENCH_MAX_FILE_SIZE];
+
+  enum DF_BenchCommand : byte {
+    BENCH_SELECT_APPLICATION,
+    BENCH_CREATE_APPLICATION,
+    BENCH_CREATE_APPLICATION_DEFAULT_AES,
+    BENCH_GET_APPLICATION_IDS,
+    BENCH_GET_KEY_SETTINGS,
+    BENCH_CREATE_STANDARD_FILE,
+    BENCH_CREATE_STANDARD_FILE_DEFAULT_32,
+    BENCH_CREATE_STANDARD_FILE_DEFAULT_SIZED,
+    BENCH_CREATE_STANDARD_FILE_FREE_ACCESS,
+    BENCH_DELETE_FILE,
+    BENCH_GET_FILE_IDS,
+    BENCH_GET_FILE_SETTINGS,
+    BENCH_WRITE_DATA,
+    BENCH_READ_DATA,
+    BENCH_READ_DATA_NATIVE,
+    BENCH_READ_FILES,
+    BENCH_GET_MORE_DATA,
+    BENCH_GET_FREE_MEMORY,
+    BENCH_READ_SIG,
+    BENCH_GET_VERSION,
+    BENCH_CREATE_VALUE_FILE,
+    BENCH_CREATE_VALUE_FILE_FREE_ACCESS,
+    BENCH_GET_VALUE,
+    BENCH_CREDIT,
+    BENCH_DEBIT,
+    BENCH_LIMITED_CREDIT,
+    BENCH_COMMIT_TRANSACTION,
+    BENCH_ABORT_TRANSACTION,
+    BENCH_VALUE_TRANSACTION,
+    BENCH_COMMAND_COUNT
+  };
+
+  // one command on the thread of DF_StackOfRun, command BENCH_COMMAND_COUNT runs nothing
+  struct DF_StackRun {
+    ESP32_DESFire_Benchmark* benchmark;
+    byte command;
+    byte fileSize;
+    size_t freeBytes;
+  };
+
+  const char* DF_CommandName(byte command);
+  bool DF_IsSizeDependent(byte command);
+  bool DF_RunCommand(byte command, byte fileSize, uint16_t* payloadBytes);
+  bool DF_RunTap();
+  void DF_Measure(byte command, byte fileSize, uint16_t iterations, uint32_t* errors);
+  size_t DF_MeasureStack(byte command, byte fileSize);
+  size_t DF_StackOfRun(byte command, byte fileSize);
+  static void* DF_StackThread(void* run);
+};
+
+#endif
@@ -0,0 +1,31 @@
+#include "ESP32_DESFire_BusScheduler.h"
+
+void DF_BusScheduler::DF_Acquire() {
+  std::unique_lock<std::mutex> guard(lock);
+  uint32_t ticket = nextTicket++;
+  if (ticket != nowServing) {
+    contendedCount++;
+    turn.wait(guard, [this, ticket] {
+      return ticket == nowServing;
+    });
+  }
+  grantCount++;
+}
+
+void DF_BusScheduler::DF_Release() {
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    nowServing++;
+  }
+  turn.notify_all();
+}
+
+uint32_t DF_BusScheduler::DF_GetGrantCount() {
+  std::lock_guard<std::mutex> guard(lock);
+  return grantCount;
+}
+
+uint32_t DF_BusScheduler::DF_GetContendedCount() {
+  std::lock_guard<std::mutex> guard(lock);
+  return contendedCount;
+}
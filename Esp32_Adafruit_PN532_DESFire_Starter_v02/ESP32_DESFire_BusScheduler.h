@@ -0,0 +1,43 @@
+/**
+ * Fair bus scheduler for several PN532 readers on one SPI bus.
+ *
+ * Every reader that wants to use the host link takes a ticket and is served in the
+ * order of the tickets (FIFO), so no reader can starve the others. The bus is only
+ * held while bytes are moved between the ESP32 and a PN532, not while the PN532 is
+ * waiting for the card, so the RF exchanges of the readers overlap.
+ *
+ * The scheduler does not depend on the Arduino framework and can be used on Linux
+ * together with fake readers.
+ *
+ * Author: Michael Fehr (AndroidCrypto)
+*/
+
+#ifndef ESP32_DESFire_BusScheduler_h
+#define ESP32_DESFire_BusScheduler_h
+
+#include <stdint.h>
+#include <mutex>
+#include <condition_variable>
+
+class DF_BusScheduler {
+
+public:
+
+  void DF_Acquire();
+  void DF_Release();
+
+  // statistics
+  uint32_t DF_GetGrantCount();
+  uint32_t DF_GetContendedCount();  // grants that had to wait for another reader
+
+private:
+
+  std::mutex lock;
+  std::condition_variable turn;
+  uint32_t nextTicket = 0;
+  uint32_t nowServing = 0;
+  uint32_t grantCount = 0;
+  uint32_t contendedCount = 0;
+};
+
+#endif
@@ -0,0 +1,227 @@
+/**
+ * Compile time command descriptors for the ESP32_DESFire library.
+ *
+ * Each command is described once: command code, length of the parameters, allowed length
+ * of the response data and the second status byte that ends the frame (0x00, or 0xAF when
+ * more frames follow). DF_CommandApdu builds the APDU from typed parameters, the size of the
+ * APDU is a compile time constant and a parameter list that does not match the descriptor
+ * does not compile. The response is checked against the descriptor by
+ * ESP32_DESFire::DF_Plain_Command_native.
+ *
+ * Parameter types: byte (1 byte), DF_Uint24 (3 bytes LSB, offsets and lengths),
+ * int32_t (4 bytes LSB, values), DF_Aid (3 bytes, application identifier)
+ *
+ * The status words of the card are mapped to DF_StatusCode with a sorted constexpr table.
+ *
+ * Author: Michael Fehr (AndroidCrypto)
+*/
+
+#ifndef ESP32_DESFire_Commands_h
+#define ESP32_DESFire_Commands_h
+
+#include "Arduino.h"
+#include "ESP32_DESFire.h"
+
+struct DF_CommandDescriptor {
+  byte cmd;
+  byte paramLength;        // Lc of the command, 0 = no data field
+  byte minResponseLength;  // response data without the status word
+  byte maxResponseLength;
+  byte successSW2;         // 0x00 = complete, 0xAF = additional frames follow
+  bool isIdempotent;       // the command can be sent again without changing the card
+};
+
+struct DF_Commands {
+  static constexpr DF_CommandDescriptor SELECT_APPLICATION = { DESFIRE_SELECT_APPLICATION, 3, 0, 0, DESFIRE_SV2_OK, true };
+  static constexpr DF_CommandDescriptor CREATE_APPLICATION = { DESFIRE_CREATE_APPLICATION, 5, 0, 0, DESFIRE_SV2_OK, false };
+  static constexpr DF_CommandDescriptor GET_APPLICATION_IDS = { DESFIRE_GET_APPLICATION_IDS, 0, 0, 57, DESFIRE_SV2_OK, true };  // or 91AF
+  static constexpr DF_CommandDescriptor GET_KEY_SETTINGS = { DESFIRE_GET_KEY_SETTINGS, 0, 2, 2, DESFIRE_SV2_OK, true };
+  static constexpr DF_CommandDescriptor READ_SIG = { DESFIRE_READ_SIG, 1, 56, 56, DESFIRE_SV2_SIGNATURE, true };
+  static constexpr DF_CommandDescriptor GET_VERSION = { DESFIRE_GET_VERSION, 0, 7, 7, DESFIRE_GET_MORE_DATA, true };
+  static constexpr DF_CommandDescriptor GET_VERSION_MORE = { DESFIRE_GET_MORE_DATA, 0, 7, 7, DESFIRE_GET_MORE_DATA, false };
+  static constexpr DF_CommandDescriptor GET_VERSION_LAST = { DESFIRE_GET_MORE_DATA, 0, 14, 15, DESFIRE_SV2_OK, false };
+  static constexpr DF_CommandDescriptor GET_FREE_MEMORY = { DESFIRE_GET_FREE_MEMORY, 0, 3, 3, DESFIRE_SV2_OK, true };
+  static constexpr DF_CommandDescriptor GET_FILE_SETTINGS = { DESFIRE_GET_FILE_SETTINGS, 1, 7, 34, DESFIRE_SV2_OK, true };
+  static constexpr DF_CommandDescriptor CREATE_STANDARD_DATA_FILE = { DESFIRE_CREATE_STANDARD_DATA_FILE, 7, 0, 0, DESFIRE_SV2_OK, false };
+  static constexpr DF_CommandDescriptor DELETE_FILE = { DESFIRE_DELETE_FILE, 1, 0, 0, DESFIRE_SV2_OK, false };
+  static constexpr DF_CommandDescriptor GET_FILE_IDS = { DESFIRE_GET_FILE_IDS, 0, 0, 32, DESFIRE_SV2_OK, true };
+  static constexpr DF_CommandDescriptor READ_DATA = { DESFIRE_READ_DATA_FILE, 7, 0, 123, DESFIRE_SV2_OK, true };
+  static constexpr DF_CommandDescriptor WRITE_DATA = { DESFIRE_WRITE_DATA_FILE, 7, 0, 0, DESFIRE_SV2_OK, false };  // + data
+  static constexpr DF_CommandDescriptor CREATE_VALUE_FILE = { DESFIRE_CREATE_VALUE_FILE, 17, 0, 0, DESFIRE_SV2_OK, false };
+  static constexpr DF_CommandDescriptor GET_VALUE = { DESFIRE_GET_VALUE, 1, 4, 4, DESFIRE_SV2_OK, true };
+  static constexpr DF_CommandDescriptor CREDIT = { DESFIRE_CREDIT, 5, 0, 0, DESFIRE_SV2_OK, false };
+  static constexpr DF_CommandDescriptor DEBIT = { DESFIRE_DEBIT, 5, 0, 0, DESFIRE_SV2_OK, false };
+  static constexpr DF_CommandDescriptor LIMITED_CREDIT = { DESFIRE_LIMITED_CREDIT, 5, 0, 0, DESFIRE_SV2_OK, false };
+  static constexpr DF_CommandDescriptor COMMIT_TRANSACTION = { DESFIRE_COMMIT_TRANSACTION, 0, 0, 0, DESFIRE_SV2_OK, false };
+  static constexpr DF_CommandDescriptor ABORT_TRANSACTION = { DESFIRE_ABORT_TRANSACTION, 0, 0, 0, DESFIRE_SV2_OK, false };
+
+  // returns the first descriptor with the command code or NULL
+  static constexpr const DF_CommandDescriptor* find(byte cmd) {
+    const DF_CommandDescriptor* all[] = { &SELECT_APPLICATION, &CREATE_APPLICATION, &GET_VERSION, &GET_FREE_MEMORY, &GET_FILE_SETTINGS, &CREATE_STANDARD_DATA_FILE, &READ_DATA, &WRITE_DATA, &CREATE_VALUE_FILE, &GET_VALUE, &CREDIT, &DEBIT, &LIMITED_CREDIT, &COMMIT_TRANSACTION, &ABORT_TRANSACTION, &GET_VERSION_MORE, &GET_APPLICATION_IDS, &DELETE_FILE, &READ_SIG, &GET_KEY_SETTINGS, &GET_FILE_IDS };
+    for (const DF_CommandDescriptor* descriptor : all) {
+      if (descriptor->cmd == cmd)
+        return descriptor;
+    }
+    return nullptr;
+  }
+};
+
+/////////////////////////////////////////////////////////////////////////////////////
+//
+// APDU encoding
+//
+/////////////////////////////////////////////////////////////////////////////////////
+
+struct DF_Uint24 {
+  uint32_t value;
+};
+
+struct DF_Aid {
+  const byte* bytes;
+};
+
+template <typename T>
+struct DF_Field;
+
+template <>
+struct DF_Field<byte> {
+  static constexpr byte size = 1;
+  static byte* put(byte* out, byte field) {
+    out[0] = field;
+    return out + 1;
+  }
+};
+
+template <>
+struct DF_Field<DF_Uint24> {
+  static constexpr byte size = 3;
+  static byte* put(byte* out, DF_Uint24 field) {
+    out[0] = field.value & 0xff;
+    out[1] = (field.value >> 8) & 0xff;
+    out[2] = (field.value >> 16) & 0xff;
+    return out + 3;
+  }
+};
+
+template <>
+struct DF_Field<int32_t> {
+  static constexpr byte size = 4;
+  static byte* put(byte* out, int32_t field) {
+    uint32_t raw = (uint32_t)field;
+    for (byte i = 0; i < 4; i++)
+      out[i] = (raw >> (8 * i)) & 0xff;
+    return out + 4;
+  }
+};
+
+template <>
+struct DF_Field<DF_Aid> {
+  static constexpr byte size = 3;
+  static byte* put(byte* out, DF_Aid field) {
+    memcpy(out, field.bytes, 3);
+    return out + 3;
+  }
+};
+
+template <typename... Fields>
+constexpr uint16_t DF_FieldsSize() {
+  return (0 + ... + DF_Field<Fields>::size);
+}
+
+// APDU 90 CMD 00 00 [Lc Data] 00
+template <const DF_CommandDescriptor& D>
+struct DF_CommandApdu {
+  static constexpr byte LENGTH = (D.paramLength == 0) ? 5 : D.paramLength + 6;
+
+  byte data[LENGTH];
+
+  template <typename... Fields>
+  explicit DF_CommandApdu(Fields... fields) {
+    static_assert(DF_FieldsSize<Fields...>() == D.paramLength, "the parameters do not match the layout of the command");
+    data[0] = 0x90;   // CLA
+    data[1] = D.cmd;  // CMD
+    data[2] = 0x00;   // P1
+    data[3] = 0x00;   // P2
+    byte* out = &data[4];
+    if (D.paramLength > 0) {
+      *out++ = D.paramLength;  // Lc
+      ((out = DF_Field<Fields>::put(out, fields)), ...);
+    }
+    *out = 0x00;  // Le
+  }
+};
+
+/////////////////////////////////////////////////////////////////////////////////////
+//
+// Status words
+//
+/////////////////////////////////////////////////////////////////////////////////////
+
+struct DF_StatusWordMapping {
+  uint16_t statusWord;
+  ESP32_DESFire::DF_StatusCode statusCode;
+};
+
+struct DF_StatusWords {
+  // sorted by the status word for the binary search
+  static constexpr DF_StatusWordMapping TABLE[] = {
+    { 0x6282, ESP32_DESFire::BOUNDARY_ERROR },  // ISO: end of file reached before Le bytes
+    { 0x6581, ESP32_DESFire::MEMORY_ERROR },
+    { 0x6700, ESP32_DESFire::LENGTH_ERROR },
+    { 0x6982, ESP32_DESFire::SECURITY_NOT_SATISFIED },
+    { 0x6985, ESP32_DESFire::CONDITIONS_NOT_SATISFIED },
+    { 0x6A00, ESP32_DESFire::CLA_NOT_SUPPORTED },
+    { 0x6A82, ESP32_DESFire::FILE_OR_APP_NOT_FOUND },
+    { 0x6A86, ESP32_DESFire::INCORRECT_PARAMS },
+    { 0x6A87, ESP32_DESFire::INCORRECT_LC },
+    { 0x6B00, ESP32_DESFire::BOUNDARY_ERROR },  // ISO: offset outside of the file
+    { 0x910B, ESP32_DESFire::COMMAND_NOT_FOUND },
+    { 0x910C, ESP32_DESFire::COMMAND_FORMAT_ERROR },
+    { 0x910E, ESP32_DESFire::OUT_OF_EEPROM_ERROR },
+    { 0x911C, ESP32_DESFire::ILLEGAL_COMMAND_CODE },
+    { 0x911E, ESP32_DESFire::INTEGRITY_ERROR },
+    { 0x9140, ESP32_DESFire::NO_SUCH_KEY },
+    { 0x917E, ESP32_DESFire::LENGTH_ERROR },
+    { 0x919D, ESP32_DESFire::PERMISSION_DENIED },
+    { 0x919E, ESP32_DESFire::PARAMETER_ERROR },
+    { 0x91A0, ESP32_DESFire::APPLICATION_NOT_FOUND },
+    { 0x91AD, ESP32_DESFire::AUTHENTICATION_DELAY },
+    { 0x91AE, ESP32_DESFire::AUTHENTICATION_ERROR },
+    { 0x91AF, ESP32_DESFire::ADDITIONAL_FRAME },
+    { 0x91BE, ESP32_DESFire::BOUNDARY_ERROR },
+    { 0x91CA, ESP32_DESFire::COMMAND_ABORTED },
+    { 0x91DE, ESP32_DESFire::DUPLICATE_ERROR },
+    { 0x91EE, ESP32_DESFire::MEMORY_ERROR },
+    { 0x91F0, ESP32_DESFire::FILE_NOT_FOUND }
+  };
+  static constexpr size_t COUNT = sizeof(TABLE) / sizeof(TABLE[0]);
+
+  static constexpr bool isSorted() {
+    for (size_t i = 1; i < COUNT; i++) {
+      if (TABLE[i - 1].statusWord >= TABLE[i].statusWord)
+        return false;
+    }
+    return true;
+  }
+
+  static constexpr ESP32_DESFire::DF_StatusCode lookup(uint16_t statusWord) {
+    size_t first = 0;
+    size_t last = COUNT;
+    while (first < last) {
+      size_t middle = (first + last) / 2;
+      if (TABLE[middle].statusWord == statusWord)
+        return TABLE[middle].statusCode;
+      if (TABLE[middle].statusWord < statusWord)
+        first = middle + 1;
+      else
+        last = middle;
+    }
+    return ESP32_DESFire::DF_UNKNOWN_ERROR;
+  }
+};
+
+static_assert(DF_StatusWords::isSorted(), "the status word table has to be sorted");
+static_assert(DF_StatusWords::lookup(0x91AE) == ESP32_DESFire::AUTHENTICATION_ERROR, "status word lookup");
+static_assert(DF_StatusWords::lookup(0x9100) == ESP32_DESFire::DF_UNKNOWN_ERROR, "status word lookup");
+
+#endif
@@ -0,0 +1,317 @@
+#include "ESP32_DESFire_Image.h"
+
+#ifdef ESP_PLATFORM
+#include "esp_partition.h"
+#endif
+
+ESP32_DESFire_Image::ESP32_DESFire_Image(ESP32_DESFire* desfire) {
+  desfireLib = desfire;
+}
+
+uint16_t ESP32_DESFire_Image::DF_GetCommandCount() {
+  return commandCount;
+}
+
+// CreateApplication and GetApplicationIDs are sent on the PICC level, a card that was just
+// activated is on it already
+ESP32_DESFire::DF_StatusCode ESP32_DESFire_Image::DF_SelectPicc() {
+  byte aid[3];
+  if (!desfireLib->DF_GetSelectedApplication(aid) || (aid[0] | aid[1] | aid[2]) == 0)
+    return ESP32_DESFire::DF_STATUS_OK;
+  byte piccAid[3] = { 0x00, 0x00, 0x00 };
+  commandCount++;
+  return desfireLib->DF_Plain_SelectApplication(piccAid);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+//
+// Dump
+//
+/////////////////////////////////////////////////////////////////////////////////////
+
+ESP32_DESFire::DF_StatusCode ESP32_DESFire_Image::DF_Dump(Print* output) {
+  out = output;
+  dumpLength = 0;
+  dumpCrc = 0;
+  commandCount = 0;
+
+  ESP32_DESFire::DF_StatusCode statusCode = DF_SelectPicc();
+  if (statusCode != ESP32_DESFire::DF_STATUS_OK)
+    return statusCode;
+
+  byte version[ESP32_DESFire::VERSION_SIZE];
+  byte versionLen = sizeof(version);
+  commandCount++;
+  statusCode = desfireLib->DF_Plain_GetVersion(version, &versionLen);
+  if (statusCode != ESP32_DESFire::DF_STATUS_OK)
+    return statusCode;
+
+  byte memory[3];
+  byte memoryLen = sizeof(memory);
+  commandCount++;
+  statusCode = desfireLib->DF_Plain_GetFreeMemory(memory, &memoryLen);
+  if (statusCode != ESP32_DESFire::DF_STATUS_OK)
+    return statusCode;
+
+  byte aids[84];  // up to 28 applications
+  byte aidsLen = sizeof(aids);
+  commandCount++;
+  statusCode = desfireLib->DF_Plain_GetApplicationIds(aids, &aidsLen);
+  if (statusCode != ESP32_DESFire::DF_STATUS_OK)
+    return statusCode;
+
+  byte header[DF_IMAGE_HEADER_SIZE] = { 'D', 'F', 'I', 'M', DF_IMAGE_VERSION, 0x00, (byte)(aidsLen / 3), versionLen,
+                                        memory[0], memory[1], memory[2], 0x00 };
+  if (!DF_Emit(header, sizeof(header)) || !DF_Emit(version, versionLen))
+    return ESP32_DESFire::DF_STATUS_NO_ROOM;
+
+  for (byte a = 0; a < aidsLen; a += 3) {
+    byte* aid = &aids[a];
+    commandCount++;
+    statusCode = desfireLib->DF_Plain_SelectApplication(aid);
+    if (statusCode != ESP32_DESFire::DF_STATUS_OK)
+      return statusCode;
+
+    byte keySettings, keyCount;
+    commandCount++;
+    statusCode = desfireLib->DF_Plain_GetKeySettings(&keySettings, &keyCount);
+    if (statusCode != ESP32_DESFire::DF_STATUS_OK)
+      return statusCode;
+
+    byte fileIds[32];
+    byte fileIdsLen = sizeof(fileIds);
+    commandCount++;
+    statusCode = desfireLib->DF_Plain_GetFileIds(fileIds, &fileIdsLen);
+    if (statusCode != ESP32_DESFire::DF_STATUS_OK)
+      return statusCode;
+
+    byte record[DF_IMAGE_APPLICATION_SIZE] = { aid[0], aid[1], aid[2], keySettings, keyCount, fileIdsLen };
+    if (!DF_Emit(record, sizeof(record)))
+      return ESP32_DESFire::DF_STATUS_NO_ROOM;
+
+    for (byte f = 0; f < fileIdsLen; f++) {
+      statusCode = DF_DumpFile(fileIds[f]);
+      if (statusCode != ESP32_DESFire::DF_STATUS_OK)
+        return statusCode;
+    }
+  }
+
+  byte trailer[DF_IMAGE_TRAILER_SIZE];
+  for (byte i = 0; i < DF_IMAGE_TRAILER_SIZE; i++)
+    trailer[i] = dumpCrc >> (8 * i);
+  if (!DF_Emit(trailer, sizeof(trailer)))
+    return ESP32_DESFire::DF_STATUS_NO_ROOM;
+  return ESP32_DESFire::DF_STATUS_OK;
+}
+
+ESP32_DESFire::DF_StatusCode ESP32_DESFire_Image::DF_DumpFile(byte fileNo) {
+  byte settings[ESP32_DESFire::FILE_SETTINGS_SIZE];
+  byte settingsLen = sizeof(settings);
+  commandCount++;
+  ESP32_DESFire::DF_StatusCode statusCode = desfireLib->DF_Plain_GetFileSettings(fileNo, settings, &settingsLen);
+  if (statusCode != ESP32_DESFire::DF_STATUS_OK)
+    return statusCode;
+
+  DF_ImageFile file = { fileNo, 0x00, settingsLen, 0, settings, NULL };
+  DF_ImageFileSettings fileSettings;
+  if (DF_ImageReader::DF_ParseFileSettings(file, &fileSettings) && DF_ImageReader::DF_IsFreeRead(fileSettings)) {
+    bool isDataFile = (fileSettings.fileType == DF_IMAGE_FILE_STANDARD || fileSettings.fileType == DF_IMAGE_FILE_BACKUP);
+    // ReadData takes an offset of 16 bits in this library
+    if ((isDataFile && fileSettings.fileSize <= 0xFFFF) || fileSettings.fileType == DF_IMAGE_FILE_VALUE) {
+      file.flags = DF_IMAGE_FILE_HAS_CONTENT;
+      file.contentLength = fileSettings.fileSize;
+    }
+  }
+
+  byte record[DF_IMAGE_FILE_SIZE] = { fileNo, file.flags, settingsLen, (byte)file.contentLength, (byte)(file.contentLength >> 8), (byte)(file.contentLength >> 16) };
+  if (!DF_Emit(record, sizeof(record)) || !DF_Emit(settings, settingsLen))
+    return ESP32_DESFire::DF_STATUS_NO_ROOM;
+  if (file.flags != DF_IMAGE_FILE_HAS_CONTENT)
+    return ESP32_DESFire::DF_STATUS_OK;
+
+  if (fileSettings.fileType == DF_IMAGE_FILE_VALUE) {
+    int32_t value;
+    commandCount++;
+    statusCode = desfireLib->DF_Plain_GetValue(fileNo, &value);
+    if (statusCode != ESP32_DESFire::DF_STATUS_OK)
+      return statusCode;
+    byte valueData[4];
+    desfireLib->convertInt32To4BytesLsb(value, valueData);
+    return DF_Emit(valueData, sizeof(valueData)) ? ESP32_DESFire::DF_STATUS_OK : ESP32_DESFire::DF_STATUS_NO_ROOM;
+  }
+
+  // the content is passed on chunk by chunk
+  byte chunk[DF_IMAGE_READ_CHUNK];
+  for (uint32_t offset = 0; offset < file.contentLength;) {
+    uint16_t length = (file.contentLength - offset > DF_IMAGE_READ_CHUNK) ? DF_IMAGE_READ_CHUNK : file.contentLength - offset;
+    uint16_t readLen = sizeof(chunk);
+    commandCount++;
+    statusCode = desfireLib->DF_Plain_ReadData_native(fileNo, offset, length, chunk, &readLen);
+    if (statusCode != ESP32_DESFire::DF_STATUS_OK)
+      return statusCode;
+    if (!DF_Emit(chunk, readLen))
+      return ESP32_DESFire::DF_STATUS_NO_ROOM;
+    offset += readLen;
+  }
+  return ESP32_DESFire::DF_STATUS_OK;
+}
+
+bool ESP32_DESFire_Image::DF_Emit(const byte* data, uint32_t length) {
+  if (length == 0)
+    return true;
+  if (out->write(data, length) != length)
+    return false;
+  dumpCrc = DF_ImageCrc32(dumpCrc, data, length);
+  dumpLength += length;
+  return true;
+}
+
+uint32_t ESP32_DESFire_Image::DF_GetDumpLength() {
+  return dumpLength;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+//
+// Restore
+//
+/////////////////////////////////////////////////////////////////////////////////////
+
+bool ESP32_DESFire_Image::DF_SetImage(const byte* image, uint32_t length) {
+  isImageValid = reader.DF_Open(image, length);
+  return isImageValid;
+}
+
+#ifdef ESP_PLATFORM
+bool ESP32_DESFire_Image::DF_MapPartition(const char* label) {
+  const esp_partition_t* partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+  if (partition == NULL)
+    return false;
+  const void* mapped;
+  esp_partition_mmap_handle_t mapHandle;
+  if (esp_partition_mmap(partition, 0, partition->size, ESP_PARTITION_MMAP_DATA, &mapped, &mapHandle) != ESP_OK)
+    return false;
+  // the mapping stays for the lifetime of the sketch, the image ends before the partition
+  return DF_SetImage((const byte*)mapped, partition->size);
+}
+#endif
+
+ESP32_DESFire::DF_StatusCode ESP32_DESFire_Image::DF_Restore() {
+  commandCount = 0;
+  skippedCount = 0;
+  if (!isImageValid)
+    return ESP32_DESFire::DF_STATUS_INVALID;
+
+  ESP32_DESFire::DF_StatusCode statusCode;
+  DF_ImageApplication application;
+  DF_ImageFile file;
+  reader.DF_Rewind();
+  while (reader.DF_NextApplication(&application)) {
+    statusCode = DF_SelectPicc();
+    if (statusCode != ESP32_DESFire::DF_STATUS_OK)
+      return statusCode;
+    commandCount++;
+    statusCode = desfireLib->DF_Plain_CreateApplication(application.aid, application.keySettings, application.keyCount);
+    if (statusCode != ESP32_DESFire::DF_STATUS_OK)
+      return statusCode;
+    commandCount++;
+    statusCode = desfireLib->DF_Plain_SelectApplication(application.aid);
+    if (statusCode != ESP32_DESFire::DF_STATUS_OK)
+      return statusCode;
+
+    while (reader.DF_NextFile(&file)) {
+      statusCode = DF_RestoreFile(file);
+      if (statusCode != ESP32_DESFire::DF_STATUS_OK)
+        return statusCode;
+    }
+  }
+  return ESP32_DESFire::DF_STATUS_OK;
+}
+
+ESP32_DESFire::DF_StatusCode ESP32_DESFire_Image::DF_RestoreFile(const DF_ImageFile& file) {
+  DF_ImageFileSettings settings;
+  if (!DF_ImageReader::DF_ParseFileSettings(file, &settings))
+    return ESP32_DESFire::DF_STATUS_INVALID;
+  bool hasContent = (file.flags & DF_IMAGE_FILE_HAS_CONTENT) != 0 && file.contentLength == settings.fileSize;
+  ESP32_DESFire::DF_CommMode commMode = (ESP32_DESFire::DF_CommMode)settings.commMode;
+  ESP32_DESFire::DF_StatusCode statusCode;
+
+  if (settings.fileType == DF_IMAGE_FILE_VALUE) {
+    // the value is given with the creation
+    int32_t value = 0;
+    if (hasContent)
+      value = desfireLib->convertUint8_t4_2Int32Lsb((byte*)file.content);
+    else
+      skippedCount++;
+    if (value < settings.lowerLimit)
+      value = settings.lowerLimit;
+    if (value > settings.upperLimit)
+      value = settings.upperLimit;
+    commandCount++;
+    return desfireLib->DF_Plain_CreateValueFile(file.fileNo, commMode, settings.accessRightsRwCar, settings.accessRightsRW, settings.lowerLimit, settings.upperLimit, value, settings.limitedCreditOptions);
+  }
+
+  if (settings.fileType != DF_IMAGE_FILE_STANDARD) {
+    skippedCount++;
+    return ESP32_DESFire::DF_STATUS_OK;
+  }
+
+  commandCount++;
+  statusCode = desfireLib->DF_Plain_CreateStandardDataFile(file.fileNo, commMode, settings.accessRightsRwCar, settings.accessRightsRW, settings.fileSize);
+  if (statusCode != ESP32_DESFire::DF_STATUS_OK)
+    return statusCode;
+  if (!hasContent || !DF_ImageReader::DF_IsFreeWrite(settings)) {
+    skippedCount++;
+    return ESP32_DESFire::DF_STATUS_OK;
+  }
+  return DF_WriteContent(file.fileNo, file.content, file.contentLength);
+}
+
+// Only the ranges that are not zero are written, ranges with a gap of up to DF_IMAGE_WRITE_GAP
+// zero bytes are joined
+ESP32_DESFire::DF_StatusCode ESP32_DESFire_Image::DF_WriteContent(byte fileNo, const byte* content, uint32_t length) {
+  uint32_t position = 0;
+  while (position < length) {
+    while (position < length && content[position] == 0x00)
+      position++;
+    if (position == length)
+      break;
+    uint32_t last = position;
+    for (uint32_t i = position + 1; i < length && i - last <= DF_IMAGE_WRITE_GAP; i++) {
+      if (content[i] != 0x00)
+        last = i;
+    }
+    uint16_t rangeLength = last + 1 - position;
+    commandCount += (rangeLength + ESP32_DESFire::NATIVE_WRITE_CHUNK - 1) / ESP32_DESFire::NATIVE_WRITE_CHUNK;
+    ESP32_DESFire::DF_StatusCode statusCode = desfireLib->DF_WriteStandardFile(fileNo, 0, position, &content[position], rangeLength);
+    if (statusCode != ESP32_DESFire::DF_STATUS_OK)
+      return statusCode;
+    position = last + 1;
+  }
+  return ESP32_DESFire::DF_STATUS_OK;
+}
+
+uint16_t ESP32_DESFire_Image::DF_GetSkippedCount() {
+  return skippedCount;
+}
+
+void ESP32_DESFire_Image::DF_ImageDebugPrint() {
+  if (!isImageValid) {
+    Serial.println("The card image is INVALID");
+    return;
+  }
+  const DF_ImageHeader& header = reader.DF_GetHeader();
+  Serial.printf("Card image %lu bytes, %d applications, free memory %lu bytes\n", (unsigned long)reader.DF_GetImageLength(), header.applicationCount, (unsigned long)header.freeMemory);
+
+  DF_ImageApplication application;
+  DF_ImageFile file;
+  DF_ImageFileSettings settings;
+  reader.DF_Rewind();
+  while (reader.DF_NextApplication(&application)) {
+    Serial.printf("AID %02X%02X%02X key settings %02X keys %02X files %d\n", application.aid[2], application.aid[1], application.aid[0], application.keySettings, application.keyCount, application.fileCount);
+    while (reader.DF_NextFile(&file)) {
+      if (!DF_ImageReader::DF_ParseFileSettings(file, &settings))
+        continue;
+      Serial.printf("  file %02d type %02X comm %02X access %02X%02X size %4lu content %s\n", file.fileNo, settings.fileType, settings.commMode, settings.accessRightsRwCar, settings.accessRightsRW, (unsigned long)settings.fileSize, (file.flags & DF_IMAGE_FILE_HAS_CONTENT) ? "yes" : "no");
+    }
+  }
+}
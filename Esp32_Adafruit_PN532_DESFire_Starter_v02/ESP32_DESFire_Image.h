@@ -0,0 +1,83 @@
+/**
+ * Card image dump and restore for the ESP32_DESFire library.
+ *
+ * DF_Dump reads a reference card and writes its image (see ESP32_DESFire_ImageFormat) to a
+ * Print while it is read, so no buffer for the complete card is needed: the image goes to a
+ * file, to Serial or into memory (DF_TraceMemory). The content of standard data, backup and
+ * value files is included when the access rights allow a read without an authentication.
+ * The applications and files have to be listed without an authentication as well.
+ *
+ * DF_SetImage checks an image once, DF_Restore replays it onto every blank card of a fleet
+ * with the fewest commands:
+ *   per application: SelectApplication 000000 (not for the first one on a fresh card),
+ *     CreateApplication, SelectApplication
+ *   per file: CreateStandardDataFile, WriteData for the ranges that are not zero (a new file is
+ *     filled with zeros), value files are created with their value, no Credit is needed
+ * The library does not authenticate, so:
+ * - the files are created when the key settings of the application allow a free creation
+ * - the content is written to files with free write access only, others stay empty
+ * - backup data, record and transaction MAC files are not created
+ * - ISO file identifiers and DF names of the applications are not restored
+ * The count of the files that are skipped or stay empty is given by DF_GetSkippedCount.
+ *
+ * Author: Michael Fehr (AndroidCrypto)
+*/
+
+#ifndef ESP32_DESFire_Image_h
+#define ESP32_DESFire_Image_h
+
+#include "Arduino.h"
+#include "ESP32_DESFire.h"
+#include "ESP32_DESFire_ImageFormat.h"
+
+#define DF_IMAGE_READ_CHUNK (236)  // 4 card frames of 59 bytes, every frame of a ReadData is full
+#define DF_IMAGE_WRITE_GAP (16)    // zero bytes written with the data to save a WriteData command
+
+class ESP32_DESFire_Image {
+
+public:
+
+  ESP32_DESFire_Image(ESP32_DESFire* desfire);
+
+  // Writes the image of the card on the reader to out while it is read. A write to out that
+  // fails returns DF_STATUS_NO_ROOM. Leaves the last application selected.
+  ESP32_DESFire::DF_StatusCode DF_Dump(Print* out);
+  // bytes written by the last dump
+  uint32_t DF_GetDumpLength();
+
+  // Checks the structure and the CRC of the image, it has to stay in memory for DF_Restore.
+  bool DF_SetImage(const byte* image, uint32_t length);
+#ifdef ESP_PLATFORM
+  // maps the image from the data partition with the label into the address space
+  bool DF_MapPartition(const char* label);
+#endif
+  // Creates the applications and files of the image on the blank card on the reader.
+  ESP32_DESFire::DF_StatusCode DF_Restore();
+  // files of the last restore that are not created or not written
+  uint16_t DF_GetSkippedCount();
+
+  // commands sent by the last dump or restore, without the additional frames
+  uint16_t DF_GetCommandCount();
+  // prints the applications and files of the image set with DF_SetImage
+  void DF_ImageDebugPrint();
+
+private:
+
+  ESP32_DESFire* desfireLib;
+  DF_ImageReader reader;
+  bool isImageValid = false;
+
+  Print* out = NULL;
+  uint32_t dumpLength = 0;
+  uint32_t dumpCrc = 0;
+  uint16_t commandCount = 0;
+  uint16_t skippedCount = 0;
+
+  ESP32_DESFire::DF_StatusCode DF_SelectPicc();
+  ESP32_DESFire::DF_StatusCode DF_DumpFile(byte fileNo);
+  ESP32_DESFire::DF_StatusCode DF_RestoreFile(const DF_ImageFile& file);
+  ESP32_DESFire::DF_StatusCode DF_WriteContent(byte fileNo, const byte* content, uint32_t length);
+  bool DF_Emit(const byte* data, uint32_t length);
+};
+
+#endif
@@ -0,0 +1,178 @@
+#include "ESP32_DESFire_ImageFormat.h"
+
+static const uint8_t DF_IMAGE_MAGIC[4] = { 'D', 'F', 'I', 'M' };
+
+static uint32_t DF_GetUint24(const uint8_t* data) {
+  return data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16);
+}
+
+static int32_t DF_GetInt32(const uint8_t* data) {
+  return (int32_t)(data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24));
+}
+
+// half byte table of the reflected polynomial 0xEDB88320
+uint32_t DF_ImageCrc32(uint32_t crc, const uint8_t* data, uint32_t length) {
+  static const uint32_t table[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+  };
+  crc = ~crc;
+  for (uint32_t i = 0; i < length; i++) {
+    crc = (crc >> 4) ^ table[(crc ^ data[i]) & 0x0F];
+    crc = (crc >> 4) ^ table[(crc ^ (data[i] >> 4)) & 0x0F];
+  }
+  return ~crc;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+//
+// Reader
+//
+/////////////////////////////////////////////////////////////////////////////////////
+
+bool DF_ImageReader::DF_Open(const uint8_t* image, uint32_t length) {
+  data = image;
+  imageLength = 0;
+  if (image == 0 || !DF_Walk(length))
+    return false;
+  DF_Rewind();
+  return true;
+}
+
+const DF_ImageHeader& DF_ImageReader::DF_GetHeader() {
+  return header;
+}
+
+uint32_t DF_ImageReader::DF_GetImageLength() {
+  return imageLength;
+}
+
+// every record is checked against the length before it is used, the CRC closes the walk
+bool DF_ImageReader::DF_Walk(uint32_t length) {
+  if (length < DF_IMAGE_HEADER_SIZE)
+    return false;
+  for (uint8_t i = 0; i < 4; i++) {
+    if (data[i] != DF_IMAGE_MAGIC[i])
+      return false;
+  }
+  header.formatVersion = data[4];
+  header.applicationCount = data[6];
+  header.versionLength = data[7];
+  header.freeMemory = DF_GetUint24(&data[8]);
+  header.version = &data[DF_IMAGE_HEADER_SIZE];
+  if (header.formatVersion != DF_IMAGE_VERSION)
+    return false;
+
+  uint32_t walk = DF_IMAGE_HEADER_SIZE + header.versionLength;
+  for (uint8_t a = 0; a < header.applicationCount; a++) {
+    if (walk + DF_IMAGE_APPLICATION_SIZE > length)
+      return false;
+    uint8_t fileCount = data[walk + 5];
+    walk += DF_IMAGE_APPLICATION_SIZE;
+    for (uint8_t f = 0; f < fileCount; f++) {
+      if (walk + DF_IMAGE_FILE_SIZE > length)
+        return false;
+      uint32_t recordLength = DF_IMAGE_FILE_SIZE + data[walk + 2] + DF_GetUint24(&data[walk + 3]);
+      if (recordLength > length - walk)
+        return false;
+      walk += recordLength;
+    }
+  }
+  if (walk + DF_IMAGE_TRAILER_SIZE > length)
+    return false;
+  if (DF_ImageCrc32(0, data, walk) != (uint32_t)DF_GetInt32(&data[walk]))
+    return false;
+  imageLength = walk + DF_IMAGE_TRAILER_SIZE;
+  return true;
+}
+
+void DF_ImageReader::DF_Rewind() {
+  position = DF_IMAGE_HEADER_SIZE + header.versionLength;
+  applicationsLeft = header.applicationCount;
+  filesLeft = 0;
+}
+
+bool DF_ImageReader::DF_NextApplication(DF_ImageApplication* application) {
+  if (imageLength == 0)
+    return false;
+  DF_ImageFile file;
+  while (filesLeft > 0)
+    DF_NextFile(&file);
+  if (applicationsLeft == 0)
+    return false;
+
+  const uint8_t* record = &data[position];
+  for (uint8_t i = 0; i < 3; i++)
+    application->aid[i] = record[i];
+  application->keySettings = record[3];
+  application->keyCount = record[4];
+  application->fileCount = record[5];
+  position += DF_IMAGE_APPLICATION_SIZE;
+  applicationsLeft--;
+  filesLeft = application->fileCount;
+  return true;
+}
+
+bool DF_ImageReader::DF_NextFile(DF_ImageFile* file) {
+  if (filesLeft == 0)
+    return false;
+  const uint8_t* record = &data[position];
+  file->fileNo = record[0];
+  file->flags = record[1];
+  file->settingsLength = record[2];
+  file->contentLength = DF_GetUint24(&record[3]);
+  file->settings = &record[DF_IMAGE_FILE_SIZE];
+  file->content = file->settings + file->settingsLength;
+  position += DF_IMAGE_FILE_SIZE + file->settingsLength + file->contentLength;
+  filesLeft--;
+  return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+//
+// File settings
+//
+/////////////////////////////////////////////////////////////////////////////////////
+
+// data files: type, options, access rights (2), size (3)
+// value files: type, options, access rights (2), lower limit (4), upper limit (4),
+//              limited credit value (4), limited credit options (1)
+bool DF_ImageReader::DF_ParseFileSettings(const DF_ImageFile& file, DF_ImageFileSettings* settings) {
+  const uint8_t* s = file.settings;
+  if (file.settingsLength < 4)
+    return false;
+  settings->fileType = s[0];
+  settings->commMode = s[1] & 0x03;
+  settings->accessRightsRwCar = s[2];
+  settings->accessRightsRW = s[3];
+  settings->fileSize = 0;
+  settings->lowerLimit = 0;
+  settings->upperLimit = 0;
+  settings->limitedCreditOptions = 0;
+
+  if (s[0] == DF_IMAGE_FILE_STANDARD || s[0] == DF_IMAGE_FILE_BACKUP) {
+    if (file.settingsLength < 7)
+      return false;
+    settings->fileSize = DF_GetUint24(&s[4]);
+  } else if (s[0] == DF_IMAGE_FILE_VALUE) {
+    if (file.settingsLength < 17)
+      return false;
+    settings->fileSize = 4;
+    settings->lowerLimit = DF_GetInt32(&s[4]);
+    settings->upperLimit = DF_GetInt32(&s[8]);
+    settings->limitedCreditOptions = s[16];
+  }
+  return true;
+}
+
+bool DF_ImageReader::DF_IsFreeRead(const DF_ImageFileSettings& settings) {
+  bool freeRead = (settings.accessRightsRW >> 4) == 0x0E || (settings.accessRightsRwCar >> 4) == 0x0E;
+  // GetValue is allowed with the R, W and RW access rights, or with the free GetValue option
+  if (settings.fileType == DF_IMAGE_FILE_VALUE)
+    freeRead |= (settings.accessRightsRW & 0x0F) == 0x0E || (settings.limitedCreditOptions & 0x02) != 0;
+  return freeRead;
+}
+
+bool DF_ImageReader::DF_IsFreeWrite(const DF_ImageFileSettings& settings) {
+  return (settings.accessRightsRW & 0x0F) == 0x0E || (settings.accessRightsRwCar >> 4) == 0x0E;
+}
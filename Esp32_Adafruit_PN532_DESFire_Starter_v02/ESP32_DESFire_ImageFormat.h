@@ -0,0 +1,120 @@
+/**
+ * Card image format of the ESP32_DESFire library.
+ *
+ * A card image holds what can be read from a DESFire card without an authentication: the
+ * version data, the applications with their key settings, the settings of all files and the
+ * content of the readable files. It is written by ESP32_DESFire_Image while the card is read
+ * and replayed onto blank cards, the reader below is shared with the inspection tool for the
+ * host (tools/df_image_inspect.cpp) and does not depend on the Arduino framework.
+ *
+ * Image format (all numbers are LSB first as on the card):
+ * Header (12 bytes): 'D' 'F' 'I' 'M', version (1), flags (1, reserved), application count (1),
+ *                    version length (1), free memory (3), reserved (1)
+ * Version (version length bytes): the response of GetVersion (28 or 29 bytes, with the UID)
+ * Application (6 bytes): AID (3), key settings (1), number of keys and key type (1), file count (1)
+ *   File (6 bytes + settings + content): file number (1), flags (1), settings length (1),
+ *        content length (3), the response of GetFileSettings, the content
+ *        (standard data file: the data, value file: the value with 4 bytes)
+ * Trailer (4 bytes): CRC-32 (IEEE 802.3) of all bytes before it
+ * The files follow their application. There is no length of the image in the header, so it
+ * can be written while the card is read; the reader finds the end by walking the records.
+ * An image of a dump that did not finish has no valid trailer and is rejected.
+ *
+ * Author: Michael Fehr (AndroidCrypto)
+*/
+
+#ifndef ESP32_DESFire_ImageFormat_h
+#define ESP32_DESFire_ImageFormat_h
+
+#include <stdint.h>
+
+#define DF_IMAGE_VERSION (0x01)
+#define DF_IMAGE_HEADER_SIZE (12)
+#define DF_IMAGE_APPLICATION_SIZE (6)
+#define DF_IMAGE_FILE_SIZE (6)
+#define DF_IMAGE_TRAILER_SIZE (4)
+#define DF_IMAGE_FILE_HAS_CONTENT (0x01)  // flag: the content was readable and is included
+
+// file types of GetFileSettings
+#define DF_IMAGE_FILE_STANDARD (0x00)
+#define DF_IMAGE_FILE_BACKUP (0x01)
+#define DF_IMAGE_FILE_VALUE (0x02)
+#define DF_IMAGE_FILE_LINEAR_RECORD (0x03)
+#define DF_IMAGE_FILE_CYCLIC_RECORD (0x04)
+
+struct DF_ImageHeader {
+  uint8_t formatVersion;
+  uint8_t applicationCount;
+  uint8_t versionLength;
+  const uint8_t* version;
+  uint32_t freeMemory;
+};
+
+struct DF_ImageApplication {
+  uint8_t aid[3];
+  uint8_t keySettings;
+  uint8_t keyCount;  // number of keys and key type, the appSettings of CreateApplication
+  uint8_t fileCount;
+};
+
+// settings and content point into the image, nothing is copied
+struct DF_ImageFile {
+  uint8_t fileNo;
+  uint8_t flags;
+  uint8_t settingsLength;
+  uint32_t contentLength;
+  const uint8_t* settings;
+  const uint8_t* content;
+};
+
+// the fields of GetFileSettings that are needed to create the file again
+struct DF_ImageFileSettings {
+  uint8_t fileType;
+  uint8_t commMode;           // bits 0 and 1 of the file options
+  uint8_t accessRightsRwCar;  // RW in the high nibble, CAR in the low nibble
+  uint8_t accessRightsRW;     // R in the high nibble, W in the low nibble
+  uint32_t fileSize;          // data files
+  int32_t lowerLimit;         // value files
+  int32_t upperLimit;
+  uint8_t limitedCreditOptions;
+};
+
+class DF_ImageReader {
+
+public:
+
+  // Checks the structure and the CRC of the image, length may be larger than the image
+  // (e.g. a flash partition). Returns false for an invalid or incomplete image.
+  bool DF_Open(const uint8_t* image, uint32_t length);
+  const DF_ImageHeader& DF_GetHeader();
+  // length of the image with the trailer
+  uint32_t DF_GetImageLength();
+
+  // back to the first application
+  void DF_Rewind();
+  // the next application, the files left of the previous one are skipped
+  bool DF_NextApplication(DF_ImageApplication* application);
+  // the next file of the current application
+  bool DF_NextFile(DF_ImageFile* file);
+
+  static bool DF_ParseFileSettings(const DF_ImageFile& file, DF_ImageFileSettings* settings);
+  // 0x0E in one of the access rights that allow the operation
+  static bool DF_IsFreeRead(const DF_ImageFileSettings& settings);
+  static bool DF_IsFreeWrite(const DF_ImageFileSettings& settings);
+
+private:
+
+  const uint8_t* data = 0;
+  uint32_t imageLength = 0;
+  uint32_t position = 0;
+  uint8_t applicationsLeft = 0;
+  uint8_t filesLeft = 0;
+  DF_ImageHeader header;
+
+  bool DF_Walk(uint32_t length);
+};
+
+// CRC-32 over the data, start with crc 0 and feed the result of the previous part
+uint32_t DF_ImageCrc32(uint32_t crc, const uint8_t* data, uint32_t length);
+
+#endif
@@ -0,0 +1,267 @@
+#include "ESP32_DESFire_Journal.h"
+
+#ifdef ESP_PLATFORM
+#include "esp_partition.h"
+#endif
+
+static_assert(sizeof(DF_JournalRecord) == DF_JOURNAL_RECORD_SIZE, "journal record has to be 32 bytes");
+
+/////////////////////////////////////////////////////////////////////////////////////
+//
+// Partition storage
+//
+/////////////////////////////////////////////////////////////////////////////////////
+
+#ifdef ESP_PLATFORM
+DF_PartitionStorage::DF_PartitionStorage(const char* label) {
+  partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+}
+
+bool DF_PartitionStorage::DF_IsAvailable() {
+  return (partition != NULL);
+}
+
+uint32_t DF_PartitionStorage::DF_GetSize() {
+  return (partition == NULL) ? 0 : ((const esp_partition_t*)partition)->size;
+}
+
+uint32_t DF_PartitionStorage::DF_GetSectorSize() {
+  return (partition == NULL) ? 0 : ((const esp_partition_t*)partition)->erase_size;
+}
+
+bool DF_PartitionStorage::DF_Read(uint32_t offset, void* data, uint32_t length) {
+  return (partition != NULL && esp_partition_read((const esp_partition_t*)partition, offset, data, length) == ESP_OK);
+}
+
+bool DF_PartitionStorage::DF_Write(uint32_t offset, const void* data, uint32_t length) {
+  return (partition != NULL && esp_partition_write((const esp_partition_t*)partition, offset, data, length) == ESP_OK);
+}
+
+bool DF_PartitionStorage::DF_EraseSector(uint32_t offset) {
+  return (partition != NULL && esp_partition_erase_range((const esp_partition_t*)partition, offset, DF_GetSectorSize()) == ESP_OK);
+}
+#endif
+
+/////////////////////////////////////////////////////////////////////////////////////
+//
+// Journal
+//
+/////////////////////////////////////////////////////////////////////////////////////
+
+ESP32_DESFire_Journal::ESP32_DESFire_Journal(DF_JournalStorage* storage) {
+  flash = storage;
+}
+
+bool ESP32_DESFire_Journal::DF_Begin() {
+  isReady = false;
+  uint32_t sectorSize = flash->DF_GetSectorSize();
+  if (sectorSize < DF_JOURNAL_RECORD_SIZE)
+    return false;
+  recordsPerSector = sectorSize / DF_JOURNAL_RECORD_SIZE;
+  sectorCount = flash->DF_GetSize() / sectorSize;
+  // a sector is erased when the writing starts in it, which drops the oldest records; with a
+  // single sector that would be the whole journal, so at least 2 are needed
+  if (sectorCount < 2)
+    return false;
+
+  // the newest sector is the one whose first record has the highest sequence
+  DF_JournalRecord record;
+  bool found = false;
+  uint32_t newestSector = 0;
+  uint32_t newestSequence = 0;
+  for (uint32_t sector = 0; sector < sectorCount; sector++) {
+    if (!flash->DF_Read(sector * sectorSize, &record, DF_JOURNAL_RECORD_SIZE))
+      return false;
+    if (DF_IsValid(&record) && (!found || record.sequence > newestSequence)) {
+      found = true;
+      newestSector = sector;
+      newestSequence = record.sequence;
+    }
+  }
+
+  if (!found) {
+    writeSlot = 0;
+    nextSequence = 1;
+    isReady = true;
+    return true;
+  }
+
+  // in the newest sector the write position follows the last valid record, torn records
+  // (written partly before a reset) are skipped, the next record goes to an erased slot
+  uint32_t firstSlot = newestSector * recordsPerSector;
+  writeSlot = firstSlot + recordsPerSector;
+  nextSequence = newestSequence + 1;
+  for (uint32_t i = 1; i < recordsPerSector; i++) {
+    if (!flash->DF_Read((firstSlot + i) * DF_JOURNAL_RECORD_SIZE, &record, DF_JOURNAL_RECORD_SIZE))
+      return false;
+    if (DF_IsValid(&record)) {
+      nextSequence = record.sequence + 1;
+      writeSlot = firstSlot + recordsPerSector;
+    } else if (DF_IsErased(&record)) {
+      if (writeSlot == firstSlot + recordsPerSector)
+        writeSlot = firstSlot + i;
+    } else {
+      writeSlot = firstSlot + recordsPerSector;
+    }
+  }
+  writeSlot %= (sectorCount * recordsPerSector);
+  isReady = true;
+  return true;
+}
+
+bool ESP32_DESFire_Journal::DF_Log(byte eventType, byte* uid, byte uidLength, byte* aid, byte statusCode, uint32_t durationUs) {
+  std::lock_guard<std::mutex> guard(queueLock);
+  if (queueCount >= DF_JOURNAL_QUEUE_SIZE) {
+    droppedCount++;
+    return false;
+  }
+  DF_JournalRecord* record = &queue[(queueFirst + queueCount) % DF_JOURNAL_QUEUE_SIZE];
+  memset(record, 0, sizeof(DF_JournalRecord));
+  record->timestampMs = millis();
+  record->durationUs = durationUs;
+  if (uidLength > sizeof(record->uid))
+    uidLength = sizeof(record->uid);
+  record->uidLength = uidLength;
+  if (uid != NULL)
+    memcpy(record->uid, uid, uidLength);
+  if (aid != NULL)
+    memcpy(record->aid, aid, 3);
+  record->statusCode = statusCode;
+  record->eventType = eventType;
+  if (queueCount == 0)
+    queueSinceMs = record->timestampMs;
+  queueCount++;
+  return true;
+}
+
+bool ESP32_DESFire_Journal::DF_Service() {
+  bool isDue;
+  {
+    std::lock_guard<std::mutex> guard(queueLock);
+    isDue = (queueCount >= batchSize || (queueCount > 0 && millis() - queueSinceMs >= maxDelayMs));
+  }
+  if (!isDue)
+    return true;
+  return DF_Flush();
+}
+
+bool ESP32_DESFire_Journal::DF_Flush() {
+  if (!isReady)
+    return false;
+
+  while (true) {
+    // take as many records as fit into the current sector, the queue stays usable for DF_Log
+    // while the flash is written
+    DF_JournalRecord batch[DF_JOURNAL_QUEUE_SIZE];
+    uint32_t slotInSector = writeSlot % recordsPerSector;
+    uint32_t batchCount;
+    {
+      std::lock_guard<std::mutex> guard(queueLock);
+      batchCount = queueCount;
+      if (batchCount > recordsPerSector - slotInSector)
+        batchCount = recordsPerSector - slotInSector;
+      for (uint32_t i = 0; i < batchCount; i++)
+        memcpy(&batch[i], &queue[(queueFirst + i) % DF_JOURNAL_QUEUE_SIZE], sizeof(DF_JournalRecord));
+    }
+    if (batchCount == 0)
+      return true;
+
+    if (slotInSector == 0) {
+      if (!flash->DF_EraseSector(writeSlot * DF_JOURNAL_RECORD_SIZE))
+        return false;
+      eraseCount++;
+    }
+
+    for (uint32_t i = 0; i < batchCount; i++) {
+      batch[i].sequence = nextSequence + i;
+      batch[i].crc = DF_Crc32((byte*)&batch[i], DF_JOURNAL_RECORD_SIZE - 4);
+    }
+    if (!flash->DF_Write(writeSlot * DF_JOURNAL_RECORD_SIZE, batch, batchCount * DF_JOURNAL_RECORD_SIZE))
+      return false;
+
+    nextSequence += batchCount;
+    writeSlot = (writeSlot + batchCount) % (sectorCount * recordsPerSector);
+    {
+      std::lock_guard<std::mutex> guard(queueLock);
+      queueFirst = (queueFirst + batchCount) % DF_JOURNAL_QUEUE_SIZE;
+      queueCount -= batchCount;
+      queueSinceMs = millis();
+    }
+  }
+}
+
+void ESP32_DESFire_Journal::DF_BeginRead() {
+  // without a flash area there are no sectors (recordsPerSector is 0)
+  readRemaining = 0;
+  if (!isReady)
+    return;
+
+  // the oldest records are in the sector behind the write position (it is erased when the
+  // journal has not wrapped yet, erased slots are skipped)
+  uint32_t slotCount = sectorCount * recordsPerSector;
+  uint32_t sectorStart = writeSlot - (writeSlot % recordsPerSector);
+  readSlot = (sectorStart + recordsPerSector) % slotCount;
+  readRemaining = (slotCount - recordsPerSector) + (writeSlot - sectorStart);
+}
+
+bool ESP32_DESFire_Journal::DF_ReadNext(DF_JournalRecord* record) {
+  uint32_t slotCount = sectorCount * recordsPerSector;
+  while (isReady && readRemaining > 0) {
+    uint32_t slot = readSlot;
+    readSlot = (readSlot + 1) % slotCount;
+    readRemaining--;
+    if (!flash->DF_Read(slot * DF_JOURNAL_RECORD_SIZE, record, DF_JOURNAL_RECORD_SIZE))
+      return false;
+    if (DF_IsValid(record))
+      return true;
+  }
+  return false;
+}
+
+uint32_t ESP32_DESFire_Journal::DF_GetNextSequence() {
+  return nextSequence;
+}
+
+uint32_t ESP32_DESFire_Journal::DF_GetQueuedCount() {
+  std::lock_guard<std::mutex> guard(queueLock);
+  return queueCount;
+}
+
+uint32_t ESP32_DESFire_Journal::DF_GetDroppedCount() {
+  std::lock_guard<std::mutex> guard(queueLock);
+  return droppedCount;
+}
+
+uint32_t ESP32_DESFire_Journal::DF_GetEraseCount() {
+  return eraseCount;
+}
+
+bool ESP32_DESFire_Journal::DF_IsValid(DF_JournalRecord* record) {
+  if (DF_IsErased(record))
+    return false;
+  return (record->crc == DF_Crc32((byte*)record, DF_JOURNAL_RECORD_SIZE - 4));
+}
+
+bool ESP32_DESFire_Journal::DF_IsErased(DF_JournalRecord* record) {
+  byte* data = (byte*)record;
+  for (byte i = 0; i < DF_JOURNAL_RECORD_SIZE; i++) {
+    if (data[i] != 0xFF)
+      return false;
+  }
+  return true;
+}
+
+uint32_t ESP32_DESFire_Journal::DF_Crc32(const byte* data, uint32_t length) {
+  // CRC32 (IEEE 802.3), nibble table to keep the flash footprint small
+  static const uint32_t table[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+  };
+  uint32_t crc = 0xFFFFFFFF;
+  for (uint32_t i = 0; i < length; i++) {
+    crc ^= data[i];
+    crc = (crc >> 4) ^ table[crc & 0x0F];
+    crc = (crc >> 4) ^ table[crc & 0x0F];
+  }
+  return crc ^ 0xFFFFFFFF;
+}
@@ -0,0 +1,135 @@
+/**
+ * Append-only tap event journal for the ESP32_DESFire library.
+ *
+ * The outcome of each tap (UID, AID, status code, timing) is stored as a fixed 32 byte record
+ * in a flash area that is used as a ring of sectors, so every sector is erased equally often.
+ *
+ * DF_Log only copies the record into a RAM queue and never touches the flash, the queue is
+ * written in batches by DF_Service (called from loop() while no card is in the field, or from
+ * a low priority task). DF_Begin recovers the write position at boot: records carry a
+ * sequence number and a CRC32, a record that was torn by a power loss is skipped.
+ *
+ * Record layout (little endian): sequence (4), timestamp in ms (4), duration in us (4),
+ * UID length (1), UID (10), AID (3), status code (1), event type (1), CRC32 over the first
+ * 28 bytes (4)
+ *
+ * Author: Michael Fehr (AndroidCrypto)
+*/
+
+#ifndef ESP32_DESFire_Journal_h
+#define ESP32_DESFire_Journal_h
+
+#include "Arduino.h"
+#include <mutex>
+
+#define DF_JOURNAL_RECORD_SIZE (32)
+#define DF_JOURNAL_QUEUE_SIZE (32)
+
+struct DF_JournalRecord {
+  uint32_t sequence;
+  uint32_t timestampMs;
+  uint32_t durationUs;
+  byte uidLength;
+  byte uid[10];
+  byte aid[3];
+  byte statusCode;
+  byte eventType;
+  uint32_t crc;
+};
+
+// The flash area of the journal, the offsets are relative to the start of the area
+class DF_JournalStorage {
+
+public:
+
+  virtual uint32_t DF_GetSize() = 0;
+  virtual uint32_t DF_GetSectorSize() = 0;
+  virtual bool DF_Read(uint32_t offset, void* data, uint32_t length) = 0;
+  virtual bool DF_Write(uint32_t offset, const void* data, uint32_t length) = 0;
+  virtual bool DF_EraseSector(uint32_t offset) = 0;
+};
+
+#ifdef ESP_PLATFORM
+// A data partition of the ESP32 flash, e.g. 'journal, data, 0x40, , 64K' in partitions.csv
+class DF_PartitionStorage : public DF_JournalStorage {
+
+public:
+
+  DF_PartitionStorage(const char* label);
+
+  bool DF_IsAvailable();
+
+  uint32_t DF_GetSize();
+  uint32_t DF_GetSectorSize();
+  bool DF_Read(uint32_t offset, void* data, uint32_t length);
+  bool DF_Write(uint32_t offset, const void* data, uint32_t length);
+  bool DF_EraseSector(uint32_t offset);
+
+private:
+
+  const void* partition;
+};
+#endif
+
+class ESP32_DESFire_Journal {
+
+public:
+
+  enum DF_JournalEvent : byte {
+    DF_EVENT_TAP = 1,
+    DF_EVENT_ACCESS_GRANTED = 2,
+    DF_EVENT_ACCESS_DENIED = 3,
+    DF_EVENT_ERROR = 4
+  };
+
+  ESP32_DESFire_Journal(DF_JournalStorage* storage);
+
+  // recovers the write position, has to be called once at boot before the first DF_Service
+  bool DF_Begin();
+
+  // copies the record into the RAM queue, false if the queue is full (the record is counted as dropped)
+  bool DF_Log(byte eventType, byte* uid, byte uidLength, byte* aid, byte statusCode, uint32_t durationUs);
+
+  // writes the queue if it holds batchSize records or the oldest record waits longer than maxDelayMs
+  bool DF_Service();
+  // writes the queue now
+  bool DF_Flush();
+
+  // iterates over the stored records, oldest first
+  void DF_BeginRead();
+  bool DF_ReadNext(DF_JournalRecord* record);
+
+  uint32_t DF_GetNextSequence();
+  uint32_t DF_GetQueuedCount();
+  uint32_t DF_GetDroppedCount();
+  uint32_t DF_GetEraseCount();
+
+  byte batchSize = 8;
+  uint16_t maxDelayMs = 2000;
+
+private:
+
+  static uint32_t DF_Crc32(const byte* data, uint32_t length);
+  bool DF_IsValid(DF_JournalRecord* record);
+  bool DF_IsErased(DF_JournalRecord* record);
+
+  DF_JournalStorage* flash;
+  uint32_t recordsPerSector = 0;
+  uint32_t sectorCount = 0;
+  uint32_t writeSlot = 0;  // slot number in the whole area
+  uint32_t nextSequence = 1;
+  bool isReady = false;
+
+  std::mutex queueLock;
+  DF_JournalRecord queue[DF_JOURNAL_QUEUE_SIZE];
+  uint32_t queueFirst = 0;
+  uint32_t queueCount = 0;
+  unsigned long queueSinceMs = 0;
+  uint32_t droppedCount = 0;
+  uint32_t eraseCount = 0;
+
+  uint32_t readSlot = 0;
+  uint32_t readRemaining = 0;
+};
+
+#endif
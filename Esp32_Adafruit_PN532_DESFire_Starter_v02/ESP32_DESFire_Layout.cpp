@@ -0,0 +1,227 @@
+#include "ESP32_DESFire_Layout.h"
+
+ESP32_DESFire_Layout::ESP32_DESFire_Layout(ESP32_DESFire* desfire) {
+  desfireLib = desfire;
+}
+
+void ESP32_DESFire_Layout::DF_SetCosts(const DF_LayoutCosts& costs) {
+  layoutCosts = costs;
+  isPlanValid = false;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+//
+// Planning
+//
+/////////////////////////////////////////////////////////////////////////////////////
+
+ESP32_DESFire::DF_StatusCode ESP32_DESFire_Layout::DF_Plan(const DF_LayoutApplication* applications, byte applicationCount) {
+  isPlanValid = false;
+  fileCount = 0;
+  requiredMemory = 0;
+  unusedBytes = 0;
+
+  if (applicationCount == 0)
+    return ESP32_DESFire::DF_STATUS_INVALID;
+  if (applicationCount > DF_LAYOUT_MAX_APPLICATIONS)
+    return ESP32_DESFire::DF_STATUS_NO_ROOM;
+
+  uint16_t itemTotal = 0;
+  for (byte a = 0; a < applicationCount; a++) {
+    itemBase[a] = itemTotal;
+    itemTotal += applications[a].itemCount;
+  }
+  if (itemTotal > DF_LAYOUT_MAX_ITEMS)
+    return ESP32_DESFire::DF_STATUS_NO_ROOM;
+
+  for (byte a = 0; a < applicationCount; a++) {
+    const DF_LayoutApplication& app = applications[a];
+    byte firstFile = fileCount;
+    byte appFiles = 0;
+
+    // data items by size, largest first (insertion sort, stable), the value items follow
+    byte order[DF_LAYOUT_MAX_ITEMS];
+    for (byte i = 0; i < app.itemCount; i++) {
+      const DF_LayoutItem& item = app.items[i];
+      if (item.type == DF_LAYOUT_DATA && (item.size == 0 || item.size > DF_LAYOUT_MAX_FILE_SIZE))
+        return ESP32_DESFire::DF_STATUS_INVALID;
+      uint16_t size = (item.type == DF_LAYOUT_DATA) ? item.size : 0;
+      byte j = i;
+      while (j > 0 && ((app.items[order[j - 1]].type == DF_LAYOUT_DATA) ? app.items[order[j - 1]].size : 0) < size) {
+        order[j] = order[j - 1];
+        j--;
+      }
+      order[j] = i;
+    }
+
+    // first fit into a file of the application with the same settings
+    for (byte k = 0; k < app.itemCount; k++) {
+      byte i = order[k];
+      const DF_LayoutItem& item = app.items[i];
+      int16_t target = -1;
+      if (item.type == DF_LAYOUT_DATA && !item.ownFile) {
+        for (byte f = firstFile; f < fileCount; f++) {
+          const DF_LayoutItem& fileItem = app.items[files[f].firstItem];
+          if (fileItem.type == DF_LAYOUT_DATA && !fileItem.ownFile && DF_IsSameSettings(fileItem, item)
+              && files[f].usedSize + item.size <= DF_LAYOUT_MAX_FILE_SIZE) {
+            target = f;
+            break;
+          }
+        }
+      }
+      if (target < 0) {
+        if (fileCount >= DF_LAYOUT_MAX_FILES || appFiles >= DF_LAYOUT_MAX_FILES_PER_APPLICATION)
+          return ESP32_DESFire::DF_STATUS_NO_ROOM;
+        files[fileCount].applicationIndex = a;
+        files[fileCount].fileNo = appFiles++;
+        files[fileCount].firstItem = i;
+        files[fileCount].usedSize = 0;
+        target = fileCount++;
+      }
+      placements[itemBase[a] + i].fileNo = files[target].fileNo;
+      placements[itemBase[a] + i].offset = files[target].usedSize;
+      if (item.type == DF_LAYOUT_DATA)
+        files[target].usedSize += item.size;
+    }
+    requiredMemory += layoutCosts.applicationOverhead;
+  }
+
+  for (byte f = 0; f < fileCount; f++) {
+    requiredMemory += layoutCosts.fileOverhead;
+    if (applications[files[f].applicationIndex].items[files[f].firstItem].type == DF_LAYOUT_VALUE) {
+      requiredMemory += layoutCosts.valueFileSize;
+      continue;
+    }
+    uint16_t allocated = DF_AllocatedSize(files[f].usedSize);
+    requiredMemory += allocated;
+    unusedBytes += allocated - files[f].usedSize;
+  }
+
+  apps = applications;
+  appCount = applicationCount;
+  isPlanValid = true;
+  return ESP32_DESFire::DF_STATUS_OK;
+}
+
+uint32_t ESP32_DESFire_Layout::DF_GetRequiredMemory() {
+  return requiredMemory;
+}
+
+uint32_t ESP32_DESFire_Layout::DF_GetUnusedBytes() {
+  return unusedBytes;
+}
+
+byte ESP32_DESFire_Layout::DF_GetFileCount() {
+  return fileCount;
+}
+
+bool ESP32_DESFire_Layout::DF_GetPlacement(byte applicationIndex, byte itemIndex, DF_LayoutPlacement* placement) {
+  if (!isPlanValid || applicationIndex >= appCount || itemIndex >= apps[applicationIndex].itemCount)
+    return false;
+  *placement = placements[itemBase[applicationIndex] + itemIndex];
+  return true;
+}
+
+uint16_t ESP32_DESFire_Layout::DF_AllocatedSize(uint16_t size) {
+  return (size + layoutCosts.blockSize - 1) / layoutCosts.blockSize * layoutCosts.blockSize;
+}
+
+bool ESP32_DESFire_Layout::DF_IsSameSettings(const DF_LayoutItem& a, const DF_LayoutItem& b) {
+  return a.commMode == b.commMode && a.accessRightsRwCar == b.accessRightsRwCar && a.accessRightsRW == b.accessRightsRW;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+//
+// Provisioning
+//
+/////////////////////////////////////////////////////////////////////////////////////
+
+ESP32_DESFire::DF_StatusCode ESP32_DESFire_Layout::DF_Provision(uint32_t* backFreeMemory) {
+  if (!isPlanValid)
+    return ESP32_DESFire::DF_STATUS_INVALID;
+
+  uint32_t freeMemory;
+  ESP32_DESFire::DF_StatusCode statusCode = DF_ReadFreeMemory(&freeMemory);
+  if (statusCode != ESP32_DESFire::DF_STATUS_OK)
+    return statusCode;
+  if (backFreeMemory != NULL)
+    *backFreeMemory = freeMemory;
+  // fail fast, the card keeps its state
+  if (requiredMemory > freeMemory)
+    return ESP32_DESFire::OUT_OF_EEPROM_ERROR;
+
+  byte piccAid[3] = { 0x00, 0x00, 0x00 };
+  for (byte a = 0; a < appCount; a++) {
+    byte aid[3];
+    memcpy(aid, apps[a].aid, 3);
+    // applications are created on the PICC level
+    statusCode = desfireLib->DF_Plain_SelectApplication(piccAid);
+    if (statusCode != ESP32_DESFire::DF_STATUS_OK)
+      return statusCode;
+    statusCode = desfireLib->DF_Plain_CreateApplication(aid, apps[a].keySettings, apps[a].appSettings);
+    if (statusCode != ESP32_DESFire::DF_STATUS_OK)
+      return statusCode;
+    statusCode = desfireLib->DF_Plain_SelectApplication(aid);
+    if (statusCode != ESP32_DESFire::DF_STATUS_OK)
+      return statusCode;
+
+    for (byte f = 0; f < fileCount; f++) {
+      if (files[f].applicationIndex != a)
+        continue;
+      const DF_LayoutItem& item = apps[a].items[files[f].firstItem];
+      if (item.type == DF_LAYOUT_VALUE) {
+        statusCode = desfireLib->DF_Plain_CreateValueFile(files[f].fileNo, item.commMode, item.accessRightsRwCar, item.accessRightsRW, item.lowerLimit, item.upperLimit, item.value, item.limitedCreditOptions);
+      } else {
+        // the rest of the last block is allocated anyway, so the file gets it
+        uint16_t fileSize = DF_AllocatedSize(files[f].usedSize);
+        if (fileSize > DF_LAYOUT_MAX_FILE_SIZE)
+          fileSize = DF_LAYOUT_MAX_FILE_SIZE;
+        statusCode = desfireLib->DF_Plain_CreateStandardDataFile(files[f].fileNo, item.commMode, item.accessRightsRwCar, item.accessRightsRW, fileSize);
+      }
+      if (statusCode != ESP32_DESFire::DF_STATUS_OK)
+        return statusCode;
+    }
+  }
+
+  uint32_t freeMemoryAfter;
+  statusCode = DF_ReadFreeMemory(&freeMemoryAfter);
+  if (statusCode != ESP32_DESFire::DF_STATUS_OK)
+    return statusCode;
+  measuredMemory = freeMemory - freeMemoryAfter;
+  return ESP32_DESFire::DF_STATUS_OK;
+}
+
+uint32_t ESP32_DESFire_Layout::DF_GetMeasuredMemory() {
+  return measuredMemory;
+}
+
+ESP32_DESFire::DF_StatusCode ESP32_DESFire_Layout::DF_ReadFreeMemory(uint32_t* backFreeMemory) {
+  byte backData[3];
+  byte backLen = sizeof(backData);
+  ESP32_DESFire::DF_StatusCode statusCode = desfireLib->DF_Plain_GetFreeMemory(backData, &backLen);
+  if (statusCode != ESP32_DESFire::DF_STATUS_OK)
+    return statusCode;
+  if (backLen != 3)
+    return ESP32_DESFire::DF_WRONG_RESPONSE_LEN;
+  *backFreeMemory = backData[0] | ((uint32_t)backData[1] << 8) | ((uint32_t)backData[2] << 16);
+  return ESP32_DESFire::DF_STATUS_OK;
+}
+
+void ESP32_DESFire_Layout::DF_PlanDebugPrint() {
+  if (!isPlanValid) {
+    Serial.println("The layout plan is INVALID");
+    return;
+  }
+  for (byte f = 0; f < fileCount; f++) {
+    const DF_LayoutApplication& app = apps[files[f].applicationIndex];
+    const DF_LayoutItem& item = app.items[files[f].firstItem];
+    Serial.printf("AID %02X%02X%02X file %02d ", app.aid[2], app.aid[1], app.aid[0], files[f].fileNo);
+    if (item.type == DF_LAYOUT_VALUE)
+      Serial.println("value file");
+    else
+      Serial.printf("data file used %3d of %3d bytes\n", files[f].usedSize, DF_AllocatedSize(files[f].usedSize));
+  }
+  Serial.printf("Applications %d files %d required memory %lu bytes (unused %lu)\n", appCount, fileCount, (unsigned long)requiredMemory, (unsigned long)unusedBytes);
+  if (measuredMemory > 0)
+    Serial.printf("Measured memory of the last provisioning %lu bytes\n", (unsigned long)measuredMemory);
+}
@@ -0,0 +1,135 @@
+/**
+ * Memory layout planner for the ESP32_DESFire library.
+ *
+ * The card allocates its EEPROM in blocks of 32 bytes: a data file of 10 bytes takes a full
+ * block, a value file takes one block and every application takes room for its directory
+ * entry and its keys. The planner takes the applications with the data items they need and
+ * - rounds the file sizes up to full blocks (the rest of a block is free to use anyway)
+ * - packs data items with the same communication mode and access rights into one standard
+ *   data file (largest items first, each file up to DF_LAYOUT_MAX_FILE_SIZE), so small items
+ *   share blocks instead of wasting one each; an item with ownFile set gets a file of its own
+ * - assigns the file numbers and keeps for every item the file number and offset
+ * - sums up the memory of the plan
+ * DF_Provision checks the plan against GetFreeMemory before any create is sent and returns
+ * OUT_OF_EEPROM_ERROR when it does not fit, so a card is not left half provisioned.
+ *
+ * The overhead of an application depends on the card type and the number of keys, the
+ * defaults of DF_LayoutCosts are the values of a DESFire EV1/EV2 with AES keys. DF_Provision
+ * reads the free memory again at the end, DF_GetMeasuredMemory gives the real usage to
+ * adjust the costs for other cards.
+ *
+ * The items and applications are kept by pointer, they have to stay valid until the
+ * provisioning is done.
+ *
+ * Author: Michael Fehr (AndroidCrypto)
+*/
+
+#ifndef ESP32_DESFire_Layout_h
+#define ESP32_DESFire_Layout_h
+
+#include "Arduino.h"
+#include "ESP32_DESFire.h"
+
+#define DF_LAYOUT_MAX_APPLICATIONS (8)
+#define DF_LAYOUT_MAX_ITEMS (48)  // data and value items of all applications
+#define DF_LAYOUT_MAX_FILES (32)  // files of all applications
+#define DF_LAYOUT_MAX_FILES_PER_APPLICATION (32)
+// largest file of a plan: the native path reads and writes with 16 bit offsets, the ISO path
+// up to ISO_MAX_OFFSET + 1, a file of the plan can be used on both (a multiple of the blocks)
+#define DF_LAYOUT_MAX_FILE_SIZE (ESP32_DESFire::ISO_MAX_OFFSET + 1)
+
+enum DF_LayoutItemType : byte {
+  DF_LAYOUT_DATA = 0,  // bytes in a standard data file
+  DF_LAYOUT_VALUE = 1  // a value file
+};
+
+struct DF_LayoutItem {
+  DF_LayoutItemType type = DF_LAYOUT_DATA;
+  uint16_t size = 0;  // data items only
+  ESP32_DESFire::DF_CommMode commMode = ESP32_DESFire::DF_COMMMODE_PLAIN;
+  byte accessRightsRwCar = 0xEE;
+  byte accessRightsRW = 0xEE;
+  bool ownFile = false;              // data items only, the item is not packed with others
+  int32_t lowerLimit = 0;            // value items only
+  int32_t upperLimit = 0;            // value items only
+  int32_t value = 0;                 // value items only
+  byte limitedCreditOptions = 0x00;  // value items only
+};
+
+struct DF_LayoutApplication {
+  byte aid[3];
+  byte keySettings;
+  byte appSettings;  // key type and number of keys, e.g. 0x85 = 5 AES keys
+  const DF_LayoutItem* items;
+  byte itemCount;
+};
+
+// where the planner has put an item
+struct DF_LayoutPlacement {
+  byte fileNo;
+  uint16_t offset;  // 0 for value items
+};
+
+struct DF_LayoutCosts {
+  byte blockSize = 32;                // allocation unit of the EEPROM
+  uint16_t applicationOverhead = 96;  // directory entry and keys of an application
+  uint16_t fileOverhead = 0;          // directory entry of a file, if the card counts it
+  uint16_t valueFileSize = 32;        // a value file takes one block
+};
+
+class ESP32_DESFire_Layout {
+
+public:
+
+  ESP32_DESFire_Layout(ESP32_DESFire* desfire);
+
+  void DF_SetCosts(const DF_LayoutCosts& costs);
+
+  // Plans the files of the applications without talking to the card. Returns DF_STATUS_INVALID
+  // for an empty or oversized data item and DF_STATUS_NO_ROOM when the limits of the planner
+  // or of an application (32 files) are exceeded.
+  ESP32_DESFire::DF_StatusCode DF_Plan(const DF_LayoutApplication* applications, byte applicationCount);
+  // EEPROM bytes the plan takes on the card
+  uint32_t DF_GetRequiredMemory();
+  // bytes in the allocated blocks that are not used by an item
+  uint32_t DF_GetUnusedBytes();
+  byte DF_GetFileCount();
+  bool DF_GetPlacement(byte applicationIndex, byte itemIndex, DF_LayoutPlacement* placement);
+
+  // Creates the applications and files of the plan. Nothing is created when the free memory
+  // of the card is smaller than the plan (OUT_OF_EEPROM_ERROR), backFreeMemory gets the free
+  // memory read before the check.
+  ESP32_DESFire::DF_StatusCode DF_Provision(uint32_t* backFreeMemory = NULL);
+  // memory used by the last DF_Provision, read from the card
+  uint32_t DF_GetMeasuredMemory();
+  void DF_PlanDebugPrint();
+
+private:
+
+  struct DF_LayoutFile {
+    byte applicationIndex;
+    byte fileNo;
+    byte firstItem;  // the settings are taken from this item
+    uint16_t usedSize;
+  };
+
+  ESP32_DESFire* desfireLib;
+  DF_LayoutCosts layoutCosts;
+
+  const DF_LayoutApplication* apps = NULL;
+  byte appCount = 0;
+  bool isPlanValid = false;
+  byte itemBase[DF_LAYOUT_MAX_APPLICATIONS];  // index of the first item of an application
+  DF_LayoutPlacement placements[DF_LAYOUT_MAX_ITEMS];
+  DF_LayoutFile files[DF_LAYOUT_MAX_FILES];
+  byte fileCount = 0;
+  uint32_t requiredMemory = 0;
+  uint32_t unusedBytes = 0;
+  uint32_t measuredMemory = 0;
+
+  uint16_t DF_AllocatedSize(uint16_t size);
+  bool DF_IsSameSettings(const DF_LayoutItem& a, const DF_LayoutItem& b);
+  ESP32_DESFire::DF_StatusCode DF_ReadFreeMemory(uint32_t* backFreeMemory);
+};
+
+#endif
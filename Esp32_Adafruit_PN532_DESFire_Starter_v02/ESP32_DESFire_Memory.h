@@ -0,0 +1,114 @@
+/**
+ * Static memory budget of the ESP32_DESFire library.
+ *
+ * The library does not allocate from the heap: every buffer is a member of a class or an
+ * array of a fixed size on the stack of a command. This header sums up these sizes at
+ * compile time, so the budget is known before the sketch runs on the reader:
+ * - DF_MemoryBudget::STATIC_RAM: RAM of one ESP32_DESFire instance including its transport
+ * - DF_MemoryBudget::COMMANDS: for each command (and the file dump of ESP32_DESFire_Image) the
+ *   arrays on the stack along its deepest call chain (command, DF_Plain_Command_native, recovery
+ *   with SelectApplication, transport and trace record), this is an upper bound
+ * - DF_MemoryBudget::WORST_CASE_STACK: the largest value of all commands
+ * The frames of the functions themselves (saved registers and scalars) come on top, the
+ * compiler reports them per function with the build flag -fstack-usage.
+ *
+ * A sketch checks the budget against the stack of its task with
+ *   static_assert(DF_MemoryBudget::WORST_CASE_STACK <= 4096, "...");
+ * and DF_MemoryBudgetPrint writes the table to the serial monitor.
+ *
+ * Author: Michael Fehr (AndroidCrypto)
+*/
+
+#ifndef ESP32_DESFire_Memory_h
+#define ESP32_DESFire_Memory_h
+
+#include "Arduino.h"
+#include "ESP32_DESFire.h"
+#include "ESP32_DESFire_Commands.h"
+#include "ESP32_DESFire_Image.h"
+#include "ESP32_DESFire_Trace.h"
+
+struct DF_CommandBudget {
+  const char* name;
+  uint16_t stackBuffers;
+};
+
+struct DF_StackBudget {
+  // one exchange: response buffer of DF_Plain_Command_native, transport with the reader library
+  // and trace record
+  static constexpr uint16_t EXCHANGE = ESP32_DESFire::RESPONSE_BUFFER_SIZE + DF_Transport::STACK_BUFFERS + DF_TRACE_MAX_RECORD_SIZE;
+  // kept on the stack while the recovery activates the card (uid and aid) and selects the
+  // application with a second exchange
+  static constexpr uint16_t RECOVERY = ESP32_DESFire::RESPONSE_BUFFER_SIZE + ESP32_DESFire::MAX_UID_SIZE + ESP32_DESFire::AID_SIZE + sizeof(DF_CommandApdu<DF_Commands::SELECT_APPLICATION>);
+  // DF_GetFileSize: the settings of the caller and the response of GetFileSettings
+  static constexpr uint16_t FILE_SIZE_LOOKUP = ESP32_DESFire::FILE_SETTINGS_SIZE + sizeof(DF_CommandApdu<DF_Commands::GET_FILE_SETTINGS>) + ESP32_DESFire::FILE_SETTINGS_RESPONSE_SIZE;
+  // DF_Plain_ReadData_native: the frames are collected in a response buffer of their own
+  static constexpr uint16_t READ_DATA_NATIVE = sizeof(DF_CommandApdu<DF_Commands::READ_DATA>) + sizeof(DF_CommandApdu<DF_Commands::GET_VERSION_MORE>) + ESP32_DESFire::RESPONSE_BUFFER_SIZE;
+};
+
+// the stack of the deeper of two call paths
+constexpr uint16_t DF_DeeperPath(uint16_t first, uint16_t second) {
+  return (first > second) ? first : second;
+}
+
+// commandBuffers: the arrays of the command function itself (APDU and response buffer)
+constexpr uint16_t DF_CommandStack(uint16_t commandBuffers) {
+  return commandBuffers + DF_StackBudget::RECOVERY + DF_StackBudget::EXCHANGE;
+}
+
+constexpr uint16_t DF_WorstCaseStack(const DF_CommandBudget* commands, byte count) {
+  return (count == 0) ? 0 : DF_DeeperPath(commands[0].stackBuffers, DF_WorstCaseStack(commands + 1, count - 1));
+}
+
+struct DF_MemoryBudget {
+
+  static constexpr uint32_t STATIC_RAM = sizeof(ESP32_DESFire);
+
+  // the response buffers of the commands are the arrays in ESP32_DESFire.cpp
+  static constexpr DF_CommandBudget COMMANDS[] = {
+    { "SelectApplication", DF_CommandStack(sizeof(DF_CommandApdu<DF_Commands::SELECT_APPLICATION>)) },
+    { "CreateApplication", DF_CommandStack(sizeof(DF_CommandApdu<DF_Commands::CREATE_APPLICATION>)) },
+    // the frames are collected in a response buffer of its own
+    { "GetApplicationIDs", DF_CommandStack(sizeof(DF_CommandApdu<DF_Commands::GET_APPLICATION_IDS>) + sizeof(DF_CommandApdu<DF_Commands::GET_VERSION_MORE>) + ESP32_DESFire::RESPONSE_BUFFER_SIZE) },
+    { "GetKeySettings", DF_CommandStack(sizeof(DF_CommandApdu<DF_Commands::GET_KEY_SETTINGS>) + ESP32_DESFire::KEY_SETTINGS_SIZE) },
+    { "CreateStandardDataFile", DF_CommandStack(sizeof(DF_CommandApdu<DF_Commands::CREATE_STANDARD_DATA_FILE>)) },
+    { "DeleteFile", DF_CommandStack(sizeof(DF_CommandApdu<DF_Commands::DELETE_FILE>)) },
+    { "GetFileIDs", DF_CommandStack(sizeof(DF_CommandApdu<DF_Commands::GET_FILE_IDS>)) },
+    { "GetFileSettings", DF_CommandStack(sizeof(DF_CommandApdu<DF_Commands::GET_FILE_SETTINGS>) + ESP32_DESFire::FILE_SETTINGS_RESPONSE_SIZE) },
+    { "ReadData", DF_CommandStack(sizeof(DF_CommandApdu<DF_Commands::READ_DATA>) + ESP32_DESFire::MAX_BUFFER_SIZE) },
+    { "WriteData", DF_CommandStack(ESP32_DESFire::MAX_COMMAND_SIZE) },
+    // ReadData of the native path, ReadStandardFile on the ISO path looks up the file size
+    { "ReadStandardFile/ReadData_native", DF_CommandStack(DF_DeeperPath(DF_StackBudget::READ_DATA_NATIVE, DF_StackBudget::FILE_SIZE_LOOKUP)) },
+    // request order and lengths, then the file size lookup or the merged ReadData
+    { "ReadFiles", DF_CommandStack((1 + sizeof(uint16_t)) * ESP32_DESFire::MAX_READ_REQUESTS + DF_DeeperPath(DF_StackBudget::READ_DATA_NATIVE, DF_StackBudget::FILE_SIZE_LOOKUP)) },
+    // the SelectFile by DF name of DF_Iso_SelectApplication is the larger one
+    { "ISO SelectFile", DF_CommandStack(ESP32_DESFire::ISO_SELECT_SIZE) },
+    { "ISO ReadBinary", DF_CommandStack(ESP32_DESFire::APDU_HEADER_SIZE) },
+    { "ISO UpdateBinary", DF_CommandStack(ESP32_DESFire::APDU_HEADER_SIZE + ESP32_DESFire::ISO_CHUNK) },
+    { "GetVersion", DF_CommandStack(sizeof(DF_CommandApdu<DF_Commands::GET_VERSION>) + sizeof(DF_CommandApdu<DF_Commands::GET_VERSION_MORE>) + ESP32_DESFire::VERSION_SIZE) },
+    { "GetFreeMemory", DF_CommandStack(sizeof(DF_CommandApdu<DF_Commands::GET_FREE_MEMORY>)) },
+    { "ReadSig", DF_CommandStack(sizeof(DF_CommandApdu<DF_Commands::READ_SIG>)) },
+    { "GetMoreData", DF_CommandStack(ESP32_DESFire::APDU_HEADER_SIZE + ESP32_DESFire::RESPONSE_BUFFER_SIZE) },
+    { "CreateValueFile", DF_CommandStack(sizeof(DF_CommandApdu<DF_Commands::CREATE_VALUE_FILE>)) },
+    { "GetValue", DF_CommandStack(sizeof(DF_CommandApdu<DF_Commands::GET_VALUE>) + ESP32_DESFire::VALUE_SIZE) },
+    { "Credit/Debit/LimitedCredit", DF_CommandStack(sizeof(DF_CommandApdu<DF_Commands::CREDIT>)) },
+    { "Commit/AbortTransaction", DF_CommandStack(sizeof(DF_CommandApdu<DF_Commands::COMMIT_TRANSACTION>)) },
+    // one value operation at a time, the commit or abort follows after it
+    { "ValueTransaction", DF_CommandStack(DF_DeeperPath(sizeof(DF_CommandApdu<DF_Commands::CREDIT>), sizeof(DF_CommandApdu<DF_Commands::COMMIT_TRANSACTION>))) },
+    // ESP32_DESFire_Image: the settings and the record of the file stay while the content is read in chunks
+    { "Image DumpFile", DF_CommandStack(ESP32_DESFire::FILE_SETTINGS_SIZE + DF_IMAGE_FILE_SIZE + DF_IMAGE_READ_CHUNK + DF_StackBudget::READ_DATA_NATIVE) },
+  };
+  static constexpr byte COMMAND_COUNT = sizeof(COMMANDS) / sizeof(COMMANDS[0]);
+
+  static constexpr uint16_t WORST_CASE_STACK = DF_WorstCaseStack(COMMANDS, COMMAND_COUNT);
+};
+
+inline void DF_MemoryBudgetPrint(Print* out) {
+  out->printf("Static RAM of one session: %lu bytes\n", (unsigned long)DF_MemoryBudget::STATIC_RAM);
+  out->printf("Stack buffers per command (upper bound, without function frames):\n");
+  for (byte i = 0; i < DF_MemoryBudget::COMMAND_COUNT; i++)
+    out->printf("  %-32s %5u bytes\n", DF_MemoryBudget::COMMANDS[i].name, DF_MemoryBudget::COMMANDS[i].stackBuffers);
+  out->printf("Worst case: %u bytes\n", DF_MemoryBudget::WORST_CASE_STACK);
+}
+
+#endif
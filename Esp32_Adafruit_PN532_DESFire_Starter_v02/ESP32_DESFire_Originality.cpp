@@ -0,0 +1,169 @@
+#include "ESP32_DESFire_Originality.h"
+
+const uint8_t ESP32_DESFire_Originality::NXP_DESFIRE_EV3_KEY[DF_P224_PUBLIC_KEY_LENGTH] = {
+  0x04,
+  0x1D, 0xB4, 0x6C, 0x14, 0x5D, 0x0A, 0x36, 0x53, 0x9C, 0x65, 0x44, 0xBD, 0x6D, 0x9B,
+  0x0A, 0xA6, 0x2F, 0xF9, 0x1E, 0xC4, 0x8C, 0xBC, 0x6A, 0xBA, 0xE3, 0x6E, 0x00, 0x89,
+  0xA4, 0x6F, 0x0D, 0x08, 0xC8, 0xA7, 0x15, 0xEA, 0x40, 0xA6, 0x33, 0x13, 0xB9, 0x2E,
+  0x90, 0xDD, 0xC1, 0x73, 0x02, 0x30, 0xE0, 0x45, 0x8A, 0x33, 0x27, 0x6F, 0xB7, 0x43
+};
+
+const uint8_t ESP32_DESFire_Originality::NXP_DESFIRE_EV2_KEY[DF_P224_PUBLIC_KEY_LENGTH] = {
+  0x04,
+  0xB3, 0x04, 0xDC, 0x4C, 0x61, 0x5F, 0x53, 0x26, 0xFE, 0x93, 0x83, 0xDD, 0xEC, 0x9A,
+  0xA8, 0x92, 0xDF, 0x3A, 0x57, 0xFA, 0x7F, 0xFB, 0x32, 0x76, 0x19, 0x2B, 0xC0, 0xEA,
+  0xA2, 0x52, 0xED, 0x45, 0xA8, 0x65, 0xE3, 0xB0, 0x93, 0xA3, 0xD0, 0xDC, 0xE5, 0xBE,
+  0x29, 0xE9, 0x2F, 0x13, 0x92, 0xCE, 0x7D, 0xE3, 0x21, 0xE3, 0xE5, 0xC5, 0x2B, 0x3A
+};
+
+const uint8_t ESP32_DESFire_Originality::NXP_NTAG424_KEY[DF_P224_PUBLIC_KEY_LENGTH] = {
+  0x04,
+  0x8A, 0x9B, 0x38, 0x0A, 0xF2, 0xEE, 0x1B, 0x98, 0xDC, 0x41, 0x7F, 0xEC, 0xC2, 0x63,
+  0xF8, 0x44, 0x9C, 0x76, 0x25, 0xCE, 0xCE, 0x82, 0xD9, 0xB9, 0x16, 0xC9, 0x92, 0xDA,
+  0x20, 0x9D, 0x68, 0x42, 0x2B, 0x81, 0xEC, 0x20, 0xB6, 0x5A, 0x66, 0xB5, 0x10, 0x2A,
+  0x61, 0x59, 0x6A, 0xF3, 0x37, 0x92, 0x00, 0x59, 0x93, 0x16, 0xA0, 0x0A, 0x14, 0x10
+};
+
+ESP32_DESFire_Originality::ESP32_DESFire_Originality(ESP32_DESFire* desfire) {
+  desfireLib = desfire;
+}
+
+bool ESP32_DESFire_Originality::DF_AddNxpKeys() {
+  bool success = DF_AddPublicKey(NXP_DESFIRE_EV3_KEY);
+  success &= DF_AddPublicKey(NXP_DESFIRE_EV2_KEY);
+  success &= DF_AddPublicKey(NXP_NTAG424_KEY);
+  return success;
+}
+
+bool ESP32_DESFire_Originality::DF_AddPublicKey(const uint8_t* publicKey) {
+  if (keyCount >= DF_ORIGINALITY_MAX_KEYS)
+    return false;
+  if (!verifiers[keyCount].DF_SetPublicKey(publicKey))
+    return false;
+  keyCount++;
+  // a cached result may have failed for the missing key
+  DF_ClearCache();
+  return true;
+}
+
+byte ESP32_DESFire_Originality::DF_GetKeyCount() {
+  return keyCount;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+//
+// Check
+//
+/////////////////////////////////////////////////////////////////////////////////////
+
+ESP32_DESFire::DF_StatusCode ESP32_DESFire_Originality::DF_CheckCard(const byte* uid, byte uidLength, bool* backIsGenuine) {
+  if (keyCount == 0 || uidLength == 0 || uidLength > DF_ORIGINALITY_MAX_UID_LENGTH)
+    return ESP32_DESFire::DF_STATUS_INVALID;
+
+  ESP32_DESFire::DF_StatusCode statusCode;
+  byte aid[3];
+  if (desfireLib->DF_GetSelectedApplication(aid) && (aid[0] | aid[1] | aid[2]) != 0) {
+    byte piccAid[3] = { 0x00, 0x00, 0x00 };
+    statusCode = desfireLib->DF_Plain_SelectApplication(piccAid);
+    if (statusCode != ESP32_DESFire::DF_STATUS_OK)
+      return statusCode;
+  }
+
+  byte signature[DF_P224_SIGNATURE_LENGTH];
+  byte signatureLen = sizeof(signature);
+  statusCode = desfireLib->DF_Plain_ReadSig(signature, &signatureLen);
+  if (statusCode != ESP32_DESFire::DF_STATUS_OK)
+    return statusCode;
+
+  DF_CacheEntry* entry = DF_FindEntry(uid, uidLength);
+  if (entry != NULL && memcmp(entry->signature, signature, DF_P224_SIGNATURE_LENGTH) == 0) {
+    cacheHitCount++;
+    entry->lastUse = ++useCounter;
+    *backIsGenuine = entry->isGenuine;
+    return ESP32_DESFire::DF_STATUS_OK;
+  }
+
+  byte keyIndex;
+  bool isGenuine = DF_VerifySignature(uid, uidLength, signature, &keyIndex);
+  DF_StoreEntry(uid, uidLength, signature, isGenuine);
+  *backIsGenuine = isGenuine;
+  return ESP32_DESFire::DF_STATUS_OK;
+}
+
+bool ESP32_DESFire_Originality::DF_VerifySignature(const byte* uid, byte uidLength, const byte* signature, byte* backKeyIndex) {
+  for (byte i = 0; i < keyCount; i++) {
+    byte keyIndex = (lastKeyIndex + i) % keyCount;
+    verificationCount++;
+    if (verifiers[keyIndex].DF_Verify(uid, uidLength, signature)) {
+      lastKeyIndex = keyIndex;
+      if (backKeyIndex != NULL)
+        *backKeyIndex = keyIndex;
+      return true;
+    }
+  }
+  return false;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+//
+// Cache
+//
+/////////////////////////////////////////////////////////////////////////////////////
+
+ESP32_DESFire_Originality::DF_CacheEntry* ESP32_DESFire_Originality::DF_FindEntry(const byte* uid, byte uidLength) {
+  for (byte i = 0; i < cacheCount; i++) {
+    if (cache[i].uidLength == uidLength && memcmp(cache[i].uid, uid, uidLength) == 0)
+      return &cache[i];
+  }
+  return NULL;
+}
+
+void ESP32_DESFire_Originality::DF_StoreEntry(const byte* uid, byte uidLength, const byte* signature, bool isGenuine) {
+  DF_CacheEntry* entry = DF_FindEntry(uid, uidLength);
+  if (entry == NULL) {
+    if (cacheCount < DF_ORIGINALITY_CACHE_SIZE) {
+      entry = &cache[cacheCount++];
+    } else {
+      entry = &cache[0];
+      for (byte i = 1; i < cacheCount; i++) {
+        if (cache[i].lastUse < entry->lastUse)
+          entry = &cache[i];
+      }
+    }
+  }
+  memcpy(entry->uid, uid, uidLength);
+  entry->uidLength = uidLength;
+  memcpy(entry->signature, signature, DF_P224_SIGNATURE_LENGTH);
+  entry->isGenuine = isGenuine;
+  entry->lastUse = ++useCounter;
+}
+
+void ESP32_DESFire_Originality::DF_ClearCache() {
+  cacheCount = 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+//
+// Statistics
+//
+/////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t ESP32_DESFire_Originality::DF_GetVerificationCount() {
+  return verificationCount;
+}
+
+uint32_t ESP32_DESFire_Originality::DF_GetCacheHitCount() {
+  return cacheHitCount;
+}
+
+void ESP32_DESFire_Originality::DF_ResetStatistics() {
+  verificationCount = 0;
+  cacheHitCount = 0;
+}
+
+void ESP32_DESFire_Originality::DF_OriginalityDebugPrint() {
+  Serial.printf("Originality keys  : %d\n", keyCount);
+  Serial.printf("Verifications     : %lu\n", (unsigned long)verificationCount);
+  Serial.printf("Cache hits        : %lu\n", (unsigned long)cacheHitCount);
+  Serial.printf("Cached cards      : %d of %d\n", cacheCount, DF_ORIGINALITY_CACHE_SIZE);
+}
@@ -0,0 +1,88 @@
+/**
+ * Originality check of NXP cards for the ESP32_DESFire library.
+ *
+ * The card holds an ECDSA signature (curve secp224r1) of NXP over its UID, it is read with
+ * Read_Sig and verified with the public originality keys of NXP (see ESP32_DESFire_P224).
+ * - the tables of the curve and of the keys are computed once in DF_AddNxpKeys or
+ *   DF_AddPublicKey, a verification does no setup work
+ * - the key that verified the last card is tried first, a batch of cards of the same type
+ *   needs one verification per card
+ * - the results are cached by UID together with the signature: a repeated tap of a card
+ *   reads the signature again (only the card can present it) and compares it with the
+ *   cached one, the EC math is skipped. The least recently used entry is replaced.
+ *
+ * Note: the signature is over the real UID. Cards with a random UID (e.g. DESFire EV2/EV3
+ * with the random ID enabled) present another UID on every activation, their real UID has
+ * to be read with GetCardUID after an authentication.
+ *
+ * Author: Michael Fehr (AndroidCrypto)
+*/
+
+#ifndef ESP32_DESFire_Originality_h
+#define ESP32_DESFire_Originality_h
+
+#include "Arduino.h"
+#include "ESP32_DESFire.h"
+#include "ESP32_DESFire_P224.h"
+
+#define DF_ORIGINALITY_MAX_KEYS (4)      // the 3 NXP keys and one of your own
+#define DF_ORIGINALITY_CACHE_SIZE (32)
+#define DF_ORIGINALITY_MAX_UID_LENGTH (10)
+
+class ESP32_DESFire_Originality {
+
+public:
+
+  // the originality keys of NXP, uncompressed points
+  static const uint8_t NXP_DESFIRE_EV3_KEY[DF_P224_PUBLIC_KEY_LENGTH];
+  static const uint8_t NXP_DESFIRE_EV2_KEY[DF_P224_PUBLIC_KEY_LENGTH];
+  static const uint8_t NXP_NTAG424_KEY[DF_P224_PUBLIC_KEY_LENGTH];
+
+  ESP32_DESFire_Originality(ESP32_DESFire* desfire);
+
+  // adds the NXP keys, takes some milliseconds for the tables, so call it once at the setup
+  bool DF_AddNxpKeys();
+  // false when the key is not on the curve or there is no room for it
+  bool DF_AddPublicKey(const uint8_t* publicKey);
+  byte DF_GetKeyCount();
+
+  // Reads the signature of the card on the reader and verifies it, backIsGenuine is only set
+  // when the status is DF_STATUS_OK. Returns DF_STATUS_INVALID when no key is added.
+  ESP32_DESFire::DF_StatusCode DF_CheckCard(const byte* uid, byte uidLength, bool* backIsGenuine);
+  // the verification without the card and the cache, backKeyIndex is the key that verified
+  bool DF_VerifySignature(const byte* uid, byte uidLength, const byte* signature, byte* backKeyIndex);
+
+  void DF_ClearCache();
+  uint32_t DF_GetVerificationCount();  // signatures verified with the EC math
+  uint32_t DF_GetCacheHitCount();
+  void DF_ResetStatistics();
+  void DF_OriginalityDebugPrint();
+
+private:
+
+  struct DF_CacheEntry {
+    byte uid[DF_ORIGINALITY_MAX_UID_LENGTH];
+    byte uidLength;
+    bool isGenuine;
+    uint32_t lastUse;
+    byte signature[DF_P224_SIGNATURE_LENGTH];
+  };
+
+  ESP32_DESFire* desfireLib;
+
+  DF_P224Verifier verifiers[DF_ORIGINALITY_MAX_KEYS];
+  byte keyCount = 0;
+  byte lastKeyIndex = 0;
+
+  DF_CacheEntry cache[DF_ORIGINALITY_CACHE_SIZE];
+  byte cacheCount = 0;
+  uint32_t useCounter = 0;
+
+  uint32_t verificationCount = 0;
+  uint32_t cacheHitCount = 0;
+
+  DF_CacheEntry* DF_FindEntry(const byte* uid, byte uidLength);
+  void DF_StoreEntry(const byte* uid, byte uidLength, const byte* signature, bool isGenuine);
+};
+
+#endif
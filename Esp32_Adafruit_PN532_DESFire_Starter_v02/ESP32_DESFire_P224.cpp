@@ -0,0 +1,406 @@
+#include "ESP32_DESFire_P224.h"
+#include <string.h>
+
+/////////////////////////////////////////////////////////////////////////////////////
+//
+// Curve parameters (SEC 2, big endian)
+//
+/////////////////////////////////////////////////////////////////////////////////////
+
+static const uint8_t DF_P224_P[DF_P224_BYTES] = {
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01
+};
+static const uint8_t DF_P224_B[DF_P224_BYTES] = {
+  0xB4, 0x05, 0x0A, 0x85, 0x0C, 0x04, 0xB3, 0xAB, 0xF5, 0x41, 0x32, 0x56, 0x50, 0x44,
+  0xB0, 0xB7, 0xD7, 0xBF, 0xD8, 0xBA, 0x27, 0x0B, 0x39, 0x43, 0x23, 0x55, 0xFF, 0xB4
+};
+static const uint8_t DF_P224_N[DF_P224_BYTES] = {
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0x16, 0xA2, 0xE0, 0xB8, 0xF0, 0x3E, 0x13, 0xDD, 0x29, 0x45, 0x5C, 0x5C, 0x2A, 0x3D
+};
+static const uint8_t DF_P224_G[DF_P224_PUBLIC_KEY_LENGTH] = {
+  0x04,
+  0xB7, 0x0E, 0x0C, 0xBD, 0x6B, 0xB4, 0xBF, 0x7F, 0x32, 0x13, 0x90, 0xB9, 0x4A, 0x03,
+  0xC1, 0xD3, 0x56, 0xC2, 0x11, 0x22, 0x34, 0x32, 0x80, 0xD6, 0x11, 0x5C, 0x1D, 0x21,
+  0xBD, 0x37, 0x63, 0x88, 0xB5, 0xF7, 0x23, 0xFB, 0x4C, 0x22, 0xDF, 0xE6, 0xCD, 0x43,
+  0x75, 0xA0, 0x5A, 0x07, 0x47, 0x64, 0x44, 0xD5, 0x81, 0x99, 0x85, 0x00, 0x7E, 0x34
+};
+
+/////////////////////////////////////////////////////////////////////////////////////
+//
+// Numbers and Montgomery arithmetic
+//
+/////////////////////////////////////////////////////////////////////////////////////
+
+struct DF_P224Modulus {
+  uint32_t m[DF_P224_WORDS];
+  uint32_t m0Inverse;          // -m^-1 mod 2^32
+  uint32_t one[DF_P224_WORDS];  // R mod m (R = 2^224), the 1 in Montgomery form
+  uint32_t rr[DF_P224_WORDS];   // R^2 mod m
+};
+
+struct DF_P224JacobianPoint {
+  uint32_t x[DF_P224_WORDS];
+  uint32_t y[DF_P224_WORDS];
+  uint32_t z[DF_P224_WORDS];  // 0 = point at infinity
+};
+
+static DF_P224Modulus fieldModulus;
+static DF_P224Modulus orderModulus;
+static uint32_t curveB[DF_P224_WORDS];
+static DF_P224Point generatorTable[DF_P224_TABLE_SIZE];
+static bool isCurveReady = false;
+
+static void DF_FromBytes(uint32_t* r, const uint8_t* bytes) {
+  for (uint8_t i = 0; i < DF_P224_WORDS; i++) {
+    const uint8_t* b = &bytes[DF_P224_BYTES - 4 - 4 * i];
+    r[i] = ((uint32_t)b[0] << 24) | ((uint32_t)b[1] << 16) | ((uint32_t)b[2] << 8) | b[3];
+  }
+}
+
+static bool DF_IsZero(const uint32_t* a) {
+  uint32_t bits = 0;
+  for (uint8_t i = 0; i < DF_P224_WORDS; i++)
+    bits |= a[i];
+  return bits == 0;
+}
+
+static int DF_Compare(const uint32_t* a, const uint32_t* b) {
+  for (int8_t i = DF_P224_WORDS - 1; i >= 0; i--) {
+    if (a[i] != b[i])
+      return (a[i] > b[i]) ? 1 : -1;
+  }
+  return 0;
+}
+
+// returns the carry
+static uint32_t DF_AddWords(uint32_t* r, const uint32_t* a, const uint32_t* b) {
+  uint64_t carry = 0;
+  for (uint8_t i = 0; i < DF_P224_WORDS; i++) {
+    carry += (uint64_t)a[i] + b[i];
+    r[i] = (uint32_t)carry;
+    carry >>= 32;
+  }
+  return (uint32_t)carry;
+}
+
+// returns the borrow
+static uint32_t DF_SubWords(uint32_t* r, const uint32_t* a, const uint32_t* b) {
+  int64_t borrow = 0;
+  for (uint8_t i = 0; i < DF_P224_WORDS; i++) {
+    borrow += (int64_t)a[i] - b[i];
+    r[i] = (uint32_t)borrow;
+    borrow >>= 32;
+  }
+  return (uint32_t)(borrow & 1);
+}
+
+static void DF_ModAdd(uint32_t* r, const uint32_t* a, const uint32_t* b, const DF_P224Modulus& mod) {
+  if (DF_AddWords(r, a, b) || DF_Compare(r, mod.m) >= 0)
+    DF_SubWords(r, r, mod.m);
+}
+
+static void DF_ModSub(uint32_t* r, const uint32_t* a, const uint32_t* b, const DF_P224Modulus& mod) {
+  if (DF_SubWords(r, a, b))
+    DF_AddWords(r, r, mod.m);
+}
+
+// r = a * b / R mod m (CIOS), a and b below m
+static void DF_MontMul(uint32_t* r, const uint32_t* a, const uint32_t* b, const DF_P224Modulus& mod) {
+  uint32_t t[DF_P224_WORDS + 2] = { 0 };
+  for (uint8_t i = 0; i < DF_P224_WORDS; i++) {
+    uint64_t carry = 0;
+    for (uint8_t j = 0; j < DF_P224_WORDS; j++) {
+      carry += (uint64_t)a[j] * b[i] + t[j];
+      t[j] = (uint32_t)carry;
+      carry >>= 32;
+    }
+    carry += t[DF_P224_WORDS];
+    t[DF_P224_WORDS] = (uint32_t)carry;
+    t[DF_P224_WORDS + 1] = (uint32_t)(carry >> 32);
+
+    uint32_t u = t[0] * mod.m0Inverse;
+    carry = ((uint64_t)u * mod.m[0] + t[0]) >> 32;
+    for (uint8_t j = 1; j < DF_P224_WORDS; j++) {
+      carry += (uint64_t)u * mod.m[j] + t[j];
+      t[j - 1] = (uint32_t)carry;
+      carry >>= 32;
+    }
+    carry += t[DF_P224_WORDS];
+    t[DF_P224_WORDS - 1] = (uint32_t)carry;
+    t[DF_P224_WORDS] = t[DF_P224_WORDS + 1] + (uint32_t)(carry >> 32);
+  }
+  if (t[DF_P224_WORDS] != 0 || DF_Compare(t, mod.m) >= 0)
+    DF_SubWords(t, t, mod.m);
+  memcpy(r, t, DF_P224_WORDS * sizeof(uint32_t));
+}
+
+// r = a^exponent in Montgomery form, the exponent is a plain number
+static void DF_MontPow(uint32_t* r, const uint32_t* a, const uint32_t* exponent, const DF_P224Modulus& mod) {
+  uint32_t result[DF_P224_WORDS];
+  memcpy(result, mod.one, sizeof(result));
+  for (int16_t bit = DF_P224_WORDS * 32 - 1; bit >= 0; bit--) {
+    DF_MontMul(result, result, result, mod);
+    if ((exponent[bit / 32] >> (bit % 32)) & 1)
+      DF_MontMul(result, result, a, mod);
+  }
+  memcpy(r, result, sizeof(result));
+}
+
+// a^-1 by Fermat (the moduli are prime), in and out in Montgomery form
+static void DF_MontInverse(uint32_t* r, const uint32_t* a, const DF_P224Modulus& mod) {
+  uint32_t two[DF_P224_WORDS] = { 2 };
+  uint32_t exponent[DF_P224_WORDS];
+  DF_SubWords(exponent, mod.m, two);
+  DF_MontPow(r, a, exponent, mod);
+}
+
+static void DF_SetupModulus(DF_P224Modulus& mod, const uint8_t* modulus) {
+  DF_FromBytes(mod.m, modulus);
+  // Newton iteration for the inverse of m[0] modulo 2^32
+  uint32_t inverse = mod.m[0];
+  for (uint8_t i = 0; i < 5; i++)
+    inverse *= 2 - mod.m[0] * inverse;
+  mod.m0Inverse = 0 - inverse;
+  // R mod m = 2^224 - m, as m is larger than 2^223
+  uint32_t zero[DF_P224_WORDS] = { 0 };
+  DF_SubWords(mod.one, zero, mod.m);
+  // R^2 mod m by doubling R another 224 times
+  memcpy(mod.rr, mod.one, sizeof(mod.rr));
+  for (uint16_t i = 0; i < DF_P224_WORDS * 32; i++)
+    DF_ModAdd(mod.rr, mod.rr, mod.rr, mod);
+}
+
+static void DF_ToMont(uint32_t* r, const uint32_t* a, const DF_P224Modulus& mod) {
+  DF_MontMul(r, a, mod.rr, mod);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+//
+// Points
+//
+/////////////////////////////////////////////////////////////////////////////////////
+
+// dbl-2001-b for a = -3
+static void DF_PointDouble(DF_P224JacobianPoint& p) {
+  if (DF_IsZero(p.z))
+    return;
+  const DF_P224Modulus& f = fieldModulus;
+  uint32_t delta[DF_P224_WORDS], gamma[DF_P224_WORDS], beta[DF_P224_WORDS], alpha[DF_P224_WORDS];
+  uint32_t t1[DF_P224_WORDS], t2[DF_P224_WORDS];
+
+  DF_MontMul(delta, p.z, p.z, f);
+  DF_MontMul(gamma, p.y, p.y, f);
+  DF_MontMul(beta, p.x, gamma, f);
+  // alpha = 3 * (X - delta) * (X + delta)
+  DF_ModSub(t1, p.x, delta, f);
+  DF_ModAdd(t2, p.x, delta, f);
+  DF_MontMul(alpha, t1, t2, f);
+  DF_ModAdd(t1, alpha, alpha, f);
+  DF_ModAdd(alpha, t1, alpha, f);
+  // Z3 = (Y + Z)^2 - gamma - delta
+  DF_ModAdd(t1, p.y, p.z, f);
+  DF_MontMul(p.z, t1, t1, f);
+  DF_ModSub(p.z, p.z, gamma, f);
+  DF_ModSub(p.z, p.z, delta, f);
+  // X3 = alpha^2 - 8 * beta
+  DF_ModAdd(beta, beta, beta, f);
+  DF_ModAdd(beta, beta, beta, f);  // 4 * beta
+  DF_ModAdd(t1, beta, beta, f);    // 8 * beta
+  DF_MontMul(p.x, alpha, alpha, f);
+  DF_ModSub(p.x, p.x, t1, f);
+  // Y3 = alpha * (4 * beta - X3) - 8 * gamma^2
+  DF_ModSub(t1, beta, p.x, f);
+  DF_MontMul(t1, alpha, t1, f);
+  DF_MontMul(t2, gamma, gamma, f);
+  DF_ModAdd(t2, t2, t2, f);
+  DF_ModAdd(t2, t2, t2, f);
+  DF_ModAdd(t2, t2, t2, f);
+  DF_ModSub(p.y, t1, t2, f);
+}
+
+// madd-2007-bl, q is affine
+static void DF_PointAddAffine(DF_P224JacobianPoint& p, const DF_P224Point& q) {
+  const DF_P224Modulus& f = fieldModulus;
+  if (DF_IsZero(p.z)) {
+    memcpy(p.x, q.x, sizeof(p.x));
+    memcpy(p.y, q.y, sizeof(p.y));
+    memcpy(p.z, f.one, sizeof(p.z));
+    return;
+  }
+  uint32_t z1z1[DF_P224_WORDS], u2[DF_P224_WORDS], s2[DF_P224_WORDS], h[DF_P224_WORDS], r[DF_P224_WORDS];
+  uint32_t hh[DF_P224_WORDS], i[DF_P224_WORDS], j[DF_P224_WORDS], v[DF_P224_WORDS], t[DF_P224_WORDS];
+
+  DF_MontMul(z1z1, p.z, p.z, f);
+  DF_MontMul(u2, q.x, z1z1, f);
+  DF_MontMul(s2, q.y, p.z, f);
+  DF_MontMul(s2, s2, z1z1, f);
+  DF_ModSub(h, u2, p.x, f);
+  DF_ModSub(r, s2, p.y, f);
+  if (DF_IsZero(h)) {
+    if (DF_IsZero(r))
+      DF_PointDouble(p);  // p == q
+    else
+      memset(p.z, 0, sizeof(p.z));  // p == -q
+    return;
+  }
+  DF_MontMul(hh, h, h, f);
+  DF_ModAdd(i, hh, hh, f);
+  DF_ModAdd(i, i, i, f);
+  DF_MontMul(j, h, i, f);
+  DF_ModAdd(r, r, r, f);
+  DF_MontMul(v, p.x, i, f);
+  // Z3 = (Z1 + H)^2 - Z1Z1 - HH
+  DF_ModAdd(t, p.z, h, f);
+  DF_MontMul(p.z, t, t, f);
+  DF_ModSub(p.z, p.z, z1z1, f);
+  DF_ModSub(p.z, p.z, hh, f);
+  // X3 = r^2 - J - 2 * V
+  DF_MontMul(p.x, r, r, f);
+  DF_ModSub(p.x, p.x, j, f);
+  DF_ModSub(p.x, p.x, v, f);
+  DF_ModSub(p.x, p.x, v, f);
+  // Y3 = r * (V - X3) - 2 * Y1 * J
+  DF_ModSub(t, v, p.x, f);
+  DF_MontMul(t, r, t, f);
+  DF_MontMul(j, p.y, j, f);
+  DF_ModAdd(j, j, j, f);
+  DF_ModSub(p.y, t, j, f);
+}
+
+static void DF_ToAffine(DF_P224Point& r, const DF_P224JacobianPoint& p) {
+  const DF_P224Modulus& f = fieldModulus;
+  uint32_t zInverse[DF_P224_WORDS], zInverse2[DF_P224_WORDS];
+  DF_MontInverse(zInverse, p.z, f);
+  DF_MontMul(zInverse2, zInverse, zInverse, f);
+  DF_MontMul(r.x, p.x, zInverse2, f);
+  DF_MontMul(zInverse2, zInverse2, zInverse, f);
+  DF_MontMul(r.y, p.y, zInverse2, f);
+}
+
+// y^2 = x^3 - 3x + b, the coordinates in Montgomery form
+static bool DF_IsOnCurve(const DF_P224Point& p) {
+  const DF_P224Modulus& f = fieldModulus;
+  uint32_t left[DF_P224_WORDS], right[DF_P224_WORDS], t[DF_P224_WORDS];
+  DF_MontMul(left, p.y, p.y, f);
+  DF_MontMul(right, p.x, p.x, f);
+  DF_MontMul(right, right, p.x, f);
+  DF_ModAdd(t, p.x, p.x, f);
+  DF_ModAdd(t, t, p.x, f);
+  DF_ModSub(right, right, t, f);
+  DF_ModAdd(right, right, curveB, f);
+  return DF_Compare(left, right) == 0;
+}
+
+static bool DF_LoadPoint(DF_P224Point& p, const uint8_t* encoded) {
+  if (encoded[0] != 0x04)
+    return false;
+  uint32_t x[DF_P224_WORDS], y[DF_P224_WORDS];
+  DF_FromBytes(x, &encoded[1]);
+  DF_FromBytes(y, &encoded[1 + DF_P224_BYTES]);
+  if (DF_Compare(x, fieldModulus.m) >= 0 || DF_Compare(y, fieldModulus.m) >= 0)
+    return false;
+  DF_ToMont(p.x, x, fieldModulus);
+  DF_ToMont(p.y, y, fieldModulus);
+  return DF_IsOnCurve(p);
+}
+
+// table[i] = i * table[1]
+static void DF_BuildTable(DF_P224Point* table) {
+  DF_P224JacobianPoint multiple;
+  memcpy(multiple.x, table[1].x, sizeof(multiple.x));
+  memcpy(multiple.y, table[1].y, sizeof(multiple.y));
+  memcpy(multiple.z, fieldModulus.one, sizeof(multiple.z));
+  for (uint8_t i = 2; i < DF_P224_TABLE_SIZE; i++) {
+    DF_PointAddAffine(multiple, table[1]);
+    DF_ToAffine(table[i], multiple);
+  }
+}
+
+static void DF_SetupCurve() {
+  if (isCurveReady)
+    return;
+  DF_SetupModulus(fieldModulus, DF_P224_P);
+  DF_SetupModulus(orderModulus, DF_P224_N);
+  uint32_t b[DF_P224_WORDS];
+  DF_FromBytes(b, DF_P224_B);
+  DF_ToMont(curveB, b, fieldModulus);
+  DF_LoadPoint(generatorTable[1], DF_P224_G);
+  DF_BuildTable(generatorTable);
+  isCurveReady = true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+//
+// Verifier
+//
+/////////////////////////////////////////////////////////////////////////////////////
+
+bool DF_P224Verifier::DF_SetPublicKey(const uint8_t* publicKey) {
+  DF_SetupCurve();
+  isKeySet = false;
+  if (!DF_LoadPoint(keyTable[1], publicKey))
+    return false;
+  DF_BuildTable(keyTable);
+  isKeySet = true;
+  return true;
+}
+
+bool DF_P224Verifier::DF_Verify(const uint8_t* message, uint8_t messageLength, const uint8_t* signature) {
+  if (!isKeySet)
+    return false;
+  const DF_P224Modulus& n = orderModulus;
+
+  uint32_t r[DF_P224_WORDS], s[DF_P224_WORDS], e[DF_P224_WORDS];
+  DF_FromBytes(r, signature);
+  DF_FromBytes(s, &signature[DF_P224_BYTES]);
+  if (DF_IsZero(r) || DF_IsZero(s) || DF_Compare(r, n.m) >= 0 || DF_Compare(s, n.m) >= 0)
+    return false;
+
+  // the message as number, a shorter message is right aligned
+  uint8_t messageBytes[DF_P224_BYTES] = { 0 };
+  if (messageLength > DF_P224_BYTES)
+    messageLength = DF_P224_BYTES;
+  memcpy(&messageBytes[DF_P224_BYTES - messageLength], message, messageLength);
+  DF_FromBytes(e, messageBytes);
+  if (DF_Compare(e, n.m) >= 0)
+    DF_SubWords(e, e, n.m);
+
+  // w = s^-1 in Montgomery form, Montgomery multiplication with a plain number gives plain u1 and u2
+  uint32_t w[DF_P224_WORDS], u1[DF_P224_WORDS], u2[DF_P224_WORDS];
+  DF_ToMont(w, s, n);
+  DF_MontInverse(w, w, n);
+  DF_MontMul(u1, e, w, n);
+  DF_MontMul(u2, r, w, n);
+
+  // u1 * G + u2 * Q, 4 bits of both scalars per step
+  DF_P224JacobianPoint sum;
+  memset(sum.z, 0, sizeof(sum.z));
+  for (int8_t window = DF_P224_WORDS * 8 - 1; window >= 0; window--) {
+    for (uint8_t i = 0; i < 4; i++)
+      DF_PointDouble(sum);
+    uint8_t d1 = (u1[window / 8] >> ((window % 8) * 4)) & 0x0F;
+    uint8_t d2 = (u2[window / 8] >> ((window % 8) * 4)) & 0x0F;
+    if (d1 != 0)
+      DF_PointAddAffine(sum, generatorTable[d1]);
+    if (d2 != 0)
+      DF_PointAddAffine(sum, keyTable[d2]);
+  }
+  if (DF_IsZero(sum.z))
+    return false;
+
+  // x mod n == r, without inversion: X == r * Z^2, or X == (r + n) * Z^2 when r + n < p
+  const DF_P224Modulus& f = fieldModulus;
+  uint32_t z2[DF_P224_WORDS], candidate[DF_P224_WORDS];
+  DF_MontMul(z2, sum.z, sum.z, f);
+  DF_ToMont(candidate, r, f);
+  DF_MontMul(candidate, candidate, z2, f);
+  if (DF_Compare(candidate, sum.x) == 0)
+    return true;
+  if (DF_AddWords(r, r, n.m) != 0 || DF_Compare(r, f.m) >= 0)
+    return false;
+  DF_ToMont(candidate, r, f);
+  DF_MontMul(candidate, candidate, z2, f);
+  return DF_Compare(candidate, sum.x) == 0;
+}
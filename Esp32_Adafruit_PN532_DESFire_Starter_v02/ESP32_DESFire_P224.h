@@ -0,0 +1,55 @@
+/**
+ * ECDSA signature verification on the curve secp224r1 (NIST P-224) for the ESP32_DESFire library.
+ *
+ * It is used for the originality signature of NXP cards (see ESP32_DESFire_Originality). Only
+ * verifications with public data are done, so the code does not need to run in constant time.
+ * - numbers are 7 words of 32 bits (least significant word first), the arithmetic modulo the
+ *   prime p and modulo the group order n uses Montgomery multiplication
+ * - points are kept in Jacobian coordinates, so there is no inversion in a verification
+ * - u1 * G + u2 * Q is computed in one pass over both scalars (Shamir's trick) with windows
+ *   of 4 bits: 224 point doublings and up to 112 additions of a precomputed point
+ * The tables with the multiples 1..15 of the generator G and of the public key Q are
+ * computed once: the generator table on the first DF_SetPublicKey of any verifier, the table
+ * of the key in DF_SetPublicKey. They are kept in affine coordinates for the cheaper mixed
+ * addition.
+ *
+ * The code does not depend on the Arduino framework and runs on Linux as well.
+ *
+ * Author: Michael Fehr (AndroidCrypto)
+*/
+
+#ifndef ESP32_DESFire_P224_h
+#define ESP32_DESFire_P224_h
+
+#include <stdint.h>
+
+#define DF_P224_WORDS (7)
+#define DF_P224_BYTES (28)
+#define DF_P224_PUBLIC_KEY_LENGTH (57)  // 04 || X || Y
+#define DF_P224_SIGNATURE_LENGTH (56)   // r || s
+#define DF_P224_TABLE_SIZE (16)         // multiples 0..15 for windows of 4 bits, [0] is not used
+
+// a point in affine coordinates, both values in Montgomery form
+struct DF_P224Point {
+  uint32_t x[DF_P224_WORDS];
+  uint32_t y[DF_P224_WORDS];
+};
+
+class DF_P224Verifier {
+
+public:
+
+  // publicKey: uncompressed point, false when it is not a point on the curve
+  bool DF_SetPublicKey(const uint8_t* publicKey);
+  // The message is taken as number without hashing (the UID for the originality signature),
+  // of a message longer than 28 bytes the first 28 bytes are used.
+  // signature: r || s, big endian
+  bool DF_Verify(const uint8_t* message, uint8_t messageLength, const uint8_t* signature);
+
+private:
+
+  bool isKeySet = false;
+  DF_P224Point keyTable[DF_P224_TABLE_SIZE];
+};
+
+#endif
@@ -0,0 +1,361 @@
+#include "ESP32_DESFire_Payload.h"
+
+/////////////////////////////////////////////////////////////////////////////////////
+//
+// Codec
+//
+/////////////////////////////////////////////////////////////////////////////////////
+
+byte DF_PayloadCodec::putVarint(byte* out, uint32_t value) {
+  byte length = 0;
+  while (value >= 0x80) {
+    out[length++] = (value & 0x7F) | 0x80;
+    value >>= 7;
+  }
+  out[length++] = value;
+  return length;
+}
+
+byte DF_PayloadCodec::getVarint(const byte* in, uint16_t available, uint32_t* value) {
+  uint32_t result = 0;
+  for (byte i = 0; i < 5 && i < available; i++) {
+    result |= (uint32_t)(in[i] & 0x7F) << (7 * i);
+    if ((in[i] & 0x80) == 0) {
+      *value = result;
+      return i + 1;
+    }
+  }
+  return 0;
+}
+
+// Runs of 3 or more equal bytes are stored as (control, byte), everything else as literals
+uint16_t DF_PayloadCodec::encodeRle(const byte* data, uint16_t length, byte* out, uint16_t maxLength) {
+  uint16_t in = 0;
+  uint16_t outLength = 0;
+  while (in < length) {
+    uint16_t run = 1;
+    while (in + run < length && data[in + run] == data[in] && run < 130)
+      run++;
+    if (run >= 3) {
+      if (outLength + 2 > maxLength)
+        return 0;
+      out[outLength++] = 0x80 + (run - 3);
+      out[outLength++] = data[in];
+      in += run;
+      continue;
+    }
+    // collect literals up to the next run of 3
+    uint16_t literals = 0;
+    while (in + literals < length && literals < 128) {
+      if (in + literals + 2 < length && data[in + literals] == data[in + literals + 1] && data[in + literals] == data[in + literals + 2])
+        break;
+      literals++;
+    }
+    if (outLength + 1 + literals > maxLength)
+      return 0;
+    out[outLength++] = literals - 1;
+    memcpy(&out[outLength], &data[in], literals);
+    outLength += literals;
+    in += literals;
+  }
+  return outLength;
+}
+
+bool DF_PayloadCodec::decodeRle(const byte* in, uint16_t inLength, byte* out, uint16_t outLength) {
+  uint16_t inPos = 0;
+  uint16_t outPos = 0;
+  while (inPos < inLength) {
+    byte control = in[inPos++];
+    if (control >= 0x80) {
+      uint16_t run = control - 0x80 + 3;
+      if (inPos >= inLength || outPos + run > outLength)
+        return false;
+      memset(&out[outPos], in[inPos++], run);
+      outPos += run;
+    } else {
+      uint16_t literals = control + 1;
+      if (inPos + literals > inLength || outPos + literals > outLength)
+        return false;
+      memcpy(&out[outPos], &in[inPos], literals);
+      inPos += literals;
+      outPos += literals;
+    }
+  }
+  return (outPos == outLength);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+//
+// Writer
+//
+/////////////////////////////////////////////////////////////////////////////////////
+
+DF_PayloadWriter::DF_PayloadWriter(byte* buffer, uint16_t bufferSize) {
+  buf = buffer;
+  bufSize = bufferSize;
+}
+
+bool DF_PayloadWriter::DF_AddField(byte tag, DF_PayloadType type, uint16_t length) {
+  fieldTagTypes[fieldCount] = (type << 5) | tag;
+  fieldLengths[fieldCount] = length;
+  fieldCount++;
+  dataLength += length;
+  return true;
+}
+
+bool DF_PayloadWriter::DF_PutUnsigned(byte tag, uint32_t value) {
+  if (tag > DF_PAYLOAD_MAX_TAG || fieldCount >= DF_PAYLOAD_MAX_FIELDS || dataLength + 5 > bufSize) {
+    isValid = false;
+    return false;
+  }
+  return DF_AddField(tag, DF_PAYLOAD_UNSIGNED, DF_PayloadCodec::putVarint(&buf[dataLength], value));
+}
+
+bool DF_PayloadWriter::DF_PutSigned(byte tag, int32_t value) {
+  if (tag > DF_PAYLOAD_MAX_TAG || fieldCount >= DF_PAYLOAD_MAX_FIELDS || dataLength + 5 > bufSize) {
+    isValid = false;
+    return false;
+  }
+  uint32_t zigzag = ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+  return DF_AddField(tag, DF_PAYLOAD_SIGNED, DF_PayloadCodec::putVarint(&buf[dataLength], zigzag));
+}
+
+bool DF_PayloadWriter::DF_PutBytes(byte tag, const byte* data, uint16_t length, bool compress) {
+  if (tag > DF_PAYLOAD_MAX_TAG || fieldCount >= DF_PAYLOAD_MAX_FIELDS) {
+    isValid = false;
+    return false;
+  }
+  if (compress && dataLength + 3 < bufSize) {
+    // the compressed field has to be shorter than the plain one, otherwise it is not used
+    uint16_t maxLength = (bufSize - dataLength < length) ? bufSize - dataLength : length;
+    byte lengthSize = DF_PayloadCodec::putVarint(&buf[dataLength], length);
+    if (lengthSize < maxLength) {
+      uint16_t encoded = DF_PayloadCodec::encodeRle(data, length, &buf[dataLength + lengthSize], maxLength - lengthSize - 1);
+      if (encoded > 0)
+        return DF_AddField(tag, DF_PAYLOAD_BYTES_RLE, lengthSize + encoded);
+    }
+  }
+  if (dataLength + length > bufSize) {
+    isValid = false;
+    return false;
+  }
+  memcpy(&buf[dataLength], data, length);
+  return DF_AddField(tag, DF_PAYLOAD_BYTES, length);
+}
+
+bool DF_PayloadWriter::DF_PutString(byte tag, const char* text) {
+  return DF_PutBytes(tag, (const byte*)text, strlen(text), false);
+}
+
+uint16_t DF_PayloadWriter::DF_Finish() {
+  if (!isValid)
+    return 0;
+
+  byte header[DF_PAYLOAD_MAX_HEADER_SIZE];
+  uint16_t headerLength = 0;
+  header[headerLength++] = DF_PAYLOAD_VERSION;
+  header[headerLength++] = fieldCount;
+  for (byte i = 0; i < fieldCount; i++) {
+    header[headerLength++] = fieldTagTypes[i];
+    headerLength += DF_PayloadCodec::putVarint(&header[headerLength], fieldLengths[i]);
+  }
+  if (headerLength + dataLength > bufSize)
+    return 0;
+
+  memmove(&buf[headerLength], buf, dataLength);
+  memcpy(buf, header, headerLength);
+  return headerLength + dataLength;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+//
+// Reader
+//
+/////////////////////////////////////////////////////////////////////////////////////
+
+bool DF_PayloadReader::DF_ParseHeader(const byte* data, uint16_t length) {
+  fieldCount = 0;
+  headerLength = 0;
+  recordLength = 0;
+  if (length < 2 || data[0] != DF_PAYLOAD_VERSION || data[1] > DF_PAYLOAD_MAX_FIELDS)
+    return false;
+
+  byte count = data[1];
+  uint16_t position = 2;
+  uint32_t fieldLength;
+  uint32_t offset = 0;
+  for (byte i = 0; i < count; i++) {
+    if (position >= length)
+      return false;
+    fieldTagTypes[i] = data[position++];
+    byte used = DF_PayloadCodec::getVarint(&data[position], length - position, &fieldLength);
+    if (used == 0 || fieldLength > 0xFFFF)
+      return false;
+    position += used;
+    fieldOffsets[i] = offset;  // relative to the end of the header for now
+    fieldLengths[i] = fieldLength;
+    offset += fieldLength;
+  }
+  if (position + offset > 0xFFFF)
+    return false;
+
+  for (byte i = 0; i < count; i++)
+    fieldOffsets[i] += position;
+  fieldCount = count;
+  headerLength = position;
+  recordLength = position + offset;
+  return true;
+}
+
+uint16_t DF_PayloadReader::DF_GetHeaderLength() {
+  return headerLength;
+}
+
+uint16_t DF_PayloadReader::DF_GetRecordLength() {
+  return recordLength;
+}
+
+byte DF_PayloadReader::DF_GetFieldCount() {
+  return fieldCount;
+}
+
+bool DF_PayloadReader::DF_FindField(byte tag, uint16_t* offset, uint16_t* length, DF_PayloadType* type) {
+  for (byte i = 0; i < fieldCount; i++) {
+    if ((fieldTagTypes[i] & DF_PAYLOAD_MAX_TAG) == tag) {
+      *offset = fieldOffsets[i];
+      *length = fieldLengths[i];
+      *type = (DF_PayloadType)(fieldTagTypes[i] >> 5);
+      return true;
+    }
+  }
+  return false;
+}
+
+bool DF_PayloadReader::DF_GetUnsigned(const byte* record, byte tag, uint32_t* value) {
+  uint16_t offset, length;
+  DF_PayloadType type;
+  // a field without bytes is not a number (getVarint returns 0 for it)
+  if (!DF_FindField(tag, &offset, &length, &type) || type != DF_PAYLOAD_UNSIGNED || length == 0)
+    return false;
+  return DF_PayloadCodec::getVarint(&record[offset], length, value) == length;
+}
+
+bool DF_PayloadReader::DF_GetSigned(const byte* record, byte tag, int32_t* value) {
+  uint16_t offset, length;
+  DF_PayloadType type;
+  uint32_t zigzag;
+  if (!DF_FindField(tag, &offset, &length, &type) || type != DF_PAYLOAD_SIGNED || length == 0)
+    return false;
+  if (DF_PayloadCodec::getVarint(&record[offset], length, &zigzag) != length)
+    return false;
+  *value = (int32_t)((zigzag >> 1) ^ (~(zigzag & 1) + 1));
+  return true;
+}
+
+bool DF_PayloadReader::DF_GetBytes(const byte* record, byte tag, byte* backData, uint16_t* backLen) {
+  uint16_t offset, length;
+  DF_PayloadType type;
+  if (!DF_FindField(tag, &offset, &length, &type))
+    return false;
+
+  if (type == DF_PAYLOAD_BYTES) {
+    if (length > *backLen)
+      return false;
+    memcpy(backData, &record[offset], length);
+    *backLen = length;
+    return true;
+  }
+  if (type == DF_PAYLOAD_BYTES_RLE) {
+    uint32_t decodedLength;
+    byte used = DF_PayloadCodec::getVarint(&record[offset], length, &decodedLength);
+    if (used == 0 || decodedLength > *backLen)
+      return false;
+    if (!DF_PayloadCodec::decodeRle(&record[offset + used], length - used, backData, decodedLength))
+      return false;
+    *backLen = decodedLength;
+    return true;
+  }
+  return false;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+//
+// File access
+//
+/////////////////////////////////////////////////////////////////////////////////////
+
+ESP32_DESFire_Payload::ESP32_DESFire_Payload(ESP32_DESFire* desfire) {
+  desfireLib = desfire;
+}
+
+ESP32_DESFire::DF_StatusCode ESP32_DESFire_Payload::DF_WriteRecord(byte fileNo, const byte* record, uint16_t length) {
+  byte chunk[DF_PAYLOAD_WRITE_CHUNK];
+  for (uint16_t offset = 0; offset < length; offset += DF_PAYLOAD_WRITE_CHUNK) {
+    byte chunkLength = (length - offset > DF_PAYLOAD_WRITE_CHUNK) ? DF_PAYLOAD_WRITE_CHUNK : length - offset;
+    memcpy(chunk, &record[offset], chunkLength);
+    ESP32_DESFire::DF_StatusCode statusCode = desfireLib->DF_Plain_WriteData_Simple(fileNo, chunkLength, offset, chunk);
+    if (statusCode != ESP32_DESFire::DF_STATUS_OK)
+      return statusCode;
+  }
+  return ESP32_DESFire::DF_STATUS_OK;
+}
+
+// one ReadData, the frames of a longer range are collected by the library
+ESP32_DESFire::DF_StatusCode ESP32_DESFire_Payload::DF_ReadRange(byte fileNo, uint16_t offset, uint16_t length, byte* backData) {
+  // length 0 would read the complete file
+  if (length == 0)
+    return ESP32_DESFire::DF_STATUS_OK;
+  uint16_t readLength = length;
+  return desfireLib->DF_Plain_ReadData_native(fileNo, offset, length, backData, &readLength);
+}
+
+ESP32_DESFire::DF_StatusCode ESP32_DESFire_Payload::DF_ReadFields(byte fileNo, const byte* tags, byte tagCount, byte* recordBuffer, uint16_t bufferSize, DF_PayloadReader* reader) {
+  ESP32_DESFire::DF_StatusCode statusCode;
+
+  // the file size is looked up once per application, no read goes beyond the end of the file
+  uint32_t fileSize;
+  statusCode = desfireLib->DF_GetFileSize(fileNo, &fileSize);
+  if (statusCode != ESP32_DESFire::DF_STATUS_OK)
+    return statusCode;
+  uint16_t available = (fileSize < bufferSize) ? fileSize : bufferSize;
+
+  // one frame holds the header and usually the first fields, a small file is read completely
+  uint16_t readLength = (available < DF_PAYLOAD_READ_CHUNK) ? available : DF_PAYLOAD_READ_CHUNK;
+  statusCode = DF_ReadRange(fileNo, 0, readLength, recordBuffer);
+  if (statusCode != ESP32_DESFire::DF_STATUS_OK)
+    return statusCode;
+
+  if (!reader->DF_ParseHeader(recordBuffer, readLength)) {
+    // a directory with many fields is longer than one frame
+    uint16_t headerLength = (available < DF_PAYLOAD_MAX_HEADER_SIZE) ? available : DF_PAYLOAD_MAX_HEADER_SIZE;
+    if (headerLength <= readLength)
+      return ESP32_DESFire::DF_STATUS_INVALID;
+    statusCode = DF_ReadRange(fileNo, readLength, headerLength - readLength, &recordBuffer[readLength]);
+    if (statusCode != ESP32_DESFire::DF_STATUS_OK)
+      return statusCode;
+    readLength = headerLength;
+    if (!reader->DF_ParseHeader(recordBuffer, readLength))
+      return ESP32_DESFire::DF_STATUS_INVALID;
+  }
+
+  // the range from the first to the last requested field, a tag that is not in the record is skipped
+  uint16_t rangeStart = 0xFFFF;
+  uint16_t rangeEnd = 0;
+  for (byte i = 0; i < tagCount; i++) {
+    uint16_t offset, length;
+    DF_PayloadType type;
+    if (!reader->DF_FindField(tags[i], &offset, &length, &type))
+      continue;
+    if (offset < rangeStart)
+      rangeStart = offset;
+    if (offset + length > rangeEnd)
+      rangeEnd = offset + length;
+  }
+  if (rangeEnd <= readLength)
+    return ESP32_DESFire::DF_STATUS_OK;
+  if (rangeEnd > bufferSize)
+    return ESP32_DESFire::DF_STATUS_NO_ROOM;
+  if (rangeStart < readLength)
+    rangeStart = readLength;
+  return DF_ReadRange(fileNo, rangeStart, rangeEnd - rangeStart, &recordBuffer[rangeStart]);
+}
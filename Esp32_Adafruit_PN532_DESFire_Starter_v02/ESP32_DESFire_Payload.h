@@ -0,0 +1,139 @@
+/**
+ * Compact payload codec for standard data files of the ESP32_DESFire library.
+ *
+ * Every byte of a file crosses the RF link and uses EEPROM of the card, so a record (e.g. a
+ * badge record) is stored as a list of tagged fields with variable length numbers instead of
+ * a fixed layout. Byte fields can be compressed with a run length encoding, it is used only
+ * when the field gets shorter.
+ *
+ * Record layout:
+ *   version (1), field count (1)
+ *   directory, for each field: tag and type (1, tag in bits 0-4, type in bits 5-7),
+ *                              stored length of the field (varint)
+ *   field data in the order of the directory
+ * Field types:
+ *   DF_PAYLOAD_UNSIGNED: unsigned varint (7 bits per byte, LSB first, bit 7 = more bytes)
+ *   DF_PAYLOAD_SIGNED: zigzag encoded varint (0, -1, 1, -2, ... -> 0, 1, 2, 3, ...)
+ *   DF_PAYLOAD_BYTES: raw bytes (strings are stored without terminator)
+ *   DF_PAYLOAD_BYTES_RLE: decoded length (varint), followed by runs: a control byte below 0x80
+ *                         is followed by (control + 1) literal bytes, a control byte from 0x80
+ *                         repeats the next byte (control - 0x80 + 3) times
+ *
+ * The directory gives the position of every field, so a reader reads the header and then
+ * only the bytes of the fields it needs. Put the fields that are read on every tap first,
+ * the read stops behind the last requested field.
+ *
+ * Author: Michael Fehr (AndroidCrypto)
+*/
+
+#ifndef ESP32_DESFire_Payload_h
+#define ESP32_DESFire_Payload_h
+
+#include "Arduino.h"
+#include "ESP32_DESFire.h"
+
+#define DF_PAYLOAD_VERSION (0x01)
+#define DF_PAYLOAD_MAX_FIELDS (16)
+#define DF_PAYLOAD_MAX_TAG (0x1F)
+#define DF_PAYLOAD_MAX_HEADER_SIZE (2 + DF_PAYLOAD_MAX_FIELDS * 4)  // a field length needs up to 3 bytes
+#define DF_PAYLOAD_READ_CHUNK (59)   // response data of one card frame
+#define DF_PAYLOAD_WRITE_CHUNK (48)  // data that fits into one card frame with the WriteData header
+
+enum DF_PayloadType : byte {
+  DF_PAYLOAD_UNSIGNED = 0,
+  DF_PAYLOAD_SIGNED = 1,
+  DF_PAYLOAD_BYTES = 2,
+  DF_PAYLOAD_BYTES_RLE = 3
+};
+
+// Builds a record in a caller provided buffer, the fields are collected first and moved
+// behind the directory by DF_Finish
+class DF_PayloadWriter {
+
+public:
+
+  DF_PayloadWriter(byte* buffer, uint16_t bufferSize);
+
+  bool DF_PutUnsigned(byte tag, uint32_t value);
+  bool DF_PutSigned(byte tag, int32_t value);
+  // compress: the run length encoding is used when it makes the field shorter
+  bool DF_PutBytes(byte tag, const byte* data, uint16_t length, bool compress = false);
+  bool DF_PutString(byte tag, const char* text);
+  // returns the length of the record, 0 when the buffer was too small or a tag was invalid
+  uint16_t DF_Finish();
+
+private:
+
+  byte* buf;
+  uint16_t bufSize;
+  uint16_t dataLength = 0;
+  bool isValid = true;
+  byte fieldCount = 0;
+  byte fieldTagTypes[DF_PAYLOAD_MAX_FIELDS];
+  uint16_t fieldLengths[DF_PAYLOAD_MAX_FIELDS];
+
+  bool DF_AddField(byte tag, DF_PayloadType type, uint16_t length);
+};
+
+// Reads the directory of a record and decodes single fields
+class DF_PayloadReader {
+
+public:
+
+  // data: the first bytes of the record, at least the complete header
+  bool DF_ParseHeader(const byte* data, uint16_t length);
+  uint16_t DF_GetHeaderLength();
+  uint16_t DF_GetRecordLength();
+  byte DF_GetFieldCount();
+  // position of the field in the record, false when the record has no field with this tag
+  bool DF_FindField(byte tag, uint16_t* offset, uint16_t* length, DF_PayloadType* type);
+
+  // record: the record image, at least up to the end of the field
+  bool DF_GetUnsigned(const byte* record, byte tag, uint32_t* value);
+  bool DF_GetSigned(const byte* record, byte tag, int32_t* value);
+  // backLen: in = size of backData, out = decoded length
+  bool DF_GetBytes(const byte* record, byte tag, byte* backData, uint16_t* backLen);
+
+private:
+
+  uint16_t headerLength = 0;
+  uint16_t recordLength = 0;
+  byte fieldCount = 0;
+  byte fieldTagTypes[DF_PAYLOAD_MAX_FIELDS];
+  uint16_t fieldOffsets[DF_PAYLOAD_MAX_FIELDS];
+  uint16_t fieldLengths[DF_PAYLOAD_MAX_FIELDS];
+};
+
+// Variable length numbers and run length encoding, shared by writer and reader
+struct DF_PayloadCodec {
+  static byte putVarint(byte* out, uint32_t value);
+  // returns the number of bytes used, 0 when the varint is longer than available
+  static byte getVarint(const byte* in, uint16_t available, uint32_t* value);
+  // returns the encoded length, 0 when the encoding does not fit into maxLength
+  static uint16_t encodeRle(const byte* data, uint16_t length, byte* out, uint16_t maxLength);
+  static bool decodeRle(const byte* in, uint16_t inLength, byte* out, uint16_t outLength);
+};
+
+// Writes and reads records in the standard data files of the selected application
+class ESP32_DESFire_Payload {
+
+public:
+
+  ESP32_DESFire_Payload(ESP32_DESFire* desfire);
+
+  // the record is written in pieces that fit into one frame of the card
+  ESP32_DESFire::DF_StatusCode DF_WriteRecord(byte fileNo, const byte* record, uint16_t length);
+  // Reads the header (the first frame of the file) and then the range of the fields with the
+  // tags with one ReadData into recordBuffer (at their position in the record), the bytes
+  // behind the last requested field are not read. The reader can decode the requested fields
+  // from recordBuffer afterwards.
+  ESP32_DESFire::DF_StatusCode DF_ReadFields(byte fileNo, const byte* tags, byte tagCount, byte* recordBuffer, uint16_t bufferSize, DF_PayloadReader* reader);
+
+private:
+
+  ESP32_DESFire* desfireLib;
+
+  ESP32_DESFire::DF_StatusCode DF_ReadRange(byte fileNo, uint16_t offset, uint16_t length, byte* backData);
+};
+
+#endif
@@ -0,0 +1,172 @@
+#include "ESP32_DESFire_Presence.h"
+
+#ifdef DF_TRANSPORT_PN532
+
+ESP32_DESFire_Presence::ESP32_DESFire_Presence(ESP32_DESFire* desfire) {
+  desfireLib = desfire;
+}
+
+bool ESP32_DESFire_Presence::DF_Begin(byte passiveActivationRetries) {
+  activationRetries = passiveActivationRetries;
+  cardPresent = false;
+  poweredDown = false;
+  hasIdleAid = false;
+  return DF_ConfigureRetries();
+}
+
+bool ESP32_DESFire_Presence::DF_ConfigureRetries() {
+  byte cmd[5];
+  byte resp[4];
+  byte respLen = sizeof(resp);
+
+  cmd[0] = DF_PN532_COMMAND_RFCONFIGURATION;
+  cmd[1] = DF_PN532_RFCONFIG_MAX_RETRIES;
+  cmd[2] = 0xFF;               // MxRtyATR (default)
+  cmd[3] = 0x01;               // MxRtyPSL (default)
+  cmd[4] = activationRetries;  // MxRtyPassiveActivation
+  return desfireLib->DF_PN532Command(cmd, sizeof(cmd), resp, &respLen, 100);
+}
+
+ESP32_DESFire_Presence::DF_PresenceEvent ESP32_DESFire_Presence::DF_Poll() {
+  if (!cardPresent) {
+    if (lowPower.enabled && !DF_WakeIfDue())
+      return DF_EVENT_NONE;
+    bool isActivated = DF_ActivateCard();
+    // the wake sequence ends with the reselection of the application or the activation, found
+    // card or not; a card without the application is reported with no application selected
+    if (isActivated && isWaking && hasIdleAid)
+      desfireLib->DF_Plain_SelectApplication(idleAid);
+    if (isWaking) {
+      lastWakeMicros = micros() - wakeStartMicros;
+      isWaking = false;
+    }
+    if (!isActivated) {
+      if (lowPower.enabled)
+        DF_PowerDown();
+      return DF_EVENT_NONE;
+    }
+    cardPresent = true;
+    missedChecks = 0;
+    lastCheckMillis = millis();
+    return DF_EVENT_CARD_ARRIVED;
+  }
+
+  if (millis() - lastCheckMillis < presenceCheckIntervalMs)
+    return DF_EVENT_NONE;
+  lastCheckMillis = millis();
+
+  if (DF_CheckPresence()) {
+    missedChecks = 0;
+    return DF_EVENT_CARD_PRESENT;
+  }
+
+  missedChecks++;
+  if (missedChecks < missedChecksForRemoval)
+    return DF_EVENT_NONE;
+
+  // re-armed: the next poll starts the activation of a new card
+  cardPresent = false;
+  hasIdleAid = desfireLib->DF_GetSelectedApplication(idleAid);
+  desfireLib->DF_ResetSession();
+  return DF_EVENT_CARD_REMOVED;
+}
+
+bool ESP32_DESFire_Presence::DF_IsCardPresent() {
+  return cardPresent;
+}
+
+bool ESP32_DESFire_Presence::DF_GetUid(byte* uid, byte* uidLength) {
+  if (!cardPresent || *uidLength < uidBufferLength)
+    return false;
+  memcpy(uid, uidBuffer, uidBufferLength);
+  *uidLength = uidBufferLength;
+  return true;
+}
+
+void ESP32_DESFire_Presence::DF_SetLowPower(const DF_LowPowerConfig& config) {
+  lowPower = config;
+  if (lowPower.irqPin >= 0)
+    pinMode(lowPower.irqPin, INPUT_PULLUP);
+  // a PN532 in PowerDown is woken at once when the low power idle is switched off
+  if (!lowPower.enabled && poweredDown) {
+    lowPower.idlePollIntervalMs = 0;
+    DF_WakeIfDue();
+    lowPower = config;
+  }
+}
+
+bool ESP32_DESFire_Presence::DF_IsPoweredDown() {
+  return poweredDown;
+}
+
+uint32_t ESP32_DESFire_Presence::DF_GetLastWakeMicros() {
+  return lastWakeMicros;
+}
+
+uint32_t ESP32_DESFire_Presence::DF_GetWakeCount() {
+  return wakeCount;
+}
+
+bool ESP32_DESFire_Presence::DF_PowerDown() {
+  byte cmd[3];
+  byte resp[4];
+  byte respLen = sizeof(resp);
+
+  cmd[0] = PN532_COMMAND_POWERDOWN;
+  cmd[1] = lowPower.wakeUpSources;
+  cmd[2] = (lowPower.irqPin >= 0) ? 0x01 : 0x00;  // GenerateIRQ on a wake up
+  if (!desfireLib->DF_PN532Command(cmd, sizeof(cmd), resp, &respLen, 100))
+    return false;
+  // the status byte is 0x00 if the PN532 goes to PowerDown
+  if (respLen < 1 || resp[0] != 0x00)
+    return false;
+
+  poweredDown = true;
+  powerDownMillis = millis();
+  return true;
+}
+
+// The bus stays quiet until the poll interval has passed or the IRQ line signals a wake up
+bool ESP32_DESFire_Presence::DF_WakeIfDue() {
+  if (!poweredDown)
+    return true;
+  bool irqWakeUp = (lowPower.irqPin >= 0 && digitalRead(lowPower.irqPin) == LOW);
+  if (!irqWakeUp && millis() - powerDownMillis < lowPower.idlePollIntervalMs)
+    return false;
+
+  wakeStartMicros = micros();
+  desfireLib->DF_PN532Wakeup();
+  bool success = DF_ConfigureRetries();
+  // DF_Poll stops the clock after the activation of the card
+  isWaking = success;
+  if (!success)
+    lastWakeMicros = micros() - wakeStartMicros;
+  wakeCount++;
+  // a failed wake up is repeated after the next PowerDown
+  poweredDown = false;
+  return success;
+}
+
+bool ESP32_DESFire_Presence::DF_ActivateCard() {
+  byte uidLength = sizeof(uidBuffer);
+  if (!desfireLib->DF_ActivateCard(uidBuffer, &uidLength))
+    return false;
+  uidBufferLength = uidLength;
+  return true;
+}
+
+bool ESP32_DESFire_Presence::DF_CheckPresence() {
+  byte cmd[2];
+  byte resp[4];
+  byte respLen = sizeof(resp);
+
+  cmd[0] = DF_PN532_COMMAND_DIAGNOSE;
+  cmd[1] = DF_PN532_DIAGNOSE_PRESENCE_TEST;
+  if (!desfireLib->DF_PN532Command(cmd, sizeof(cmd), resp, &respLen, 100))
+    return false;
+
+  // the status byte is 0x00 if the card answered
+  return (respLen >= 1 && resp[0] == 0x00);
+}
+
+#endif  // DF_TRANSPORT_PN532
@@ -0,0 +1,124 @@
+/**
+ * Card presence engine for the ESP32_DESFire library.
+ *
+ * Instead of blocking in InListPassiveTarget with endless retries and sleeping a fixed
+ * time after each card, the engine is polled from loop() and returns an event:
+ * - DF_EVENT_CARD_ARRIVED: a new card was activated, the session is ready for commands
+ * - DF_EVENT_CARD_PRESENT: the card is still in the field
+ * - DF_EVENT_CARD_REMOVED: the card has left the field, the next poll looks for a new card
+ * - DF_EVENT_NONE: no card in the field (or the next presence check is not yet due)
+ *
+ * The activation is bounded by a small passive activation retry count. The presence of an
+ * activated card is checked with the PN532 Diagnose command (NumTst 0x06, card presence
+ * detection for ISO/IEC 14443-4 cards), a cheap exchange that does not change the card state.
+ *
+ * Low power idle (DF_SetLowPower): while no card is in the field the PN532 is put into
+ * PowerDown after each unsuccessful activation, the RF field is off. The next activation is
+ * due after idlePollIntervalMs (low duty cycle polling) or earlier, when the PN532 pulls its
+ * IRQ line on a wake up by the RF level detector (an external field, e.g. a phone) or by
+ * INT0/INT1. A passive card can not wake the PN532, it is found by the next poll. The wake
+ * sequence is host wake up with SAMConfiguration, RFConfiguration with the passive activation
+ * retries, the activation of the card and, when an application was selected on the card that
+ * left before the PowerDown, the selection of that application on the new card. The session of
+ * a card is reset on its removal, the reselection brings the selected application back (if the
+ * new card has it). The duration of the wake sequence up to this first exchange with the card
+ * is measured (DF_GetLastWakeMicros).
+ *
+ * Author: Michael Fehr (AndroidCrypto)
+*/
+
+#ifndef ESP32_DESFire_Presence_h
+#define ESP32_DESFire_Presence_h
+
+#include "Arduino.h"
+#include "ESP32_DESFire.h"
+
+// raw PN532 commands are used, see ESP32_DESFire_Transport
+#ifdef DF_TRANSPORT_PN532
+
+#define DF_PN532_COMMAND_DIAGNOSE (0x00)
+#define DF_PN532_DIAGNOSE_PRESENCE_TEST (0x06)
+#define DF_PN532_COMMAND_RFCONFIGURATION (0x32)
+#define DF_PN532_RFCONFIG_MAX_RETRIES (0x05)
+
+// WakeUpEnable of the PN532 PowerDown command
+#define DF_PN532_WAKEUP_INT0 (0x01)
+#define DF_PN532_WAKEUP_INT1 (0x02)
+#define DF_PN532_WAKEUP_RF (0x08)  // RF level detector
+#define DF_PN532_WAKEUP_HSU (0x10)
+#define DF_PN532_WAKEUP_SPI (0x20)
+#define DF_PN532_WAKEUP_GPIO (0x40)
+#define DF_PN532_WAKEUP_I2C (0x80)
+
+class ESP32_DESFire_Presence {
+
+public:
+
+  enum DF_PresenceEvent : byte {
+    DF_EVENT_NONE = 0,
+    DF_EVENT_CARD_ARRIVED = 1,
+    DF_EVENT_CARD_PRESENT = 2,
+    DF_EVENT_CARD_REMOVED = 3
+  };
+
+  static const byte MAX_UID_LENGTH = 10;
+
+  struct DF_LowPowerConfig {
+    bool enabled = false;
+    uint16_t idlePollIntervalMs = 200;                               // PowerDown time between two polls
+    byte wakeUpSources = DF_PN532_WAKEUP_SPI | DF_PN532_WAKEUP_RF;  // the host interface has to be included
+    int8_t irqPin = -1;                                              // IRQ of the PN532 for an early wake up
+  };
+
+  ESP32_DESFire_Presence(ESP32_DESFire* desfire);
+
+  // passiveActivationRetries: 0x00 = one try, 0xFF = endless (the old blocking behaviour)
+  bool DF_Begin(byte passiveActivationRetries = 0x01);
+  DF_PresenceEvent DF_Poll();
+
+  bool DF_IsCardPresent();
+  bool DF_GetUid(byte* uid, byte* uidLength);
+
+  void DF_SetLowPower(const DF_LowPowerConfig& config);
+  bool DF_IsPoweredDown();
+  // duration of the last wake sequence, from the host wake up to the first exchange with the
+  // card (the reselection of the application, or the activation when there is none)
+  uint32_t DF_GetLastWakeMicros();
+  uint32_t DF_GetWakeCount();
+
+  // minimum time between two presence checks while a card is in the field
+  uint16_t presenceCheckIntervalMs = 50;
+  // number of failed presence checks in a row before the card is reported as removed
+  byte missedChecksForRemoval = 2;
+
+private:
+
+  ESP32_DESFire* desfireLib;
+  bool cardPresent = false;
+  byte missedChecks = 0;
+  unsigned long lastCheckMillis = 0;
+  byte uidBuffer[MAX_UID_LENGTH];
+  byte uidBufferLength = 0;
+
+  byte activationRetries = 0x01;
+  DF_LowPowerConfig lowPower;
+  bool poweredDown = false;
+  unsigned long powerDownMillis = 0;
+  uint32_t lastWakeMicros = 0;
+  unsigned long wakeStartMicros = 0;
+  bool isWaking = false;
+  uint32_t wakeCount = 0;
+  // the application selected when the last card left, selected again by the wake sequence
+  byte idleAid[3];
+  bool hasIdleAid = false;
+
+  bool DF_ConfigureRetries();
+  bool DF_ActivateCard();
+  bool DF_CheckPresence();
+  bool DF_PowerDown();
+  bool DF_WakeIfDue();
+};
+
+#endif  // DF_TRANSPORT_PN532
+
+#endif
@@ -0,0 +1,110 @@
+#include "ESP32_DESFire_Readers.h"
+
+#ifdef DF_TRANSPORT_PN532
+
+#ifdef ESP_PLATFORM
+#include "esp_pthread.h"
+#endif
+
+ESP32_DESFire_Readers::~ESP32_DESFire_Readers() {
+  DF_Stop();
+  for (byte i = 0; i < readerCount; i++) {
+    delete lanes[i].session;
+  }
+}
+
+// The sessions are allocated once during setup and live as long as the manager
+int8_t ESP32_DESFire_Readers::DF_AddReader(Adafruit_PN532* nfc, byte busIndex, int8_t irqPin) {
+  if (readerCount >= DF_MAX_READERS || busIndex >= DF_MAX_BUSES || running)
+    return -1;
+
+  DF_ReaderLane& newLane = lanes[readerCount];
+  newLane.nfc = nfc;
+  newLane.session = new ESP32_DESFire(nfc);
+  newLane.session->COMM_DEBUG_PRINT = false;  // the output of several threads would be mixed
+  newLane.session->DF_SetBusScheduler(&buses[busIndex], irqPin);
+  newLane.busIndex = busIndex;
+  newLane.irqPin = irqPin;
+  return readerCount++;
+}
+
+byte ESP32_DESFire_Readers::DF_BeginReaders(byte passiveActivationRetries) {
+  byte found = 0;
+  for (byte i = 0; i < readerCount; i++) {
+    DF_BusScheduler& bus = buses[lanes[i].busIndex];
+    bus.DF_Acquire();
+    lanes[i].nfc->begin();
+    uint32_t versiondata = lanes[i].nfc->getFirmwareVersion();
+    if (versiondata) {
+      lanes[i].nfc->setPassiveActivationRetries(passiveActivationRetries);
+      found++;
+    } else {
+      Serial.printf("Reader %d: didn't find PN53x board\n", i);
+    }
+    bus.DF_Release();
+  }
+  return found;
+}
+
+bool ESP32_DESFire_Readers::DF_ActivateCard(byte readerIndex, byte* uid, byte* uidLength) {
+  if (readerIndex >= readerCount)
+    return false;
+  return lanes[readerIndex].session->DF_ActivateCard(uid, uidLength);
+}
+
+bool ESP32_DESFire_Readers::DF_Start(DF_LaneFunction laneFunction) {
+  if (running || laneFunction == NULL)
+    return false;
+
+#ifdef ESP_PLATFORM
+  esp_pthread_cfg_t cfg = esp_pthread_get_default_config();
+  cfg.stack_size = DF_READER_TASK_STACK_SIZE;
+  cfg.thread_name = "df_reader";
+  esp_pthread_set_cfg(&cfg);
+#endif
+
+  lane = laneFunction;
+  running = true;
+  for (byte i = 0; i < readerCount; i++) {
+    lanes[i].worker = std::thread(&ESP32_DESFire_Readers::DF_RunLane, this, i);
+  }
+  return true;
+}
+
+void ESP32_DESFire_Readers::DF_Stop() {
+  running = false;
+  for (byte i = 0; i < readerCount; i++) {
+    if (lanes[i].worker.joinable())
+      lanes[i].worker.join();
+  }
+}
+
+void ESP32_DESFire_Readers::DF_RunLane(byte readerIndex) {
+  while (running) {
+    lane(readerIndex, *lanes[readerIndex].session);
+  }
+}
+
+byte ESP32_DESFire_Readers::DF_GetReaderCount() {
+  return readerCount;
+}
+
+ESP32_DESFire* ESP32_DESFire_Readers::DF_Session(byte readerIndex) {
+  if (readerIndex >= readerCount)
+    return NULL;
+  return lanes[readerIndex].session;
+}
+
+Adafruit_PN532* ESP32_DESFire_Readers::DF_GetReader(byte readerIndex) {
+  if (readerIndex >= readerCount)
+    return NULL;
+  return lanes[readerIndex].nfc;
+}
+
+DF_BusScheduler& ESP32_DESFire_Readers::DF_GetBus(byte busIndex) {
+  if (busIndex >= DF_MAX_BUSES)
+    busIndex = 0;
+  return buses[busIndex];
+}
+
+#endif  // DF_TRANSPORT_PN532
@@ -0,0 +1,85 @@
+/**
+ * Multi reader manager for the ESP32_DESFire library.
+ *
+ * Several PN532 readers are connected to one ESP32, each with its own chip select (and
+ * optionally IRQ) pin on one or more SPI buses. Every reader gets its own ESP32_DESFire
+ * session and runs its workflow in its own thread. All readers on the same bus share one
+ * DF_BusScheduler, so their exchanges are interleaved fairly: while one PN532 waits for
+ * its card, the next reader can use the bus.
+ *
+ * Usage:
+ *   Adafruit_PN532 nfc1(CS1, &SPI), nfc2(CS2, &SPI);
+ *   ESP32_DESFire_Readers readers;
+ *   readers.DF_AddReader(&nfc1, 0, IRQ1);
+ *   readers.DF_AddReader(&nfc2, 0, IRQ2);
+ *   readers.DF_BeginReaders();
+ *   readers.DF_Start(laneFunction);  // laneFunction is called in a loop for each reader
+ *
+ * Author: Michael Fehr (AndroidCrypto)
+*/
+
+#ifndef ESP32_DESFire_Readers_h
+#define ESP32_DESFire_Readers_h
+
+#include "Arduino.h"
+#include "ESP32_DESFire.h"
+#include "ESP32_DESFire_BusScheduler.h"
+#include <thread>
+#include <atomic>
+
+// raw PN532 commands are used, see ESP32_DESFire_Transport
+#ifdef DF_TRANSPORT_PN532
+#include "Adafruit_PN532.h"
+
+#define DF_MAX_READERS (8)
+#define DF_MAX_BUSES (2)
+#define DF_READER_TASK_STACK_SIZE (8192)
+
+class ESP32_DESFire_Readers {
+
+public:
+
+  // called in a loop in the thread of each reader
+  typedef void (*DF_LaneFunction)(byte readerIndex, ESP32_DESFire& desfire);
+
+  ~ESP32_DESFire_Readers();
+
+  // returns the reader index or -1 if no more readers can be added
+  int8_t DF_AddReader(Adafruit_PN532* nfc, byte busIndex, int8_t irqPin = -1);
+  // begin, firmware check and a short passive activation retry count for all readers,
+  // returns the number of readers that responded
+  byte DF_BeginReaders(byte passiveActivationRetries = 0x02);
+  // activates one card on the reader, the session is reset on success
+  bool DF_ActivateCard(byte readerIndex, byte* uid, byte* uidLength);
+
+  bool DF_Start(DF_LaneFunction laneFunction);
+  void DF_Stop();
+
+  byte DF_GetReaderCount();
+  // the session of the reader or NULL if there is no reader with this index
+  ESP32_DESFire* DF_Session(byte readerIndex);
+  Adafruit_PN532* DF_GetReader(byte readerIndex);
+  DF_BusScheduler& DF_GetBus(byte busIndex);
+
+private:
+
+  struct DF_ReaderLane {
+    Adafruit_PN532* nfc;
+    ESP32_DESFire* session;
+    byte busIndex;
+    int8_t irqPin;
+    std::thread worker;
+  };
+
+  DF_ReaderLane lanes[DF_MAX_READERS];
+  DF_BusScheduler buses[DF_MAX_BUSES];
+  byte readerCount = 0;
+  std::atomic<bool> running{ false };
+  DF_LaneFunction lane = NULL;
+
+  void DF_RunLane(byte readerIndex);
+};
+
+#endif  // DF_TRANSPORT_PN532
+
+#endif
@@ -0,0 +1,107 @@
+#include "ESP32_DESFire_Targets.h"
+
+#ifdef DF_TRANSPORT_PN532
+
+ESP32_DESFire_Targets::ESP32_DESFire_Targets(Adafruit_PN532* nfc)
+  : sessions{ ESP32_DESFire(nfc, 1), ESP32_DESFire(nfc, 2) } {
+  nfcLib = nfc;
+  // a reactivation lists only one card and would drop the other target
+  for (byte i = 0; i < MAX_TARGETS; i++) {
+    ESP32_DESFire::DF_RecoveryPolicy policy = sessions[i].DF_GetRecoveryPolicy();
+    policy.reactivateOnRfLoss = false;
+    sessions[i].DF_SetRecoveryPolicy(policy);
+  }
+}
+
+byte ESP32_DESFire_Targets::DF_ListPassiveTargets(byte maxTargets) {
+  byte cmd[3];
+  byte resp[64];
+  byte respLen = sizeof(resp);
+
+  if (maxTargets > MAX_TARGETS)
+    maxTargets = MAX_TARGETS;
+
+  for (byte i = 0; i < MAX_TARGETS; i++) {
+    sessions[i].DF_ResetSession();
+  }
+  targetCount = 0;
+
+  cmd[0] = DF_PN532_COMMAND_INLISTPASSIVETARGET;
+  cmd[1] = maxTargets;                    // MaxTg
+  cmd[2] = DF_PN532_BRTY_106KBPS_TYPE_A;  // BrTy
+  if (!sessions[0].DF_PN532Command(cmd, sizeof(cmd), resp, &respLen, 1000))
+    return 0;
+
+  // response: NbTg, then for each target (106 kbps type A):
+  // Tg, SENS_RES (2), SEL_RES (1), NFCIDLength (1), NFCID1 (n), [ATS (ATS[0] bytes)]
+  if (respLen < 1)
+    return 0;
+  byte nbTg = resp[0];
+  byte pos = 1;
+  for (byte i = 0; i < nbTg && i < maxTargets; i++) {
+    if (pos + 5 > respLen)
+      break;
+    byte tg = resp[pos];
+    byte sak = resp[pos + 3];
+    byte uidLen = resp[pos + 4];
+    pos += 5;
+    if (uidLen > MAX_UID_LENGTH || pos + uidLen > respLen)
+      break;
+    memcpy(uids[targetCount], &resp[pos], uidLen);
+    uidLengths[targetCount] = uidLen;
+    saks[targetCount] = sak;
+    pos += uidLen;
+    // the PN532 sends RATS on its own for ISO 14443-4 cards, the ATS length includes the length byte
+    if ((sak & 0x20) && pos < respLen)
+      pos += resp[pos];
+    sessions[targetCount].DF_StartSession(tg, uids[targetCount], uidLen);
+    targetCount++;
+  }
+  return targetCount;
+}
+
+bool ESP32_DESFire_Targets::DF_ReleaseTargets() {
+  byte cmd[2];
+  byte resp[4];
+  byte respLen = sizeof(resp);
+
+  cmd[0] = DF_PN532_COMMAND_INRELEASE;
+  cmd[1] = 0x00;  // all targets
+  targetCount = 0;
+  for (byte i = 0; i < MAX_TARGETS; i++) {
+    sessions[i].DF_ResetSession();
+  }
+  if (!sessions[0].DF_PN532Command(cmd, sizeof(cmd), resp, &respLen, 1000))
+    return false;
+  return (respLen >= 1 && (resp[0] & 0x3F) == 0);
+}
+
+byte ESP32_DESFire_Targets::DF_GetTargetCount() {
+  return targetCount;
+}
+
+ESP32_DESFire* ESP32_DESFire_Targets::DF_Session(byte index) {
+  if (index >= targetCount)
+    return NULL;
+  return &sessions[index];
+}
+
+byte* ESP32_DESFire_Targets::DF_GetUid(byte index) {
+  if (index >= targetCount)
+    return NULL;
+  return uids[index];
+}
+
+byte ESP32_DESFire_Targets::DF_GetUidLength(byte index) {
+  if (index >= targetCount)
+    return 0;
+  return uidLengths[index];
+}
+
+bool ESP32_DESFire_Targets::DF_IsIsoDep(byte index) {
+  if (index >= targetCount)
+    return false;
+  return (saks[index] & 0x20) != 0;
+}
+
+#endif  // DF_TRANSPORT_PN532
@@ -0,0 +1,66 @@
+/**
+ * Multi card handling for the ESP32_DESFire library.
+ *
+ * The PN532 is able to activate up to two ISO14443A targets at once (InListPassiveTarget
+ * with MaxTg = 2). Each activated card gets its own ESP32_DESFire session, addressed by the
+ * logical target number (Tg) the PN532 assigned to it. The sessions can be used alternately,
+ * e.g. read from the first card and write to the second one, without activating the cards again.
+ *
+ * This requires the 'sendCommandReadResponse' method of the modified Adafruit_PN532 library.
+ * The PN532 commands are sent by the first session, so a bus scheduler set on that
+ * session is used for the activation as well.
+ *
+ * Author: Michael Fehr (AndroidCrypto)
+*/
+
+#ifndef ESP32_DESFire_Targets_h
+#define ESP32_DESFire_Targets_h
+
+#include "Arduino.h"
+#include "ESP32_DESFire.h"
+
+// raw PN532 commands are used, see ESP32_DESFire_Transport
+#ifdef DF_TRANSPORT_PN532
+#include "Adafruit_PN532.h"
+
+#define DF_PN532_COMMAND_INLISTPASSIVETARGET (0x4A)
+#define DF_PN532_COMMAND_INRELEASE (0x52)
+#define DF_PN532_BRTY_106KBPS_TYPE_A (0x00)
+
+class ESP32_DESFire_Targets {
+
+public:
+
+  static const byte MAX_TARGETS = 2;  // the PN532 is limited to two targets
+  static const byte MAX_UID_LENGTH = 10;
+
+  ESP32_DESFire_Targets(Adafruit_PN532* nfc);
+
+  // Activates up to maxTargets cards in the field and returns the number of activated cards.
+  // The sessions of all targets are reset, so call this only when the cards have changed.
+  byte DF_ListPassiveTargets(byte maxTargets = MAX_TARGETS);
+  // Releases all targets, the cards are put into HALT state by the PN532
+  bool DF_ReleaseTargets();
+
+  byte DF_GetTargetCount();
+  // index is 0 based, the PN532 target number is index + 1; the session of the target or NULL
+  // if there is no listed target with this index
+  ESP32_DESFire* DF_Session(byte index);
+  byte* DF_GetUid(byte index);
+  byte DF_GetUidLength(byte index);
+  // true if the card announces ISO 14443-4 support (SAK bit 6), DESFire cards always do
+  bool DF_IsIsoDep(byte index);
+
+private:
+
+  Adafruit_PN532* nfcLib;
+  ESP32_DESFire sessions[MAX_TARGETS];
+  byte targetCount = 0;
+  byte uids[MAX_TARGETS][MAX_UID_LENGTH];
+  byte uidLengths[MAX_TARGETS];
+  byte saks[MAX_TARGETS];
+};
+
+#endif  // DF_TRANSPORT_PN532
+
+#endif
@@ -0,0 +1,159 @@
+#include "ESP32_DESFire_Trace.h"
+
+/////////////////////////////////////////////////////////////////////////////////////
+//
+// Trace memory
+//
+/////////////////////////////////////////////////////////////////////////////////////
+
+DF_TraceMemory::DF_TraceMemory(byte* buffer, size_t bufferSize) {
+  memory = buffer;
+  memorySize = bufferSize;
+}
+
+size_t DF_TraceMemory::write(uint8_t data) {
+  return write(&data, 1);
+}
+
+// a record that does not fit is dropped completely, the trace stays readable
+size_t DF_TraceMemory::write(const uint8_t* data, size_t size) {
+  if (overflow || length + size > memorySize) {
+    overflow = true;
+    return 0;
+  }
+  memcpy(&memory[length], data, size);
+  length += size;
+  return size;
+}
+
+const byte* DF_TraceMemory::DF_GetData() {
+  return memory;
+}
+
+size_t DF_TraceMemory::DF_GetLength() {
+  return length;
+}
+
+bool DF_TraceMemory::DF_IsOverflow() {
+  return overflow;
+}
+
+void DF_TraceMemory::DF_Clear() {
+  length = 0;
+  overflow = false;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+//
+// Trace recorder
+//
+/////////////////////////////////////////////////////////////////////////////////////
+
+DF_TraceRecorder::DF_TraceRecorder(Print* sink) {
+  out = sink;
+}
+
+void DF_TraceRecorder::DF_Begin() {
+  byte header[DF_TRACE_HEADER_SIZE] = { 'D', 'F', 'T', 'R', DF_TRACE_VERSION, 0x00, 0x00, 0x00 };
+  out->write(header, sizeof(header));
+  beginMicros = micros();
+  recordCount = 0;
+}
+
+void DF_TraceRecorder::DF_Record(byte targetNumber, byte* sendData, byte sendLen, byte* backData, byte backLen, byte status, unsigned long startMicros, unsigned long durationMicros) {
+  // the record is assembled in one piece, so a memory sink takes it completely or not at all
+  byte record[DF_TRACE_MAX_RECORD_SIZE];
+  uint32_t start = startMicros - beginMicros;
+  uint32_t duration = durationMicros;
+
+  record[0] = DF_TRACE_RECORD_EXCHANGE;
+  record[1] = targetNumber;
+  record[2] = status;
+  record[3] = sendLen;
+  record[4] = backLen;
+  for (byte i = 0; i < 4; i++) {
+    record[5 + i] = (start >> (8 * i)) & 0xff;
+    record[9 + i] = (duration >> (8 * i)) & 0xff;
+  }
+  memcpy(&record[DF_TRACE_RECORD_HEADER_SIZE], sendData, sendLen);
+  memcpy(&record[DF_TRACE_RECORD_HEADER_SIZE + sendLen], backData, backLen);
+  if (out->write(record, DF_TRACE_RECORD_HEADER_SIZE + sendLen + backLen) > 0)
+    recordCount++;
+}
+
+uint32_t DF_TraceRecorder::DF_GetRecordCount() {
+  return recordCount;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+//
+// Trace replay
+//
+/////////////////////////////////////////////////////////////////////////////////////
+
+DF_TraceReplay::DF_TraceReplay(const byte* trace, size_t traceLength, DF_ReplayMode mode) {
+  data = trace;
+  dataLength = traceLength;
+  replayMode = mode;
+  DF_Rewind();
+}
+
+bool DF_TraceReplay::DF_IsValid() {
+  return (dataLength >= DF_TRACE_HEADER_SIZE && memcmp(data, "DFTR", 4) == 0 && data[4] == DF_TRACE_VERSION);
+}
+
+void DF_TraceReplay::DF_SetStrict(bool strict) {
+  isStrict = strict;
+}
+
+void DF_TraceReplay::DF_Rewind() {
+  position = DF_TRACE_HEADER_SIZE;
+  replayedCount = 0;
+  mismatchCount = 0;
+}
+
+bool DF_TraceReplay::DF_Exchange(byte targetNumber, byte* sendData, byte sendLen, byte* backData, byte* backLen) {
+  if (!DF_IsValid() || DF_IsFinished())
+    return false;
+
+  const byte* record = &data[position];
+  byte recSendLen = record[3];
+  byte recBackLen = record[4];
+  size_t recordLength = DF_TRACE_RECORD_HEADER_SIZE + recSendLen + recBackLen;
+  if (record[0] != DF_TRACE_RECORD_EXCHANGE || position + recordLength > dataLength)
+    return false;
+  position += recordLength;
+  replayedCount++;
+
+  const byte* recSendData = &record[DF_TRACE_RECORD_HEADER_SIZE];
+  if (recSendLen != sendLen || memcmp(recSendData, sendData, sendLen) != 0) {
+    mismatchCount++;
+    if (isStrict)
+      return false;
+  }
+
+  if (replayMode == DF_REPLAY_EXACT_TIMING) {
+    uint32_t duration = (uint32_t)record[9] | ((uint32_t)record[10] << 8) | ((uint32_t)record[11] << 16) | ((uint32_t)record[12] << 24);
+    delayMicroseconds(duration);
+  }
+
+  if (record[2] != ESP32_DESFire::DF_STATUS_OK)
+    return false;
+  if (recBackLen > *backLen)
+    return false;
+  memcpy(backData, &recSendData[recSendLen], recBackLen);
+  *backLen = recBackLen;
+  return true;
+}
+
+uint32_t DF_TraceReplay::DF_GetReplayedCount() {
+  return replayedCount;
+}
+
+uint32_t DF_TraceReplay::DF_GetMismatchCount() {
+  return mismatchCount;
+}
+
+bool DF_TraceReplay::DF_IsFinished() {
+  return (position + DF_TRACE_RECORD_HEADER_SIZE > dataLength);
+}
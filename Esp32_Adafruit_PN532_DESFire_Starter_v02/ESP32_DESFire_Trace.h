@@ -0,0 +1,108 @@
+/**
+ * APDU trace capture and replay for the ESP32_DESFire library.
+ *
+ * DF_TraceRecorder writes every card exchange of DF_BasicTransceive into a compact binary
+ * trace, DF_TraceReplay serves the recorded responses back to an ESP32_DESFire instance
+ * (as exchange handler), on the ESP32 or on a host, so a session from the field can be
+ * profiled and used as regression test offline.
+ *
+ * Trace format (all numbers are LSB first):
+ * Header (8 bytes):  'D' 'F' 'T' 'R', version (1), flags (1), reserved (2)
+ * Record (13 bytes + data):
+ *   type (1, 0x01 = exchange), target number (1), status (1, DF_StatusCode of the exchange),
+ *   command length (1), response length (1), start time in us since the trace start (4),
+ *   duration of the exchange in us (4), command (n), response (m, without PN532 status byte)
+ *
+ * Author: Michael Fehr (AndroidCrypto)
+*/
+
+#ifndef ESP32_DESFire_Trace_h
+#define ESP32_DESFire_Trace_h
+
+#include "Arduino.h"
+#include "ESP32_DESFire.h"
+
+#define DF_TRACE_VERSION (0x01)
+#define DF_TRACE_HEADER_SIZE (8)
+#define DF_TRACE_RECORD_HEADER_SIZE (13)
+#define DF_TRACE_MAX_RECORD_SIZE (DF_TRACE_RECORD_HEADER_SIZE + 255 + 255)
+#define DF_TRACE_RECORD_EXCHANGE (0x01)
+
+// A Print that collects the trace in a caller provided memory area, e.g. a PSRAM buffer,
+// so the recording does not write to flash in the middle of a tap
+class DF_TraceMemory : public Print {
+
+public:
+
+  DF_TraceMemory(byte* buffer, size_t bufferSize);
+
+  size_t write(uint8_t data);
+  size_t write(const uint8_t* data, size_t size);
+
+  const byte* DF_GetData();
+  size_t DF_GetLength();
+  bool DF_IsOverflow();
+  void DF_Clear();
+
+private:
+
+  byte* memory;
+  size_t memorySize;
+  size_t length = 0;
+  bool overflow = false;
+};
+
+class DF_TraceRecorder {
+
+public:
+
+  DF_TraceRecorder(Print* sink);
+
+  // writes the header and starts the time base
+  void DF_Begin();
+  void DF_Record(byte targetNumber, byte* sendData, byte sendLen, byte* backData, byte backLen, byte status, unsigned long startMicros, unsigned long durationMicros);
+
+  uint32_t DF_GetRecordCount();
+
+private:
+
+  Print* out;
+  unsigned long beginMicros = 0;
+  uint32_t recordCount = 0;
+};
+
+class DF_TraceReplay : public DF_ExchangeHandler {
+
+public:
+
+  enum DF_ReplayMode : byte {
+    DF_REPLAY_AS_FAST_AS_POSSIBLE = 0,  // responses are returned at once
+    DF_REPLAY_EXACT_TIMING = 1          // each response is returned after the recorded duration
+  };
+
+  DF_TraceReplay(const byte* trace, size_t traceLength, DF_ReplayMode mode = DF_REPLAY_AS_FAST_AS_POSSIBLE);
+
+  // false if the header is not valid
+  bool DF_IsValid();
+  // if strict, a command that differs from the recorded one fails the exchange
+  void DF_SetStrict(bool strict);
+  void DF_Rewind();
+
+  bool DF_Exchange(byte targetNumber, byte* sendData, byte sendLen, byte* backData, byte* backLen);
+
+  uint32_t DF_GetReplayedCount();
+  uint32_t DF_GetMismatchCount();
+  bool DF_IsFinished();
+
+private:
+
+  const byte* data;
+  size_t dataLength;
+  size_t position;
+  DF_ReplayMode replayMode;
+  bool isStrict = true;
+  uint32_t replayedCount = 0;
+  uint32_t mismatchCount = 0;
+};
+
+#endif
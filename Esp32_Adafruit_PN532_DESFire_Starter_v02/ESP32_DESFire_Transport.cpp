@@ -0,0 +1,304 @@
+#include "ESP32_DESFire_Transport.h"
+
+/////////////////////////////////////////////////////////////////////////////////////
+//
+// PN532
+//
+/////////////////////////////////////////////////////////////////////////////////////
+
+#ifdef DF_TRANSPORT_PN532
+DF_PN532Transport::DF_PN532Transport(Adafruit_PN532* reader, byte targetNumber) {
+  nfcLib = reader;
+  tgNumber = targetNumber;
+}
+
+void DF_PN532Transport::DF_SetTargetNumber(byte targetNumber) {
+  tgNumber = targetNumber;
+}
+
+byte DF_PN532Transport::DF_GetTargetNumber() {
+  return tgNumber;
+}
+
+void DF_PN532Transport::DF_SetBusScheduler(DF_BusScheduler* bus, int8_t irqPin) {
+  busScheduler = bus;
+  readyIrqPin = irqPin;
+  if (readyIrqPin >= 0)
+    pinMode(readyIrqPin, INPUT_PULLUP);
+}
+
+// The library holds CS low (SPI) or sends the wake sequence (HSU) and sends SAMConfiguration,
+// the I2C interface wakes with the SAMConfiguration alone
+void DF_PN532Transport::DF_Wakeup() {
+  if (busScheduler != NULL)
+    busScheduler->DF_Acquire();
+  nfcLib->wakeup();
+  if (busScheduler != NULL)
+    busScheduler->DF_Release();
+}
+
+// The timeout (the remaining time of the deadline) bounds the wait for the ACK and for the
+// response of the card. A command that is not answered in time is aborted, so the PN532 is
+// ready for the next one.
+bool DF_PN532Transport::DF_Command(byte* cmd, byte cmdLen, byte* resp, byte* respLen, uint16_t timeout) {
+  if (busScheduler == NULL) {
+    if (nfcLib->sendCommandReadResponse(cmd, cmdLen, resp, respLen, timeout))
+      return true;
+    nfcLib->abortCommand();
+    return false;
+  }
+
+  byte command = cmd[0];
+  bool success;
+  bool ready = false;
+
+  busScheduler->DF_Acquire();
+  success = nfcLib->startCommand(cmd, cmdLen);
+  busScheduler->DF_Release();
+  if (!success)
+    return false;
+
+  // the PN532 is now talking to the card, the other readers can use the bus
+  unsigned long startMillis = millis();
+  while (!ready) {
+    if (readyIrqPin >= 0) {
+      ready = (digitalRead(readyIrqPin) == LOW);
+    } else {
+      busScheduler->DF_Acquire();
+      ready = nfcLib->isResponseReady();
+      busScheduler->DF_Release();
+    }
+    if (!ready) {
+      if (millis() - startMillis > timeout) {
+        busScheduler->DF_Acquire();
+        nfcLib->abortCommand();
+        busScheduler->DF_Release();
+        return false;
+      }
+      delay(1);
+    }
+  }
+
+  busScheduler->DF_Acquire();
+  success = nfcLib->readCommandResponse(command, resp, respLen);
+  busScheduler->DF_Release();
+  return success;
+}
+
+// The exchange is addressed to the target number, the PN532 switches between the targets on
+// its own, no new activation is required.
+bool DF_PN532Transport::DF_Exchange(byte* sendData, byte sendLen, byte* backData, byte* backLen, uint16_t timeoutMs) {
+  byte frame[MAX_FRAME_SIZE];
+  byte frameLen = sizeof(frame);
+
+  if (sendLen > sizeof(frame) - 2)
+    return false;
+
+  frame[0] = DF_PN532_COMMAND_INDATAEXCHANGE;
+  frame[1] = tgNumber;
+  memcpy(&frame[2], sendData, sendLen);
+  if (!DF_Command(frame, sendLen + 2, frame, &frameLen, timeoutMs))
+    return false;
+
+  // the first byte of the response is the PN532 status byte, the error code is in bits 0-5
+  if (frameLen < 1 || (frame[0] & 0x3F) != 0)
+    return false;
+
+  if (frameLen - 1 > *backLen) {
+    *backLen = frameLen - 1;
+    return true;
+  }
+
+  memcpy(backData, &frame[1], frameLen - 1);
+  *backLen = frameLen - 1;
+  return true;
+}
+
+bool DF_PN532Transport::DF_Activate(byte* backUid, byte* backUidLength) {
+  byte cmd[3];
+  byte resp[64];
+  byte respLen = sizeof(resp);
+
+  cmd[0] = PN532_COMMAND_INLISTPASSIVETARGET;
+  cmd[1] = 0x01;                    // MaxTg
+  cmd[2] = PN532_MIFARE_ISO14443A;  // BrTy 106 kbps type A
+  if (!DF_Command(cmd, sizeof(cmd), resp, &respLen, 200))
+    return false;
+
+  // NbTg, Tg, SENS_RES (2), SEL_RES (1), NFCIDLength (1), NFCID1 (n), ...
+  if (respLen < 6 || resp[0] != 1 || 6 + resp[5] > respLen || resp[5] > *backUidLength)
+    return false;
+
+  tgNumber = resp[1];
+  memcpy(backUid, &resp[6], resp[5]);
+  *backUidLength = resp[5];
+  return true;
+}
+#endif
+
+/////////////////////////////////////////////////////////////////////////////////////
+//
+// MFRC522
+//
+/////////////////////////////////////////////////////////////////////////////////////
+
+#ifdef DF_TRANSPORT_MFRC522
+#define DF_ISODEP_PCB_I_BLOCK (0x02)
+#define DF_ISODEP_PCB_R_ACK (0xA2)
+#define DF_ISODEP_PCB_S_WTX (0xF2)
+#define DF_ISODEP_PCB_CHAINING (0x10)
+
+DF_MFRC522Transport::DF_MFRC522Transport(MFRC522* reader, byte targetNumber) {
+  rfidLib = reader;
+  tgNumber = targetNumber;
+}
+
+// the MFRC522 has one card only, the target number is just kept for the trace
+void DF_MFRC522Transport::DF_SetTargetNumber(byte targetNumber) {
+  tgNumber = targetNumber;
+}
+
+byte DF_MFRC522Transport::DF_GetTargetNumber() {
+  return tgNumber;
+}
+
+bool DF_MFRC522Transport::DF_Activate(byte* backUid, byte* backUidLength) {
+  byte atqa[2];
+  byte atqaSize = sizeof(atqa);
+
+  if (rfidLib->PICC_WakeupA(atqa, &atqaSize) != MFRC522::STATUS_OK)
+    return false;
+  if (rfidLib->PICC_Select(&rfidLib->uid) != MFRC522::STATUS_OK)
+    return false;
+  if (rfidLib->uid.size > *backUidLength)
+    return false;
+
+  // RATS: FSDI 5 = 64 bytes (the FIFO), CID 0
+  byte rats[4] = { 0xE0, 0x50 };
+  byte ats[MAX_FRAME_SIZE];
+  byte atsLen = sizeof(ats);
+  if (rfidLib->PCD_CalculateCRC(rats, 2, &rats[2]) != MFRC522::STATUS_OK)
+    return false;
+  if (rfidLib->PCD_TransceiveData(rats, sizeof(rats), ats, &atsLen, NULL, 0, true) != MFRC522::STATUS_OK)
+    return false;
+
+  // ATS: TL, T0 (FSCI in bits 0-3), ...
+  static const uint16_t fscTable[] = { 16, 24, 32, 40, 48, 64, 96, 128, 256 };
+  byte fsci = (atsLen > 2 && ats[0] > 1) ? (ats[1] & 0x0F) : 2;
+  frameSize = (fsci < sizeof(fscTable) / sizeof(fscTable[0])) ? fscTable[fsci] : 256;
+  if (frameSize > MAX_FRAME_SIZE)
+    frameSize = MAX_FRAME_SIZE;
+  blockNumber = 0;
+
+  memcpy(backUid, rfidLib->uid.uidByte, rfidLib->uid.size);
+  *backUidLength = rfidLib->uid.size;
+  return true;
+}
+
+// The MFRC522 timer limits the wait for one block, the time budget is checked between the blocks
+bool DF_MFRC522Transport::DF_TransceiveBlock(byte* block, byte blockLen, byte* backBlock, byte* backBlockLen, unsigned long startMillis, uint16_t timeoutMs) {
+  byte capacity = *backBlockLen;
+  if (rfidLib->PCD_CalculateCRC(block, blockLen, &block[blockLen]) != MFRC522::STATUS_OK)
+    return false;
+  if (rfidLib->PCD_TransceiveData(block, blockLen + 2, backBlock, backBlockLen, NULL, 0, true) != MFRC522::STATUS_OK)
+    return false;
+
+  // the card needs more time: return the S(WTX) request with the same multiplier
+  while (*backBlockLen >= 4 && (backBlock[0] & 0xF7) == DF_ISODEP_PCB_S_WTX) {
+    if (millis() - startMillis > timeoutMs)
+      return false;
+    byte wtx[4] = { DF_ISODEP_PCB_S_WTX, (byte)(backBlock[1] & 0x3F) };
+    *backBlockLen = capacity;
+    if (rfidLib->PCD_CalculateCRC(wtx, 2, &wtx[2]) != MFRC522::STATUS_OK)
+      return false;
+    if (rfidLib->PCD_TransceiveData(wtx, sizeof(wtx), backBlock, backBlockLen, NULL, 0, true) != MFRC522::STATUS_OK)
+      return false;
+  }
+
+  // the CRC was checked by the MFRC522 library
+  if (*backBlockLen < 3)
+    return false;
+  *backBlockLen -= 2;
+  return true;
+}
+
+// Sends the APDU in I-blocks (chained when it does not fit into one frame of the card) and
+// collects the response blocks until a block without the chaining bit is received.
+bool DF_MFRC522Transport::DF_Exchange(byte* sendData, byte sendLen, byte* backData, byte* backLen, uint16_t timeoutMs) {
+  unsigned long startMillis = millis();
+  byte block[MAX_FRAME_SIZE];
+  byte resp[MAX_FRAME_SIZE];
+  byte respLen;
+  byte maxInf = frameSize - 3;  // PCB and CRC_A
+  byte offset = 0;
+  byte received = 0;
+
+  while (true) {
+    byte chunk = (sendLen - offset > maxInf) ? maxInf : sendLen - offset;
+    bool more = (offset + chunk < sendLen);
+    block[0] = DF_ISODEP_PCB_I_BLOCK | blockNumber | (more ? DF_ISODEP_PCB_CHAINING : 0x00);
+    memcpy(&block[1], &sendData[offset], chunk);
+    respLen = sizeof(resp);
+    if (!DF_TransceiveBlock(block, chunk + 1, resp, &respLen, startMillis, timeoutMs))
+      return false;
+    offset += chunk;
+    if (!more)
+      break;
+    // the card acknowledges each chained block with R(ACK) and the same block number
+    if ((resp[0] & 0xF6) != DF_ISODEP_PCB_R_ACK || (resp[0] & 0x01) != blockNumber)
+      return false;
+    blockNumber ^= 0x01;
+  }
+
+  while (true) {
+    if ((resp[0] & 0xE2) != DF_ISODEP_PCB_I_BLOCK)
+      return false;
+    blockNumber ^= 0x01;
+    byte infLen = respLen - 1;
+    if (received + infLen > *backLen)
+      return false;
+    memcpy(&backData[received], &resp[1], infLen);
+    received += infLen;
+    if ((resp[0] & DF_ISODEP_PCB_CHAINING) == 0)
+      break;
+    // request the next block of the response
+    block[0] = DF_ISODEP_PCB_R_ACK | blockNumber;
+    respLen = sizeof(resp);
+    if (!DF_TransceiveBlock(block, 1, resp, &respLen, startMillis, timeoutMs))
+      return false;
+  }
+
+  *backLen = received;
+  return true;
+}
+#endif
+
+/////////////////////////////////////////////////////////////////////////////////////
+//
+// Loopback
+//
+/////////////////////////////////////////////////////////////////////////////////////
+
+#ifdef DF_TRANSPORT_LOOPBACK
+DF_LoopbackTransport::DF_LoopbackTransport(DF_ExchangeHandler* card, byte targetNumber) {
+  cardLib = card;
+  tgNumber = targetNumber;
+}
+
+void DF_LoopbackTransport::DF_SetTargetNumber(byte targetNumber) {
+  tgNumber = targetNumber;
+}
+
+byte DF_LoopbackTransport::DF_GetTargetNumber() {
+  return tgNumber;
+}
+
+// the handler answers at once, the timeout is not used
+bool DF_LoopbackTransport::DF_Exchange(byte* sendData, byte sendLen, byte* backData, byte* backLen, uint16_t timeoutMs) {
+  return cardLib->DF_Exchange(tgNumber, sendData, sendLen, backData, backLen);
+}
+
+bool DF_LoopbackTransport::DF_Activate(byte* backUid, byte* backUidLength) {
+  return false;
+}
+#endif
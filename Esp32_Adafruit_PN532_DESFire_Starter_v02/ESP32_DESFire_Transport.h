@@ -0,0 +1,163 @@
+/**
+ * Reader transports for the ESP32_DESFire library.
+ *
+ * A transport moves one APDU to the card and returns the response (including the status
+ * word). ESP32_DESFire uses the transport that is selected at compile time as DF_Transport,
+ * the calls are resolved by the compiler, there is no virtual dispatch in the exchange path.
+ * Every transport provides the same members:
+ *
+ *   typedef ... Reader;                          // the reader library object
+ *   static constexpr uint16_t MAX_FRAME_SIZE;    // largest frame the reader moves in one piece
+ *   static constexpr uint8_t MAX_RESPONSE_DATA;  // largest response data (without SW) of one APDU
+ *   static constexpr uint16_t STACK_BUFFERS;     // arrays on the stack of DF_Exchange or DF_Activate
+ *                                                // and of the reader library below them
+ *   Transport(Reader* reader, byte targetNumber);
+ *   bool DF_Exchange(byte* sendData, byte sendLen, byte* backData, byte* backLen, uint16_t timeoutMs);
+ *     // backLen: in = size of backData, out = response length including the status word,
+ *     // a response that does not fit returns true with the (larger) response length,
+ *     // the exchange gives up (returns false) when timeoutMs are spent
+ *   bool DF_Activate(byte* backUid, byte* backUidLength);  // activates a card (on arrival and after a RF loss)
+ *   void DF_SetTargetNumber(byte targetNumber);
+ *   byte DF_GetTargetNumber();
+ *
+ * Transports:
+ * - DF_PN532Transport: Adafruit_PN532 (default), ISO-DEP is handled by the PN532 (InDataExchange)
+ * - DF_MFRC522Transport: MFRC522 library by miguelbalboa, ISO-DEP (ISO/IEC 14443-4) block
+ *   protocol with chaining is done here, as the MFRC522 only transmits frames
+ * - DF_LoopbackTransport: sends the APDUs to a DF_ExchangeHandler (e.g. a scripted card or a
+ *   trace replay), for tests on a host without any reader
+ *
+ * Select the transport by defining DF_TRANSPORT_MFRC522 or DF_TRANSPORT_LOOPBACK below (or as
+ * build flag), without a definition the PN532 is used. The modules that send raw PN532
+ * commands (Targets, Readers, Presence) are available with the PN532 transport only.
+ *
+ * Author: Michael Fehr (AndroidCrypto)
+*/
+
+#ifndef ESP32_DESFire_Transport_h
+#define ESP32_DESFire_Transport_h
+
+#include "Arduino.h"
+#include "ESP32_DESFire_BusScheduler.h"
+
+//#define DF_TRANSPORT_MFRC522
+//#define DF_TRANSPORT_LOOPBACK
+
+#if !defined(DF_TRANSPORT_MFRC522) && !defined(DF_TRANSPORT_LOOPBACK)
+#define DF_TRANSPORT_PN532
+#endif
+
+#define DF_PN532_COMMAND_INDATAEXCHANGE (0x40)
+#define DF_PN532_INDATAEXCHANGE_TIMEOUT (5000)  // same value as in the modified Adafruit_PN532 library
+
+// Replaces the reader for the card exchanges, e.g. by a scripted card for benchmarks on a host
+class DF_ExchangeHandler {
+public:
+  virtual ~DF_ExchangeHandler() {}
+  // backLen: in = size of backData, out = response length including the status word
+  virtual bool DF_Exchange(byte targetNumber, byte* sendData, byte sendLen, byte* backData, byte* backLen) = 0;
+};
+
+#ifdef DF_TRANSPORT_PN532
+#include "Adafruit_PN532.h"
+
+class DF_PN532Transport {
+
+public:
+
+  typedef Adafruit_PN532 Reader;
+
+  static constexpr uint16_t MAX_FRAME_SIZE = 255;     // PN532_PACKBUFFSIZ of the modified library
+  static constexpr uint8_t MAX_RESPONSE_DATA = 125;  // the internal buffer is 128 - 3 for status bytes
+  // the InDataExchange frame, the response buffer of readCommandResponse and the I2C read
+  // buffer of readdata (the RDY byte and the frame) in the library
+  static constexpr uint16_t STACK_BUFFERS = MAX_FRAME_SIZE + MAX_FRAME_SIZE + (MAX_FRAME_SIZE + 1);
+
+  DF_PN532Transport(Adafruit_PN532* reader, byte targetNumber = 1);
+
+  bool DF_Exchange(byte* sendData, byte sendLen, byte* backData, byte* backLen, uint16_t timeoutMs);
+  bool DF_Activate(byte* backUid, byte* backUidLength);
+  void DF_SetTargetNumber(byte targetNumber);
+  byte DF_GetTargetNumber();
+
+  // see ESP32_DESFire::DF_SetBusScheduler and ESP32_DESFire::DF_PN532Command
+  void DF_SetBusScheduler(DF_BusScheduler* bus, int8_t irqPin);
+  bool DF_Command(byte* cmd, byte cmdLen, byte* resp, byte* respLen, uint16_t timeout);
+  // see ESP32_DESFire::DF_PN532Wakeup
+  void DF_Wakeup();
+
+private:
+
+  Adafruit_PN532* nfcLib;
+  byte tgNumber;  // logical target number used in InDataExchange
+  DF_BusScheduler* busScheduler = NULL;
+  int8_t readyIrqPin = -1;
+};
+
+typedef DF_PN532Transport DF_Transport;
+#endif
+
+#ifdef DF_TRANSPORT_MFRC522
+#include <MFRC522.h>  // https://github.com/miguelbalboa/rfid
+
+class DF_MFRC522Transport {
+
+public:
+
+  typedef MFRC522 Reader;
+
+  static constexpr uint16_t MAX_FRAME_SIZE = 64;     // size of the MFRC522 FIFO
+  static constexpr uint8_t MAX_RESPONSE_DATA = 125;  // the blocks of a response are chained together
+  static constexpr uint16_t STACK_BUFFERS = 2 * MAX_FRAME_SIZE + 4;  // send and receive block, S(WTX)
+
+  DF_MFRC522Transport(MFRC522* reader, byte targetNumber = 1);
+
+  bool DF_Exchange(byte* sendData, byte sendLen, byte* backData, byte* backLen, uint16_t timeoutMs);
+  // WUPA, anticollision and select, followed by RATS to enter ISO/IEC 14443-4
+  bool DF_Activate(byte* backUid, byte* backUidLength);
+  void DF_SetTargetNumber(byte targetNumber);
+  byte DF_GetTargetNumber();
+
+private:
+
+  // sends one block with CRC_A and answers waiting time extension requests of the card
+  bool DF_TransceiveBlock(byte* block, byte blockLen, byte* backBlock, byte* backBlockLen, unsigned long startMillis, uint16_t timeoutMs);
+
+  MFRC522* rfidLib;
+  byte tgNumber;
+  byte blockNumber = 0;
+  uint16_t frameSize = 16;  // FSC of the card, from the ATS
+};
+
+typedef DF_MFRC522Transport DF_Transport;
+#endif
+
+#ifdef DF_TRANSPORT_LOOPBACK
+class DF_LoopbackTransport {
+
+public:
+
+  typedef DF_ExchangeHandler Reader;
+
+  static constexpr uint16_t MAX_FRAME_SIZE = 255;
+  static constexpr uint8_t MAX_RESPONSE_DATA = 125;
+  static constexpr uint16_t STACK_BUFFERS = 0;
+
+  DF_LoopbackTransport(DF_ExchangeHandler* card, byte targetNumber = 1);
+
+  bool DF_Exchange(byte* sendData, byte sendLen, byte* backData, byte* backLen, uint16_t timeoutMs);
+  // there is no field, the card can not be activated again
+  bool DF_Activate(byte* backUid, byte* backUidLength);
+  void DF_SetTargetNumber(byte targetNumber);
+  byte DF_GetTargetNumber();
+
+private:
+
+  DF_ExchangeHandler* cardLib;
+  byte tgNumber;
+};
+
+typedef DF_LoopbackTransport DF_Transport;
+#endif
+
+#endif
@@ -43,23 +43,61 @@ Adafruit_PN532 nfc(PN532_SCK, PN532_MISO, PN532_MOSI, PN532_SS);
 
 ESP32_DESFire desfire(&nfc);
 
+#include "ESP32_DESFire_Memory.h"  // the library works without heap, the stack is checked here
+
+// the loop task of the ESP32 Arduino core has a stack of 8192 bytes, half of it is left to the sketch
+static_assert(DF_MemoryBudget::WORST_CASE_STACK <= 4096, "the DESFire commands need more stack than planned");
+
+#include "ESP32_DESFire_Presence.h"  // card arrival and removal events
+
+ESP32_DESFire_Presence presence(&desfire);
+
 void printHex(byte *buffer, uint16_t bufferSize);
 
 const char *DIVIDER = "-------------------------------------------------------------------------";
 
-boolean success;
 char scrBuf[60];                          // buffer for tft outputs
 uint8_t uid[] = { 0, 0, 0, 0, 0, 0, 0 };  // Buffer to store the returned UID
 uint8_t uidLength;                        // Length of the UID (4 or 7 bytes depending on ISO14443A card type)
 ESP32_DESFire::DF_StatusCode dfStatusCode;
 
-byte *appData = new byte[128];  // used as input or output buffer
+byte appData[128];  // used as input or output buffer
 byte appLen = 128;
 uint16_t appLenExt = 128;
 byte appDataByte = (byte)0xFF;
 
 #include "T01_Basic.h"  // Tutorial workflow
 
+// uncomment to decide the access by the UID with the offline index in the data partition 'access',
+// the index is prepared with ESP32_DESFire_AccessIndex and written with DF_SavePartition
+//#define USE_ACCESS_INDEX
+#ifdef USE_ACCESS_INDEX
+#include "ESP32_DESFire_AccessIndex.h"
+ESP32_DESFire_AccessIndex accessIndex;
+#endif
+
+// uncomment to store every tap in the journal in the data partition 'journal'
+//#define USE_JOURNAL
+#ifdef USE_JOURNAL
+#include "ESP32_DESFire_Journal.h"
+DF_PartitionStorage journalStorage("journal");
+ESP32_DESFire_Journal journal(&journalStorage);
+unsigned long tapStartMicros;
+#endif
+
+// uncomment to put the PN532 into PowerDown between the taps, it is woken for a poll every
+// 200 ms, or earlier by an external RF field when the IRQ pin of the PN532 is connected
+//#define USE_LOW_POWER
+
+// uncomment to run the benchmark of the command layer against a scripted card on start,
+// the results are printed as one JSON line per command
+//#define RUN_BENCHMARK
+// uncomment to repeat the tap flow against the scripted card and check that the heap does not grow
+//#define RUN_SOAK
+#if defined(RUN_BENCHMARK) || defined(RUN_SOAK)
+#include "T02_Benchmark.h"
+#endif
+
 void nfcInitialization() {
   nfc.begin();
   uint32_t versiondata = nfc.getFirmwareVersion();
@@ -77,10 +115,17 @@ void nfcInitialization() {
   Serial.print('.');
   Serial.println((versiondata >> 8) & 0xFF, DEC);
 
-  // Set the max number of retry attempts to read from a card
-  // This prevents us from waiting forever for a card, which is
-  // the default behaviour of the PN532.
-  nfc.setPassiveActivationRetries(0xFF);
+  // Set the max number of retry attempts to read from a card to a small value,
+  // so each poll in loop() returns quickly if no card is in the field
+  presence.DF_Begin(0x01);
+
+#ifdef USE_LOW_POWER
+  ESP32_DESFire_Presence::DF_LowPowerConfig lowPower;
+  lowPower.enabled = true;
+  lowPower.idlePollIntervalMs = 200;
+  lowPower.irqPin = PN532_IRQ;
+  presence.DF_SetLowPower(lowPower);
+#endif
 }
 
 void setup(void) {
@@ -92,20 +137,75 @@ void setup(void) {
 
   Serial.printf("ESP32_DESFire library version: %d\n", desfire.DESFIRE_SIMPLE_LIBRARY_VERSION);
 
+#ifdef RUN_BENCHMARK
+  run_T02_Benchmark();
+#endif
+#ifdef RUN_SOAK
+  run_T02_Soak(100000);
+#endif
+
+#ifdef USE_JOURNAL
+  if (journalStorage.DF_IsAvailable() && journal.DF_Begin()) {
+    Serial.printf("Journal ready, next record %lu\n", (unsigned long)journal.DF_GetNextSequence());
+  } else {
+    Serial.println("No journal partition found, taps are not stored");
+  }
+#endif
+
+#ifdef USE_ACCESS_INDEX
+  if (accessIndex.DF_MapPartition("access")) {
+    Serial.printf("Access index with %lu cards loaded\n", (unsigned long)accessIndex.DF_GetCount());
+  } else {
+    Serial.println("No access index found, every card is denied");
+  }
+#endif
+
   Serial.println("Waiting for an ISO14443A card");
 }
 
 void loop(void) {
 
-  // Wait for an ISO14443A type cards (Mifare, etc.).
-  success = nfc.inListPassiveTarget();
-
-  if (success) {
-    Serial.println("Found a card!");
-
-    run_T01_Basic_Handling();
-
-    delay(2000);
+  // Look for an ISO14443A type card (Mifare, etc.) or check if the current card is still present
+  switch (presence.DF_Poll()) {
+    case ESP32_DESFire_Presence::DF_EVENT_CARD_ARRIVED:
+      Serial.println("Found a card!");
+#ifdef USE_LOW_POWER
+      Serial.printf("PN532 wake up in %lu us\n", (unsigned long)presence.DF_GetLastWakeMicros());
+#endif
+      uidLength = sizeof(uid);
+      presence.DF_GetUid(uid, &uidLength);
+      Serial.print("UID:");
+      printHex(uid, uidLength);
+      Serial.println();
+
+#ifdef USE_JOURNAL
+      tapStartMicros = micros();
+#endif
+
+#ifdef USE_ACCESS_INDEX
+      Serial.println(accessIndex.DF_IsGranted(uid, uidLength) ? "Access granted" : "Access denied");
+#endif
+
+      run_T01_Basic_Handling();
+
+#ifdef USE_JOURNAL
+      {
+        byte aid[3] = { 0x00, 0x00, 0x00 };
+        desfire.DF_GetSelectedApplication(aid);
+        journal.DF_Log(ESP32_DESFire_Journal::DF_EVENT_TAP, uid, uidLength, aid, dfStatusCode, micros() - tapStartMicros);
+      }
+#endif
+      break;
+    case ESP32_DESFire_Presence::DF_EVENT_CARD_REMOVED:
+      // the reader is ready for the next card immediately
+      Serial.println("Card removed, waiting for an ISO14443A card");
+      break;
+    default:
+#ifdef USE_JOURNAL
+      // no tap in progress, the flash writes do not delay a card
+      journal.DF_Service();
+#endif
+      break;
   }
 }
 
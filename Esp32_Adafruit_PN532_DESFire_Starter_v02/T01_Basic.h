@@ -13,7 +13,6 @@ void run_T01_Basic_Handling() {
 
   Serial.println(DIVIDER);
   Serial.println("Get Free Memory");
-  appData = new byte[128];
   memset(appData, 0, 128);
   appLenExt = 128;
   appLen = 3;
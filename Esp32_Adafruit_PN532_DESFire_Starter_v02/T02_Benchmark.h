@@ -0,0 +1,55 @@
+#include "ESP32_DESFire_Benchmark.h"
+
+void run_T02_Benchmark() {
+  Serial.println();
+  Serial.println(DIVIDER);
+  Serial.println(" T02 Benchmark");
+  Serial.println(DIVIDER);
+
+  const byte fileSizes[] = { 16, 32, 48 };
+  const byte frameSizes[] = { 59, 125 };
+  const uint32_t latenciesUs[] = { 0, 2000 };
+
+  ESP32_DESFire_Benchmark::DF_BenchmarkConfig config;
+  config.iterations = 100;
+  config.fileSizes = fileSizes;
+  config.fileSizeCount = sizeof(fileSizes);
+  config.frameSizes = frameSizes;
+  config.frameSizeCount = sizeof(frameSizes);
+  config.latenciesUs = latenciesUs;
+  config.latencyCount = sizeof(latenciesUs) / sizeof(latenciesUs[0]);
+
+  ESP32_DESFire_Benchmark benchmark(&desfire, &Serial);
+  uint32_t errors = benchmark.DF_Run(config);
+  errors += benchmark.DF_RunOriginality(100);
+  Serial.printf("Benchmark finished with %lu failed commands\n", (unsigned long)errors);
+
+  Serial.println(DIVIDER);
+  Serial.println(" T02 Benchmark END");
+  Serial.println(DIVIDER);
+  Serial.println();
+}
+
+void run_T02_Soak(uint32_t taps) {
+  Serial.println();
+  Serial.println(DIVIDER);
+  Serial.println(" T02 Soak");
+  Serial.println(DIVIDER);
+
+  DF_MemoryBudgetPrint(&Serial);
+
+  ESP32_DESFire_Benchmark benchmark(&desfire, &Serial);
+  long heapGrowth = 0;
+  uint32_t errors = benchmark.DF_Soak(taps, &heapGrowth);
+  if (errors != 0)
+    Serial.printf("Soak FAILED: %lu taps failed\n", (unsigned long)errors);
+  if (heapGrowth != 0)
+    Serial.printf("Soak FAILED: the heap has grown by %ld bytes\n", heapGrowth);
+  if (errors == 0 && heapGrowth == 0)
+    Serial.println("Soak passed: no failed taps and no heap growth");
+
+  Serial.println(DIVIDER);
+  Serial.println(" T02 Soak END");
+  Serial.println(DIVIDER);
+  Serial.println();
+}
@@ -0,0 +1,163 @@
+/**
+ * Inspection of card images (see ESP32_DESFire_ImageFormat) on a Linux host.
+ *
+ * The image file is memory mapped and walked in place with DF_ImageReader, the same reader
+ * the ESP32 uses for the restore, so a large collection of images can be checked quickly.
+ *
+ * Build (from the root of the repository):
+ *   g++ -O2 -I Esp32_Adafruit_PN532_DESFire_Starter_v02 -o df_image_inspect tools/df_image_inspect.cpp
+ *       Esp32_Adafruit_PN532_DESFire_Starter_v02/ESP32_DESFire_ImageFormat.cpp
+ * Usage:
+ *   df_image_inspect [-x] image.dfim...
+ *   -x prints the complete content of the files instead of the first 32 bytes
+ * The exit code is 1 when an image is not valid.
+ *
+ * Author: Michael Fehr (AndroidCrypto)
+*/
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ESP32_DESFire_ImageFormat.h"
+
+#define DF_INSPECT_PREVIEW_LENGTH (32)
+
+static const char* DF_FileTypeName(uint8_t fileType) {
+  switch (fileType) {
+    case DF_IMAGE_FILE_STANDARD: return "Standard Data";
+    case DF_IMAGE_FILE_BACKUP: return "Backup Data";
+    case DF_IMAGE_FILE_VALUE: return "Value";
+    case DF_IMAGE_FILE_LINEAR_RECORD: return "Linear Record";
+    case DF_IMAGE_FILE_CYCLIC_RECORD: return "Cyclic Record";
+    default: return "Unknown";
+  }
+}
+
+static const char* DF_CommModeName(uint8_t commMode) {
+  switch (commMode) {
+    case 0x01: return "MAC";
+    case 0x03: return "FULL";
+    default: return "PLAIN";
+  }
+}
+
+static void DF_PrintHex(const char* indent, const uint8_t* data, uint32_t length) {
+  for (uint32_t i = 0; i < length; i++) {
+    if (i % 16 == 0)
+      printf("%s%04X:", indent, (unsigned int)i);
+    printf(" %02X", data[i]);
+    if (i % 16 == 15 || i == length - 1)
+      printf("\n");
+  }
+}
+
+// GetVersion: hardware (7), software (7), UID (7), batch number (5), week and year of production (2)
+static void DF_PrintVersion(const DF_ImageHeader& header) {
+  const uint8_t* v = header.version;
+  if (header.versionLength < 28) {
+    DF_PrintHex("  ", v, header.versionLength);
+    return;
+  }
+  printf("  hardware       : vendor %02X type %02X.%02X version %d.%d storage %02X\n", v[0], v[1], v[2], v[3], v[4], v[5]);
+  printf("  software       : vendor %02X type %02X.%02X version %d.%d storage %02X\n", v[7], v[8], v[9], v[10], v[11], v[12]);
+  printf("  UID            : %02X%02X%02X%02X%02X%02X%02X\n", v[14], v[15], v[16], v[17], v[18], v[19], v[20]);
+  printf("  production     : week %02X year %02X\n", v[26], v[27]);
+}
+
+static bool DF_Inspect(const char* path, bool fullContent) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    perror(path);
+    return false;
+  }
+  struct stat status;
+  if (fstat(fd, &status) != 0 || status.st_size == 0) {
+    printf("%s: empty or not readable\n", path);
+    close(fd);
+    return false;
+  }
+  const uint8_t* image = (const uint8_t*)mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (image == MAP_FAILED) {
+    perror(path);
+    return false;
+  }
+
+  DF_ImageReader reader;
+  bool isValid = reader.DF_Open(image, status.st_size);
+  if (!isValid) {
+    printf("%s: not a valid card image (wrong header, truncated or CRC error)\n", path);
+    munmap((void*)image, status.st_size);
+    return false;
+  }
+
+  const DF_ImageHeader& header = reader.DF_GetHeader();
+  printf("%s: card image version %d, %lu bytes\n", path, header.formatVersion, (unsigned long)reader.DF_GetImageLength());
+  DF_PrintVersion(header);
+  printf("  free memory    : %lu bytes\n", (unsigned long)header.freeMemory);
+  printf("  applications   : %d\n", header.applicationCount);
+
+  DF_ImageApplication application;
+  DF_ImageFile file;
+  DF_ImageFileSettings settings;
+  uint32_t contentBytes = 0;
+  while (reader.DF_NextApplication(&application)) {
+    printf("  AID %02X%02X%02X key settings %02X keys %02X files %d\n", application.aid[2], application.aid[1], application.aid[0],
+           application.keySettings, application.keyCount, application.fileCount);
+    while (reader.DF_NextFile(&file)) {
+      if (!DF_ImageReader::DF_ParseFileSettings(file, &settings)) {
+        printf("    file %02d settings not readable\n", file.fileNo);
+        continue;
+      }
+      printf("    file %02d %-13s %-5s access RW %X CAR %X R %X W %X", file.fileNo, DF_FileTypeName(settings.fileType),
+             DF_CommModeName(settings.commMode), settings.accessRightsRwCar >> 4, settings.accessRightsRwCar & 0x0F,
+             settings.accessRightsRW >> 4, settings.accessRightsRW & 0x0F);
+      if (settings.fileType == DF_IMAGE_FILE_VALUE)
+        printf(" limits %ld..%ld", (long)settings.lowerLimit, (long)settings.upperLimit);
+      else
+        printf(" size %lu", (unsigned long)settings.fileSize);
+      if ((file.flags & DF_IMAGE_FILE_HAS_CONTENT) == 0) {
+        printf(" (content not readable)\n");
+        continue;
+      }
+      contentBytes += file.contentLength;
+      if (settings.fileType == DF_IMAGE_FILE_VALUE && file.contentLength == 4) {
+        int32_t value = (int32_t)(file.content[0] | ((uint32_t)file.content[1] << 8) | ((uint32_t)file.content[2] << 16) | ((uint32_t)file.content[3] << 24));
+        printf(" value %ld\n", (long)value);
+        continue;
+      }
+      printf("\n");
+      uint32_t length = file.contentLength;
+      if (!fullContent && length > DF_INSPECT_PREVIEW_LENGTH)
+        length = DF_INSPECT_PREVIEW_LENGTH;
+      DF_PrintHex("      ", file.content, length);
+      if (length < file.contentLength)
+        printf("      ... %lu more bytes\n", (unsigned long)(file.contentLength - length));
+    }
+  }
+  printf("  content        : %lu bytes\n", (unsigned long)contentBytes);
+
+  munmap((void*)image, status.st_size);
+  return true;
+}
+
+int main(int argc, char** argv) {
+  bool fullContent = false;
+  int first = 1;
+  if (argc > 1 && strcmp(argv[1], "-x") == 0) {
+    fullContent = true;
+    first = 2;
+  }
+  if (first >= argc) {
+    printf("usage: %s [-x] image.dfim...\n", argv[0]);
+    return 1;
+  }
+  bool allValid = true;
+  for (int i = first; i < argc; i++)
+    allValid &= DF_Inspect(argv[i], fullContent);
+  return allValid ? 0 : 1;
+}
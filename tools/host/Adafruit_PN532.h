@@ -0,0 +1,91 @@
+/**
+ * Simulated PN532 for building the ESP32_DESFire library on a Linux host (see df_host.cpp).
+ *
+ * The class has the members of the modified Adafruit_PN532 library that the ESP32_DESFire
+ * library calls. Behind the reader is a simulated card: InDataExchange is given to the
+ * DF_ExchangeHandler in card (e.g. a DF_ScriptedCard), a reader without a card answers
+ * InListPassiveTarget with no target. The commands are answered like the PN532 does:
+ * - the RF commands (InListPassiveTarget, InDataExchange) take cardLatencyUs: the response
+ *   is ready this time after the ACK, a read before fails. sendCommandReadResponse polls
+ *   for it every 10 ms like the Adafruit library, with startCommand several readers overlap
+ * - every transfer over the host link (command, status poll, response) takes linkLatencyUs
+ * - after PowerDown every command fails until the host wakes the PN532 (wakeup)
+ * - the command codes are kept in commandLog, a host wake up is logged as PN532_WAKEUP,
+ *   so a test can check the sequence of a workflow
+ *
+ * Author: Michael Fehr (AndroidCrypto)
+*/
+
+#ifndef ADAFRUIT_PN532_H
+#define ADAFRUIT_PN532_H
+
+#include "Arduino.h"
+
+#define PN532_COMMAND_DIAGNOSE (0x00)             ///< Diagnose
+#define PN532_COMMAND_GETFIRMWAREVERSION (0x02)   ///< Get firmware version
+#define PN532_COMMAND_SAMCONFIGURATION (0x14)     ///< SAM configuration
+#define PN532_COMMAND_POWERDOWN (0x16)            ///< Power down
+#define PN532_COMMAND_RFCONFIGURATION (0x32)      ///< RF config
+#define PN532_COMMAND_INDATAEXCHANGE (0x40)       ///< Data exchange
+#define PN532_COMMAND_INCOMMUNICATETHRU (0x42)    ///< Communicate through
+#define PN532_COMMAND_INDESELECT (0x44)           ///< Deselect
+#define PN532_COMMAND_INLISTPASSIVETARGET (0x4A)  ///< List passive target
+#define PN532_COMMAND_INRELEASE (0x52)            ///< Release
+#define PN532_COMMAND_INSELECT (0x54)             ///< Select
+
+#define PN532_WAKEUP (0x55)  ///< Wake
+
+#define PN532_MIFARE_ISO14443A (0x00)  ///< MiFare
+
+#define DF_HOST_PN532_LOG_SIZE (64)
+#define DF_HOST_PN532_FRAME_SIZE (255)
+
+class DF_ExchangeHandler;
+
+class Adafruit_PN532 {
+
+public:
+
+  Adafruit_PN532(uint8_t ss);
+  bool begin(void);
+
+  void wakeup(void);
+  bool SAMConfig(void);
+  uint32_t getFirmwareVersion(void);
+  bool setPassiveActivationRetries(uint8_t maxRetries);
+
+  // Raw command access (modification for the ESP32_DESFire library)
+  bool sendCommandReadResponse(uint8_t* cmd, uint8_t cmdlen, uint8_t* response, uint8_t* responseLength,
+                               uint16_t timeout = 1000);
+  bool startCommand(uint8_t* cmd, uint8_t cmdlen, uint16_t timeout = 100);
+  bool isResponseReady(void);
+  bool readCommandResponse(uint8_t command, uint8_t* response, uint8_t* responseLength);
+  bool abortCommand(void);
+
+  // simulation
+  DF_ExchangeHandler* card = NULL;  // the card in the field, NULL = no card
+  uint32_t cardLatencyUs = 0;       // time of the PN532 for one RF command
+  uint32_t linkLatencyUs = 0;       // time of one transfer between the host and the PN532
+  uint8_t commandLog[DF_HOST_PN532_LOG_SIZE];
+  uint8_t commandLogLength = 0;     // the log stops when it is full
+  bool isPoweredDown = false;
+  uint32_t wakeupCount = 0;
+
+  void DF_ClearLog();
+
+private:
+
+  uint8_t uid[7];
+  uint8_t pendingResponse[DF_HOST_PN532_FRAME_SIZE];
+  uint8_t pendingLength = 0;
+  bool isPending = false;
+  unsigned long readyMicros = 0;
+
+  bool waitready(uint16_t timeout);
+  // the response data of the command without the response code, false if the PN532 would not answer
+  bool DF_Process(uint8_t* cmd, uint8_t cmdlen, uint8_t* response, uint8_t* responseLength);
+  bool DF_IsRfCommand(uint8_t command);
+  void DF_Log(uint8_t command);
+};
+
+#endif
@@ -0,0 +1,94 @@
+/**
+ * Minimal Arduino core for building the ESP32_DESFire library on a Linux host (see df_host.cpp).
+ *
+ * Only what the library uses is provided: the types, the time functions, the pins (they read
+ * HIGH, as with a pull up), Print and Serial (written to stdout).
+ *
+ * Author: Michael Fehr (AndroidCrypto)
+*/
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HEX (16)
+#define DEC (10)
+
+#define LOW (0x0)
+#define HIGH (0x1)
+#define INPUT (0x01)
+#define OUTPUT (0x03)
+#define INPUT_PULLUP (0x05)
+#define FALLING (0x02)
+
+#define IRAM_ATTR
+#define F(string) (string)
+#define bitRead(value, bit) (((value) >> (bit)) & 0x01)
+#define lowByte(w) ((uint8_t)((w) & 0xff))
+#define highByte(w) ((uint8_t)((w) >> 8))
+#define digitalPinToInterrupt(pin) (pin)
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+void pinMode(uint8_t pin, uint8_t mode);
+int digitalRead(uint8_t pin);
+void digitalWrite(uint8_t pin, uint8_t value);
+void attachInterrupt(uint8_t interrupt, void (*handler)(void), int mode);
+void detachInterrupt(uint8_t interrupt);
+
+uint32_t esp_random();
+
+class Print {
+
+public:
+
+  virtual ~Print() {}
+
+  virtual size_t write(uint8_t data) = 0;
+  virtual size_t write(const uint8_t* data, size_t size);
+
+  size_t print(const char* text);
+  size_t print(char c);
+  size_t print(int number, int base = DEC);
+  size_t print(unsigned int number, int base = DEC);
+  size_t print(long number, int base = DEC);
+  size_t print(unsigned long number, int base = DEC);
+  size_t print(double number, int digits = 2);
+  size_t println();
+  size_t println(const char* text);
+  size_t println(char c);
+  size_t println(int number, int base = DEC);
+  size_t println(unsigned int number, int base = DEC);
+  size_t println(long number, int base = DEC);
+  size_t println(unsigned long number, int base = DEC);
+  size_t println(double number, int digits = 2);
+  size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+private:
+
+  size_t DF_PrintNumber(unsigned long number, int base, bool negative);
+};
+
+class HardwareSerial : public Print {
+
+public:
+
+  void begin(unsigned long baud);
+  size_t write(uint8_t data);
+  size_t write(const uint8_t* data, size_t size);
+};
+
+extern HardwareSerial Serial;
+
+#endif
@@ -0,0 +1,521 @@
+/**
+ * Host harness of the ESP32_DESFire library.
+ *
+ * The library is built for Linux with a minimal Arduino core and a simulated PN532 (Arduino.h
+ * and Adafruit_PN532.h in this folder), so the benchmark and the checks run without an ESP32,
+ * e.g. in CI. The results are written to stdout, the exit code is 1 when a check failed.
+ *
+ * Build (from the root of the repository):
+ *   g++ -std=gnu++17 -O2 -I tools/host -I Esp32_Adafruit_PN532_DESFire_Starter_v02 -o df_host
+ *       tools/host/df_host*.cpp Esp32_Adafruit_PN532_DESFire_Starter_v02/ESP32_*.cpp -lpthread
+ * Usage:
+ *   df_host [check...]  without a check all are run
+ *   bench               the benchmark of T02 with the originality check (JSON lines)
+ *   soak [taps]         the tap flow 1,000,000 times (or taps), fails when the heap has grown
+ *   readers             4 simulated readers on one bus (ESP32_DESFire_Readers): every reader
+ *                       is served and the card exchanges of the readers overlap
+ *   wake                the low power idle of ESP32_DESFire_Presence: PowerDown without a card,
+ *                       a quiet bus until the poll is due, then the wake sequence
+ *   deadline            a card that answers later than the time budget: the command returns
+ *                       DF_STATUS_TIMEOUT within the budget, with a longer budget it succeeds
+ *   record <file>       writes the trace (ESP32_DESFire_Trace) of a session with the simulated card
+ *   replay <file>       replays a trace file in DF_REPLAY_AS_FAST_AS_POSSIBLE and DF_REPLAY_EXACT_TIMING:
+ *                       every command has to match the trace, the exact timing takes the recorded time
+ * Without a check the session is recorded into memory and replayed in both modes.
+ *
+ * Author: Michael Fehr (AndroidCrypto)
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+
+#include "Arduino.h"
+#include "Adafruit_PN532.h"
+#include "ESP32_DESFire.h"
+#include "ESP32_DESFire_Benchmark.h"
+#include "ESP32_DESFire_Memory.h"
+#include "ESP32_DESFire_Presence.h"
+#include "ESP32_DESFire_Readers.h"
+#include "ESP32_DESFire_Trace.h"
+
+#define DF_HOST_PN532_SS (5)
+#define DF_HOST_SOAK_TAPS (1000000)
+#define DF_HOST_READER_COUNT (4)
+#define DF_HOST_READER_FIRST_SS (10)
+#define DF_HOST_READER_LATENCY_US (3000)  // RF time of one command, the bus is free meanwhile
+#define DF_HOST_READER_LINK_US (200)      // one transfer over the shared bus
+#define DF_HOST_READER_RUN_MS (300)
+#define DF_HOST_WAKE_SS (20)
+#define DF_HOST_WAKE_INTERVAL_MS (30)
+#define DF_HOST_WAKE_RF_US (1000)  // RF time of the activation, it is part of the wake time
+#define DF_HOST_WAKE_MAX_US (50000)  // wake to the first exchange with the card
+#define DF_HOST_DEADLINE_SS (30)
+#define DF_HOST_DEADLINE_CARD_US (200000)  // answer time of the slow card
+#define DF_HOST_DEADLINE_BUDGET_MS (50)
+#define DF_HOST_DEADLINE_SLACK_MS (15)     // one status poll of the PN532 library and the abort
+#define DF_HOST_TRACE_SIZE (4096)
+#define DF_HOST_TRACE_FRAME_US (500)  // card time of one frame while the session is recorded
+
+static Adafruit_PN532 nfc(DF_HOST_PN532_SS);
+static ESP32_DESFire desfire(&nfc);
+
+// The replay sends the recorded commands as they are, without the workflow that made them
+class DF_HostSession : public ESP32_DESFire {
+
+public:
+
+  DF_HostSession(Adafruit_PN532* nfc)
+    : ESP32_DESFire(nfc) {}
+
+  DF_StatusCode DF_Transceive(byte* sendData, byte sendLen, byte* backData, byte* backLen) {
+    return DF_BasicTransceive_native(sendData, sendLen, backData, backLen);
+  }
+};
+
+// a trace sink that writes to a file of the host
+class DF_HostFile : public Print {
+
+public:
+
+  DF_HostFile(FILE* file)
+    : file(file) {}
+
+  size_t write(uint8_t data) {
+    return fwrite(&data, 1, 1, file);
+  }
+
+  size_t write(const uint8_t* data, size_t size) {
+    return fwrite(data, 1, size, file);
+  }
+
+private:
+
+  FILE* file;
+};
+
+static void DF_PrintCheck(const char* name, bool passed) {
+  Serial.printf("%s: %s\n", name, passed ? "passed" : "FAILED");
+}
+
+// compares the commands the PN532 got since the log was cleared, prints them when they differ
+static bool DF_CheckCommandLog(const char* name, const Adafruit_PN532& pn532, const byte* expected, byte expectedLength) {
+  if (pn532.commandLogLength == expectedLength && (expectedLength == 0 || memcmp(pn532.commandLog, expected, expectedLength) == 0))
+    return true;
+  Serial.printf("%s: PN532 commands", name);
+  for (byte i = 0; i < pn532.commandLogLength; i++)
+    Serial.printf(" %02X", pn532.commandLog[i]);
+  Serial.printf(", expected");
+  for (byte i = 0; i < expectedLength; i++)
+    Serial.printf(" %02X", expected[i]);
+  Serial.println();
+  return false;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+//
+// Checks
+//
+/////////////////////////////////////////////////////////////////////////////////////
+
+// the configuration of T02_Benchmark
+static bool DF_CheckBenchmark() {
+  const byte fileSizes[] = { 16, 32, 48 };
+  const byte frameSizes[] = { 59, 125 };
+  const uint32_t latenciesUs[] = { 0, 2000 };
+
+  ESP32_DESFire_Benchmark::DF_BenchmarkConfig config;
+  config.iterations = 100;
+  config.fileSizes = fileSizes;
+  config.fileSizeCount = sizeof(fileSizes);
+  config.frameSizes = frameSizes;
+  config.frameSizeCount = sizeof(frameSizes);
+  config.latenciesUs = latenciesUs;
+  config.latencyCount = sizeof(latenciesUs) / sizeof(latenciesUs[0]);
+
+  ESP32_DESFire_Benchmark benchmark(&desfire, &Serial);
+  uint32_t errors = benchmark.DF_Run(config);
+  errors += benchmark.DF_RunOriginality(100);
+  Serial.printf("Benchmark finished with %lu failed commands\n", (unsigned long)errors);
+  return errors == 0;
+}
+
+// the soak of T02, a long running reader has to end at the heap it started with
+static bool DF_CheckSoak(uint32_t taps) {
+  DF_MemoryBudgetPrint(&Serial);
+  ESP32_DESFire_Benchmark benchmark(&desfire, &Serial);
+  long heapGrowth = 0;
+  uint32_t errors = benchmark.DF_Soak(taps, &heapGrowth);
+  if (errors != 0)
+    Serial.printf("Soak FAILED: %lu taps failed\n", (unsigned long)errors);
+  if (heapGrowth != 0)
+    Serial.printf("Soak FAILED: the heap has grown by %ld bytes\n", heapGrowth);
+  if (errors == 0 && heapGrowth == 0)
+    Serial.println("Soak passed: no failed taps and no heap growth");
+  return errors == 0 && heapGrowth == 0;
+}
+
+static std::atomic<uint32_t> laneCommands[DF_HOST_READER_COUNT];
+static std::atomic<uint32_t> laneErrors{ 0 };
+
+static void DF_ReaderLane(byte readerIndex, ESP32_DESFire& session) {
+  byte memory[3];
+  byte memoryLen = sizeof(memory);
+  if (session.DF_Plain_GetFreeMemory(memory, &memoryLen) == ESP32_DESFire::DF_STATUS_OK)
+    laneCommands[readerIndex]++;
+  else
+    laneErrors++;
+}
+
+// One reader alone does at most one command per card latency, the readers on one bus have to
+// do clearly more together (1.5 times), and none of them may be starved by the others
+static bool DF_CheckReaders() {
+  static Adafruit_PN532 readerNfc[DF_HOST_READER_COUNT] = {
+    Adafruit_PN532(DF_HOST_READER_FIRST_SS), Adafruit_PN532(DF_HOST_READER_FIRST_SS + 1),
+    Adafruit_PN532(DF_HOST_READER_FIRST_SS + 2), Adafruit_PN532(DF_HOST_READER_FIRST_SS + 3)
+  };
+  DF_ScriptedCard cards[DF_HOST_READER_COUNT];
+  ESP32_DESFire_Readers readers;
+  bool passed = true;
+
+  for (byte i = 0; i < DF_HOST_READER_COUNT; i++) {
+    readerNfc[i].card = &cards[i];
+    readerNfc[i].cardLatencyUs = DF_HOST_READER_LATENCY_US;
+    readerNfc[i].linkLatencyUs = DF_HOST_READER_LINK_US;
+    passed &= (readers.DF_AddReader(&readerNfc[i], 0) == i);
+    laneCommands[i] = 0;
+  }
+  laneErrors = 0;
+  passed &= (readers.DF_BeginReaders() == DF_HOST_READER_COUNT);
+  passed &= (readers.DF_Session(0) != NULL && readers.DF_Session(DF_HOST_READER_COUNT) == NULL);
+  for (byte i = 0; i < DF_HOST_READER_COUNT; i++) {
+    byte uid[10];
+    byte uidLength = sizeof(uid);
+    passed &= (readers.DF_ActivateCard(i, uid, &uidLength) && uidLength == 7 && uid[6] == DF_HOST_READER_FIRST_SS + i);
+  }
+
+  unsigned long startMicros = micros();
+  readers.DF_Start(DF_ReaderLane);
+  delay(DF_HOST_READER_RUN_MS);
+  readers.DF_Stop();
+  unsigned long elapsedUs = micros() - startMicros;
+
+  uint32_t total = 0;
+  uint32_t fewest = laneCommands[0];
+  uint32_t most = laneCommands[0];
+  for (byte i = 0; i < DF_HOST_READER_COUNT; i++) {
+    total += laneCommands[i];
+    if (laneCommands[i] < fewest)
+      fewest = laneCommands[i];
+    if (laneCommands[i] > most)
+      most = laneCommands[i];
+  }
+  uint32_t singleReaderLimit = elapsedUs / DF_HOST_READER_LATENCY_US;
+  DF_BusScheduler& bus = readers.DF_GetBus(0);
+  Serial.printf("{\"readers\":%d,\"commands\":%lu,\"fewest_per_reader\":%lu,\"most_per_reader\":%lu,\"single_reader_limit\":%lu,\"errors\":%lu,\"grants\":%lu,\"contended\":%lu}\n",
+                DF_HOST_READER_COUNT, (unsigned long)total, (unsigned long)fewest, (unsigned long)most, (unsigned long)singleReaderLimit,
+                (unsigned long)laneErrors, (unsigned long)bus.DF_GetGrantCount(), (unsigned long)bus.DF_GetContendedCount());
+
+  // the readers have to wait for each other on the bus, otherwise the FIFO was not tested
+  passed &= (laneErrors == 0 && fewest > 0 && fewest * 2 >= most && 2 * total > 3 * singleReaderLimit && bus.DF_GetContendedCount() > 0);
+  DF_PrintCheck("readers", passed);
+  return passed;
+}
+
+static bool DF_CheckWake() {
+  const byte idleSequence[] = { PN532_COMMAND_INLISTPASSIVETARGET, PN532_COMMAND_POWERDOWN };
+  const byte wakeSequence[] = { PN532_WAKEUP, PN532_COMMAND_SAMCONFIGURATION, PN532_COMMAND_RFCONFIGURATION,
+                                PN532_COMMAND_INLISTPASSIVETARGET };
+  // the application of the card that left is selected again
+  const byte reselectSequence[] = { PN532_WAKEUP, PN532_COMMAND_SAMCONFIGURATION, PN532_COMMAND_RFCONFIGURATION,
+                                    PN532_COMMAND_INLISTPASSIVETARGET, PN532_COMMAND_INDATAEXCHANGE };
+  byte aid[3] = { 0x56, 0x78, 0x9A };
+  Adafruit_PN532 wakeNfc(DF_HOST_WAKE_SS);
+  ESP32_DESFire session(&wakeNfc);
+  ESP32_DESFire_Presence presence(&session);
+  DF_ScriptedCard card;
+  session.COMM_DEBUG_PRINT = false;
+  wakeNfc.cardLatencyUs = DF_HOST_WAKE_RF_US;
+
+  bool passed = presence.DF_Begin(0x01);
+  ESP32_DESFire_Presence::DF_LowPowerConfig config;
+  config.enabled = true;
+  config.idlePollIntervalMs = DF_HOST_WAKE_INTERVAL_MS;
+  presence.DF_SetLowPower(config);
+  presence.presenceCheckIntervalMs = 0;
+
+  // no card in the field: one activation, then PowerDown
+  wakeNfc.DF_ClearLog();
+  passed &= (presence.DF_Poll() == ESP32_DESFire_Presence::DF_EVENT_NONE && presence.DF_IsPoweredDown());
+  passed &= DF_CheckCommandLog("wake", wakeNfc, idleSequence, sizeof(idleSequence));
+
+  // the bus stays quiet until the poll interval has passed
+  wakeNfc.DF_ClearLog();
+  for (byte i = 0; i < 10; i++)
+    passed &= (presence.DF_Poll() == ESP32_DESFire_Presence::DF_EVENT_NONE);
+  passed &= DF_CheckCommandLog("wake", wakeNfc, NULL, 0);
+
+  // a card arrives, the next due poll wakes the PN532 and activates it; the first exchange
+  // with the card is the first command of the sketch
+  wakeNfc.card = &card;
+  delay(DF_HOST_WAKE_INTERVAL_MS + 5);
+  wakeNfc.DF_ClearLog();
+  unsigned long startMicros = micros();
+  passed &= (presence.DF_Poll() == ESP32_DESFire_Presence::DF_EVENT_CARD_ARRIVED);
+  passed &= DF_CheckCommandLog("wake", wakeNfc, wakeSequence, sizeof(wakeSequence));
+  byte memory[3];
+  byte memoryLen = sizeof(memory);
+  passed &= (session.DF_Plain_GetFreeMemory(memory, &memoryLen) == ESP32_DESFire::DF_STATUS_OK);
+  uint32_t firstExchangeMicros = micros() - startMicros;
+  passed &= (!presence.DF_IsPoweredDown() && presence.DF_GetWakeCount() == 1 && wakeNfc.wakeupCount == 1);
+  passed &= (presence.DF_GetLastWakeMicros() >= DF_HOST_WAKE_RF_US && firstExchangeMicros < DF_HOST_WAKE_MAX_US);
+  Serial.printf("{\"wake_count\":%lu,\"wake_us\":%lu,\"first_exchange_us\":%lu}\n", (unsigned long)presence.DF_GetWakeCount(),
+                (unsigned long)presence.DF_GetLastWakeMicros(), (unsigned long)firstExchangeMicros);
+
+  // the card leaves with an application selected, the PN532 goes to PowerDown
+  passed &= (session.DF_Plain_SelectApplication(aid) == ESP32_DESFire::DF_STATUS_OK);
+  wakeNfc.card = NULL;
+  ESP32_DESFire_Presence::DF_PresenceEvent event = ESP32_DESFire_Presence::DF_EVENT_NONE;
+  for (byte i = 0; i < presence.missedChecksForRemoval; i++)
+    event = presence.DF_Poll();
+  passed &= (event == ESP32_DESFire_Presence::DF_EVENT_CARD_REMOVED);
+  passed &= (presence.DF_Poll() == ESP32_DESFire_Presence::DF_EVENT_NONE && presence.DF_IsPoweredDown());
+
+  // the card comes back, the wake sequence ends with the selection of the application
+  wakeNfc.card = &card;
+  delay(DF_HOST_WAKE_INTERVAL_MS + 5);
+  wakeNfc.DF_ClearLog();
+  startMicros = micros();
+  passed &= (presence.DF_Poll() == ESP32_DESFire_Presence::DF_EVENT_CARD_ARRIVED);
+  firstExchangeMicros = micros() - startMicros;
+  passed &= DF_CheckCommandLog("wake", wakeNfc, reselectSequence, sizeof(reselectSequence));
+  byte selectedAid[3];
+  passed &= (session.DF_GetSelectedApplication(selectedAid) && memcmp(selectedAid, aid, sizeof(aid)) == 0);
+  passed &= (presence.DF_GetLastWakeMicros() >= 2 * DF_HOST_WAKE_RF_US && firstExchangeMicros < DF_HOST_WAKE_MAX_US);
+  Serial.printf("{\"wake_count\":%lu,\"wake_us\":%lu,\"first_exchange_us\":%lu}\n", (unsigned long)presence.DF_GetWakeCount(),
+                (unsigned long)presence.DF_GetLastWakeMicros(), (unsigned long)firstExchangeMicros);
+  DF_PrintCheck("wake", passed);
+  return passed;
+}
+
+// The deadline has to bound the wait for the response of the card, not only the ACK
+static bool DF_CheckDeadline() {
+  Adafruit_PN532 slowNfc(DF_HOST_DEADLINE_SS);
+  ESP32_DESFire session(&slowNfc);
+  DF_ScriptedCard card;
+  session.COMM_DEBUG_PRINT = false;
+  slowNfc.card = &card;
+  slowNfc.cardLatencyUs = DF_HOST_DEADLINE_CARD_US;
+
+  byte memory[3];
+  byte memoryLen = sizeof(memory);
+  session.DF_SetTimeBudget(DF_HOST_DEADLINE_BUDGET_MS);
+  unsigned long startMillis = millis();
+  ESP32_DESFire::DF_StatusCode statusCode = session.DF_Plain_GetFreeMemory(memory, &memoryLen);
+  unsigned long elapsedMs = millis() - startMillis;
+  bool passed = (statusCode == ESP32_DESFire::DF_STATUS_TIMEOUT && elapsedMs <= DF_HOST_DEADLINE_BUDGET_MS + DF_HOST_DEADLINE_SLACK_MS);
+
+  // the aborted command does not block the next one, that has enough time
+  memoryLen = sizeof(memory);
+  session.DF_SetTimeBudget(2 * DF_HOST_DEADLINE_CARD_US / 1000);
+  passed &= (session.DF_Plain_GetFreeMemory(memory, &memoryLen) == ESP32_DESFire::DF_STATUS_OK);
+  session.DF_ClearDeadline();
+
+  Serial.printf("{\"budget_ms\":%d,\"card_ms\":%d,\"status\":%d,\"elapsed_ms\":%lu}\n", DF_HOST_DEADLINE_BUDGET_MS,
+                DF_HOST_DEADLINE_CARD_US / 1000, statusCode, elapsedMs);
+  DF_PrintCheck("deadline", passed);
+  return passed;
+}
+
+// a session of the sketch: card info, application, a standard file and a value file
+static bool DF_RecordSession(Print* sink) {
+  DF_ScriptedCard card;
+  DF_HostSession session(&nfc);
+  DF_TraceRecorder recorder(sink);
+  session.COMM_DEBUG_PRINT = false;
+  card.frameLatencyUs = DF_HOST_TRACE_FRAME_US;
+  session.DF_SetExchangeHandler(&card);
+  session.DF_SetTraceRecorder(&recorder);
+  recorder.DF_Begin();
+
+  byte version[28];
+  byte versionLen = sizeof(version);
+  byte aid[3] = { 0x11, 0x22, 0x33 };
+  byte memory[3];
+  byte memoryLen = sizeof(memory);
+  byte settings[32];
+  byte settingsLen = sizeof(settings);
+  byte writeData[32];
+  byte readData[32];
+  uint16_t readLen = sizeof(readData);
+  int32_t value = 0;
+  for (byte i = 0; i < sizeof(writeData); i++)
+    writeData[i] = i;
+
+  bool passed = (session.DF_Plain_GetVersion(version, &versionLen) == ESP32_DESFire::DF_STATUS_OK);
+  passed &= (session.DF_Plain_SelectApplication(aid) == ESP32_DESFire::DF_STATUS_OK);
+  passed &= (session.DF_Plain_GetFreeMemory(memory, &memoryLen) == ESP32_DESFire::DF_STATUS_OK);
+  passed &= (session.DF_Plain_GetFileSettings(0x01, settings, &settingsLen) == ESP32_DESFire::DF_STATUS_OK);
+  passed &= (session.DF_Plain_WriteData_Simple(0x01, sizeof(writeData), 0, writeData) == ESP32_DESFire::DF_STATUS_OK);
+  passed &= (session.DF_Plain_ReadData_Simple(0x01, sizeof(readData), 0, readData, &readLen) == ESP32_DESFire::DF_STATUS_OK);
+  passed &= (readLen == sizeof(readData) && memcmp(readData, writeData, sizeof(readData)) == 0);
+  passed &= (session.DF_Plain_GetValue(0x02, &value) == ESP32_DESFire::DF_STATUS_OK);
+  passed &= (session.DF_Plain_Credit(0x02, 10) == ESP32_DESFire::DF_STATUS_OK);
+  passed &= (session.DF_Plain_CommitTransaction() == ESP32_DESFire::DF_STATUS_OK);
+  passed &= (recorder.DF_GetRecordCount() > 0);
+
+  Serial.printf("{\"recorded_exchanges\":%lu}\n", (unsigned long)recorder.DF_GetRecordCount());
+  DF_PrintCheck("record", passed);
+  return passed;
+}
+
+// Every recorded command is sent again, the replay has to answer all of them in order with the
+// recorded result. With the exact timing the replay takes at least the recorded time.
+static bool DF_ReplayTrace(const byte* trace, size_t traceLength, DF_TraceReplay::DF_ReplayMode mode, const char* modeName) {
+  DF_TraceReplay replay(trace, traceLength, mode);
+  DF_HostSession session(&nfc);
+  session.COMM_DEBUG_PRINT = false;
+  session.DF_SetExchangeHandler(&replay);
+  replay.DF_SetStrict(true);
+
+  uint32_t exchanges = 0;
+  uint32_t statusErrors = 0;
+  unsigned long recordedUs = 0;
+  bool passed = replay.DF_IsValid();
+  size_t position = DF_TRACE_HEADER_SIZE;
+  unsigned long startMicros = micros();
+  while (passed && position + DF_TRACE_RECORD_HEADER_SIZE <= traceLength) {
+    const byte* record = &trace[position];
+    size_t recordLength = DF_TRACE_RECORD_HEADER_SIZE + record[3] + record[4];
+    if (record[0] != DF_TRACE_RECORD_EXCHANGE || position + recordLength > traceLength) {
+      passed = false;
+      break;
+    }
+    byte sendData[255];
+    byte backData[255];
+    byte backLen = sizeof(backData);
+    memcpy(sendData, &record[DF_TRACE_RECORD_HEADER_SIZE], record[3]);
+    bool recordedOk = (record[2] == ESP32_DESFire::DF_STATUS_OK);
+    bool replayedOk = (session.DF_Transceive(sendData, record[3], backData, &backLen) == ESP32_DESFire::DF_STATUS_OK);
+    if (recordedOk != replayedOk || (replayedOk && (backLen != record[4] || memcmp(backData, &record[DF_TRACE_RECORD_HEADER_SIZE + record[3]], backLen) != 0)))
+      statusErrors++;
+    recordedUs += (uint32_t)record[9] | ((uint32_t)record[10] << 8) | ((uint32_t)record[11] << 16) | ((uint32_t)record[12] << 24);
+    exchanges++;
+    position += recordLength;
+  }
+  unsigned long replayUs = micros() - startMicros;
+
+  passed &= (exchanges > 0 && statusErrors == 0 && replay.DF_GetMismatchCount() == 0 && replay.DF_IsFinished() && replay.DF_GetReplayedCount() == exchanges);
+  if (mode == DF_TraceReplay::DF_REPLAY_EXACT_TIMING)
+    passed &= (replayUs >= recordedUs);
+  Serial.printf("{\"replay_mode\":\"%s\",\"exchanges\":%lu,\"mismatches\":%lu,\"status_errors\":%lu,\"recorded_us\":%lu,\"replay_us\":%lu}\n",
+                modeName, (unsigned long)exchanges, (unsigned long)replay.DF_GetMismatchCount(), (unsigned long)statusErrors, recordedUs, replayUs);
+  DF_PrintCheck("replay", passed);
+  return passed;
+}
+
+static bool DF_ReplayBothModes(const byte* trace, size_t traceLength) {
+  bool passed = DF_ReplayTrace(trace, traceLength, DF_TraceReplay::DF_REPLAY_AS_FAST_AS_POSSIBLE, "as_fast_as_possible");
+  passed &= DF_ReplayTrace(trace, traceLength, DF_TraceReplay::DF_REPLAY_EXACT_TIMING, "exact_timing");
+  return passed;
+}
+
+// without a file the session is recorded into memory
+static bool DF_CheckTrace() {
+  static byte traceBuffer[DF_HOST_TRACE_SIZE];
+  DF_TraceMemory trace(traceBuffer, sizeof(traceBuffer));
+  bool passed = DF_RecordSession(&trace) && !trace.DF_IsOverflow();
+  passed &= DF_ReplayBothModes(trace.DF_GetData(), trace.DF_GetLength());
+  return passed;
+}
+
+static bool DF_CheckRecordFile(const char* fileName) {
+  FILE* file = fopen(fileName, "wb");
+  if (file == NULL) {
+    Serial.printf("record: cannot write %s\n", fileName);
+    return false;
+  }
+  DF_HostFile sink(file);
+  bool passed = DF_RecordSession(&sink);
+  passed &= (fclose(file) == 0);
+  return passed;
+}
+
+static bool DF_CheckReplayFile(const char* fileName) {
+  FILE* file = fopen(fileName, "rb");
+  if (file == NULL) {
+    Serial.printf("replay: cannot read %s\n", fileName);
+    return false;
+  }
+  fseek(file, 0, SEEK_END);
+  long fileLength = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  byte* trace = (fileLength > 0) ? (byte*)malloc(fileLength) : NULL;
+  bool passed = (trace != NULL && fread(trace, 1, fileLength, file) == (size_t)fileLength);
+  fclose(file);
+  if (passed)
+    passed = DF_ReplayBothModes(trace, fileLength);
+  else
+    Serial.printf("replay: cannot read %s\n", fileName);
+  free(trace);
+  return passed;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+//
+// Main
+//
+/////////////////////////////////////////////////////////////////////////////////////
+
+static void DF_PrintUsage(const char* program) {
+  printf("usage: %s [check...]\n", program);
+  printf("  bench         the benchmark of T02 with the originality check\n");
+  printf("  soak [taps]   the tap flow %d times (or taps), fails on heap growth\n", DF_HOST_SOAK_TAPS);
+  printf("  readers       %d simulated readers on one bus\n", DF_HOST_READER_COUNT);
+  printf("  wake          PowerDown and the wake sequence of the presence engine\n");
+  printf("  deadline      a card slower than the time budget gives DF_STATUS_TIMEOUT in time\n");
+  printf("  record <file> writes the trace of a session with the simulated card\n");
+  printf("  replay <file> replays a trace in both replay modes\n");
+  printf("without a check all are run, the trace is recorded and replayed in memory\n");
+}
+
+int main(int argc, char** argv) {
+  desfire.COMM_DEBUG_PRINT = false;
+
+  bool allPassed = true;
+  if (argc < 2) {
+    allPassed &= DF_CheckBenchmark();
+    allPassed &= DF_CheckSoak(DF_HOST_SOAK_TAPS);
+    allPassed &= DF_CheckReaders();
+    allPassed &= DF_CheckWake();
+    allPassed &= DF_CheckDeadline();
+    allPassed &= DF_CheckTrace();
+  }
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "bench") == 0) {
+      allPassed &= DF_CheckBenchmark();
+    } else if (strcmp(argv[i], "soak") == 0) {
+      uint32_t taps = DF_HOST_SOAK_TAPS;
+      if (i + 1 < argc && argv[i + 1][0] >= '0' && argv[i + 1][0] <= '9')
+        taps = strtoul(argv[++i], NULL, 10);
+      allPassed &= DF_CheckSoak(taps);
+    } else if (strcmp(argv[i], "readers") == 0) {
+      allPassed &= DF_CheckReaders();
+    } else if (strcmp(argv[i], "wake") == 0) {
+      allPassed &= DF_CheckWake();
+    } else if (strcmp(argv[i], "deadline") == 0) {
+      allPassed &= DF_CheckDeadline();
+    } else if (strcmp(argv[i], "record") == 0 && i + 1 < argc) {
+      allPassed &= DF_CheckRecordFile(argv[++i]);
+    } else if (strcmp(argv[i], "replay") == 0 && i + 1 < argc) {
+      allPassed &= DF_CheckReplayFile(argv[++i]);
+    } else {
+      DF_PrintUsage(argv[0]);
+      return 1;
+    }
+  }
+  DF_PrintCheck("df_host", allPassed);
+  fflush(stdout);
+  return allPassed ? 0 : 1;
+}
@@ -0,0 +1,195 @@
+#include "Arduino.h"
+
+#include <chrono>
+#include <random>
+#include <stdarg.h>
+#include <thread>
+
+HardwareSerial Serial;
+
+static const std::chrono::steady_clock::time_point DF_HOST_START = std::chrono::steady_clock::now();
+
+/////////////////////////////////////////////////////////////////////////////////////
+//
+// Time and pins
+//
+/////////////////////////////////////////////////////////////////////////////////////
+
+unsigned long millis() {
+  return (unsigned long)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - DF_HOST_START).count();
+}
+
+unsigned long micros() {
+  return (unsigned long)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - DF_HOST_START).count();
+}
+
+void delay(unsigned long ms) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+// short delays are spun, a sleep of the host would take much longer than asked for
+void delayMicroseconds(unsigned int us) {
+  if (us >= 1000) {
+    std::this_thread::sleep_for(std::chrono::microseconds(us));
+    return;
+  }
+  unsigned long startMicros = micros();
+  while (micros() - startMicros < us)
+    ;
+}
+
+void yield() {
+  std::this_thread::yield();
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+}
+
+int digitalRead(uint8_t pin) {
+  return HIGH;
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+}
+
+void attachInterrupt(uint8_t interrupt, void (*handler)(void), int mode) {
+}
+
+void detachInterrupt(uint8_t interrupt) {
+}
+
+uint32_t esp_random() {
+  static std::mt19937 generator(std::random_device{}());
+  return generator();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+//
+// Print
+//
+/////////////////////////////////////////////////////////////////////////////////////
+
+size_t Print::write(const uint8_t* data, size_t size) {
+  size_t written = 0;
+  while (size-- > 0)
+    written += write(*data++);
+  return written;
+}
+
+size_t Print::print(const char* text) {
+  return write((const uint8_t*)text, strlen(text));
+}
+
+size_t Print::print(char c) {
+  return write((uint8_t)c);
+}
+
+size_t Print::print(int number, int base) {
+  return print((long)number, base);
+}
+
+size_t Print::print(unsigned int number, int base) {
+  return print((unsigned long)number, base);
+}
+
+size_t Print::print(long number, int base) {
+  // as in the Arduino core, only decimal numbers get a sign
+  if (base == DEC && number < 0)
+    return DF_PrintNumber(0UL - (unsigned long)number, base, true);
+  return DF_PrintNumber((unsigned long)number, base, false);
+}
+
+size_t Print::print(unsigned long number, int base) {
+  return DF_PrintNumber(number, base, false);
+}
+
+size_t Print::print(double number, int digits) {
+  return printf("%.*f", digits, number);
+}
+
+size_t Print::println() {
+  return print("\r\n");
+}
+
+size_t Print::println(const char* text) {
+  return print(text) + println();
+}
+
+size_t Print::println(char c) {
+  return print(c) + println();
+}
+
+size_t Print::println(int number, int base) {
+  return print(number, base) + println();
+}
+
+size_t Print::println(unsigned int number, int base) {
+  return print(number, base) + println();
+}
+
+size_t Print::println(long number, int base) {
+  return print(number, base) + println();
+}
+
+size_t Print::println(unsigned long number, int base) {
+  return print(number, base) + println();
+}
+
+size_t Print::println(double number, int digits) {
+  return print(number, digits) + println();
+}
+
+size_t Print::printf(const char* format, ...) {
+  char text[256];
+  va_list arguments;
+  va_start(arguments, format);
+  int length = vsnprintf(text, sizeof(text), format, arguments);
+  va_end(arguments);
+  if (length < 0)
+    return 0;
+  if ((size_t)length < sizeof(text))
+    return write((const uint8_t*)text, length);
+
+  char* longText = (char*)malloc(length + 1);
+  if (longText == NULL)
+    return 0;
+  va_start(arguments, format);
+  vsnprintf(longText, length + 1, format, arguments);
+  va_end(arguments);
+  size_t written = write((const uint8_t*)longText, length);
+  free(longText);
+  return written;
+}
+
+size_t Print::DF_PrintNumber(unsigned long number, int base, bool negative) {
+  char digits[8 * sizeof(unsigned long) + 2];
+  char* digit = &digits[sizeof(digits) - 1];
+  *digit = '\0';
+  if (base < 2)
+    base = DEC;
+  do {
+    unsigned long rest = number % base;
+    number /= base;
+    *--digit = (rest < 10) ? '0' + rest : 'A' + rest - 10;
+  } while (number > 0);
+  if (negative)
+    *--digit = '-';
+  return print(digit);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+//
+// Serial
+//
+/////////////////////////////////////////////////////////////////////////////////////
+
+void HardwareSerial::begin(unsigned long baud) {
+}
+
+size_t HardwareSerial::write(uint8_t data) {
+  return fwrite(&data, 1, 1, stdout);
+}
+
+size_t HardwareSerial::write(const uint8_t* data, size_t size) {
+  return fwrite(data, 1, size, stdout);
+}
@@ -0,0 +1,197 @@
+#include "Adafruit_PN532.h"
+#include "ESP32_DESFire_Transport.h"
+
+Adafruit_PN532::Adafruit_PN532(uint8_t ss) {
+  // every reader has its own card UID, the last byte is the chip select pin
+  const uint8_t baseUid[7] = { 0x04, 0x11, 0x22, 0x33, 0x44, 0x55, 0x00 };
+  memcpy(uid, baseUid, sizeof(uid));
+  uid[6] = ss;
+}
+
+bool Adafruit_PN532::begin(void) {
+  isPoweredDown = false;
+  return true;
+}
+
+// the SPI wake up (CS held low) followed by SAMConfiguration, as in the Adafruit library
+void Adafruit_PN532::wakeup(void) {
+  DF_Log(PN532_WAKEUP);
+  isPoweredDown = false;
+  wakeupCount++;
+  SAMConfig();
+}
+
+bool Adafruit_PN532::SAMConfig(void) {
+  uint8_t cmd[4] = { PN532_COMMAND_SAMCONFIGURATION, 0x01, 0x14, 0x01 };
+  uint8_t response[8];
+  uint8_t responseLength = sizeof(response);
+  return sendCommandReadResponse(cmd, sizeof(cmd), response, &responseLength);
+}
+
+// PN532 version 1.6
+uint32_t Adafruit_PN532::getFirmwareVersion(void) {
+  uint8_t cmd[1] = { PN532_COMMAND_GETFIRMWAREVERSION };
+  uint8_t response[8];
+  uint8_t responseLength = sizeof(response);
+  if (!sendCommandReadResponse(cmd, sizeof(cmd), response, &responseLength) || responseLength < 4)
+    return 0;
+  return ((uint32_t)response[0] << 24) | ((uint32_t)response[1] << 16) | ((uint32_t)response[2] << 8) | response[3];
+}
+
+bool Adafruit_PN532::setPassiveActivationRetries(uint8_t maxRetries) {
+  uint8_t cmd[5] = { PN532_COMMAND_RFCONFIGURATION, 0x05, 0xFF, 0x01, maxRetries };
+  uint8_t response[8];
+  uint8_t responseLength = sizeof(response);
+  return sendCommandReadResponse(cmd, sizeof(cmd), response, &responseLength);
+}
+
+// as in the Adafruit library: the ACK, then the wait for the response, then the read
+bool Adafruit_PN532::sendCommandReadResponse(uint8_t* cmd, uint8_t cmdlen, uint8_t* response, uint8_t* responseLength, uint16_t timeout) {
+  if (!startCommand(cmd, cmdlen, timeout))
+    return false;
+  if (!waitready(timeout))
+    return false;
+  return readCommandResponse(cmd[0], response, responseLength);
+}
+
+bool Adafruit_PN532::startCommand(uint8_t* cmd, uint8_t cmdlen, uint16_t timeout) {
+  delayMicroseconds(linkLatencyUs);
+  pendingLength = sizeof(pendingResponse);
+  isPending = DF_Process(cmd, cmdlen, pendingResponse, &pendingLength);
+  if (!isPending)
+    return false;
+  readyMicros = micros() + (DF_IsRfCommand(cmd[0]) ? cardLatencyUs : 0);
+  return true;
+}
+
+bool Adafruit_PN532::isResponseReady(void) {
+  delayMicroseconds(linkLatencyUs);
+  return isPending && (long)(micros() - readyMicros) >= 0;
+}
+
+// a read before the response is ready fails, like the preamble check of the Adafruit library
+bool Adafruit_PN532::readCommandResponse(uint8_t command, uint8_t* response, uint8_t* responseLength) {
+  delayMicroseconds(linkLatencyUs);
+  if (!isResponseReady() || pendingLength > *responseLength)
+    return false;
+  memcpy(response, pendingResponse, pendingLength);
+  *responseLength = pendingLength;
+  isPending = false;
+  return true;
+}
+
+bool Adafruit_PN532::abortCommand(void) {
+  isPending = false;
+  return true;
+}
+
+// the status is polled every 10 ms, as in the Adafruit library
+bool Adafruit_PN532::waitready(uint16_t timeout) {
+  uint16_t timer = 0;
+  while (!isResponseReady()) {
+    if (timeout != 0) {
+      timer += 10;
+      if (timer > timeout)
+        return false;
+    }
+    delay(10);
+  }
+  return true;
+}
+
+void Adafruit_PN532::DF_ClearLog() {
+  commandLogLength = 0;
+}
+
+bool Adafruit_PN532::DF_Process(uint8_t* cmd, uint8_t cmdlen, uint8_t* response, uint8_t* responseLength) {
+  if (cmdlen < 1)
+    return false;
+  DF_Log(cmd[0]);
+  // a PN532 in PowerDown does not answer before the host wake up
+  if (isPoweredDown)
+    return false;
+
+  uint8_t capacity = *responseLength;
+  *responseLength = 0;
+  switch (cmd[0]) {
+    case PN532_COMMAND_GETFIRMWAREVERSION:
+      {
+        const uint8_t version[4] = { 0x32, 0x01, 0x06, 0x07 };
+        if (capacity < sizeof(version))
+          return false;
+        memcpy(response, version, sizeof(version));
+        *responseLength = sizeof(version);
+        return true;
+      }
+    case PN532_COMMAND_SAMCONFIGURATION:
+    case PN532_COMMAND_RFCONFIGURATION:
+      return true;
+    case PN532_COMMAND_POWERDOWN:
+      isPoweredDown = true;
+      response[0] = 0x00;
+      *responseLength = 1;
+      return true;
+    case PN532_COMMAND_DIAGNOSE:
+      // NumTst 0x06: card presence detection
+      response[0] = (card != NULL) ? 0x00 : 0x01;
+      *responseLength = 1;
+      return true;
+    case PN532_COMMAND_INRELEASE:
+    case PN532_COMMAND_INSELECT:
+    case PN532_COMMAND_INDESELECT:
+      response[0] = 0x00;
+      *responseLength = 1;
+      return true;
+    case PN532_COMMAND_INLISTPASSIVETARGET:
+      {
+        // NbTg, Tg, SENS_RES (2), SEL_RES, NFCIDLength, NFCID1, ATS (TL, T0, TA, TB, TC)
+        const uint8_t header[6] = { 0x01, 0x01, 0x03, 0x44, 0x20, sizeof(uid) };
+        const uint8_t ats[5] = { 0x05, 0x75, 0x77, 0x81, 0x02 };
+        if (card == NULL) {
+          response[0] = 0x00;
+          *responseLength = 1;
+          return true;
+        }
+        if (capacity < sizeof(header) + sizeof(uid) + sizeof(ats))
+          return false;
+        memcpy(response, header, sizeof(header));
+        memcpy(&response[sizeof(header)], uid, sizeof(uid));
+        memcpy(&response[sizeof(header) + sizeof(uid)], ats, sizeof(ats));
+        *responseLength = sizeof(header) + sizeof(uid) + sizeof(ats);
+        return true;
+      }
+    case PN532_COMMAND_INDATAEXCHANGE:
+      {
+        // status 0x01: timeout, the card did not answer
+        if (card == NULL || cmdlen < 2 || capacity < 1) {
+          response[0] = 0x01;
+          *responseLength = 1;
+          return true;
+        }
+        // the library uses one buffer for the command and the response
+        uint8_t apdu[DF_HOST_PN532_FRAME_SIZE];
+        uint8_t apduLen = cmdlen - 2;
+        memcpy(apdu, &cmd[2], apduLen);
+        uint8_t backLen = capacity - 1;
+        if (!card->DF_Exchange(cmd[1], apdu, apduLen, &response[1], &backLen)) {
+          response[0] = 0x01;
+          *responseLength = 1;
+          return true;
+        }
+        response[0] = 0x00;
+        *responseLength = backLen + 1;
+        return true;
+      }
+    default:
+      return false;
+  }
+}
+
+bool Adafruit_PN532::DF_IsRfCommand(uint8_t command) {
+  return (command == PN532_COMMAND_INLISTPASSIVETARGET || command == PN532_COMMAND_INDATAEXCHANGE);
+}
+
+void Adafruit_PN532::DF_Log(uint8_t command) {
+  if (commandLogLength < DF_HOST_PN532_LOG_SIZE)
+    commandLog[commandLogLength++] = command;
+}